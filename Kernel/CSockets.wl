@@ -23,10 +23,150 @@ CSocketList::usage =
 "CSocketList[{{socketId1, type1}, {socketId2, type2}, ...}]";
 
 
+CSocketPollSet::usage =
+"CSocketPollSet[{socket1, socket2, ...}, events] keeps the sockets in a native interest set. Append[set, socket] or Append[set, socket -> events] adds a socket and Delete[set, socket] removes it.";
+
+
+CSocketPollSetModify::usage =
+"CSocketPollSetModify[set, socket, events] changes the events watched for a socket in the set.";
+
+
+CSocketPollSetWait::usage =
+"CSocketPollSetWait[set, timeout] waits up to timeout seconds and gives {socketId, events} for the ready sockets only.";
+
+
+CSocketFrames::usage =
+"CSocketFrames[socket, True] reads the socket as typed frames, each arriving as a NumericArray in a \"ReceivedFrame\" event. BinaryWrite[socket, numericArray] sends one frame. Set on a server it applies to every accepted connection.";
+
+
+CSocketZeroCopy::usage =
+"CSocketZeroCopy[socket, threshold] sends byte arrays of at least threshold bytes without copying them into the kernel, the array is held until a \"SendComplete\" event. CSocketZeroCopy[socket, False] turns it off. Set on a server it applies to every accepted connection. Linux only.";
+
+
+CSocketSendSegmented::usage =
+"CSocketSendSegmented[socket, host, port, byteArray, segmentSize] sends byteArray to host:port as datagrams of segmentSize bytes, many per system call where UDP segmentation offload is available.";
+
+
+CSocketGRO::usage =
+"CSocketGRO[socket, True] lets the kernel hand the poll loop several datagrams as one \"ReceivedFrom\" event with their starts in \"Offsets\". Gives False where it is unsupported.";
+
+
+CSocketBroadcast::usage =
+"CSocketBroadcast[{socket1, socket2, ...}, byteArray] sends one copy of byteArray to every socket, queueing what a socket cannot take now for its poll loop. Gives a status per socket: 1 written, 0 queued, -1 failed.";
+
+
+CSocketGroup::usage =
+"CSocketGroup[{socket1, socket2, ...}] keeps the sockets in a native group. Append[group, socket] adds a socket, Delete[group, socket] removes it and BinaryWrite[group, byteArray] sends to every member, giving {socketId, status} and dropping the members that failed.";
+
+
+CSocketEventsDrain::usage =
+"CSocketEventsDrain[list, max, timeout] takes up to max pending events from a list with the \"EventQueue\" option, waiting up to timeout seconds for the first. Gives <|\"Kinds\" -> ..., \"Events\" -> ..., \"Payloads\" -> ...|> where Events rows are {kind, socketId, socketType, value1, value2, value3, offset, length} and offsets point into the Payloads byte array. With the \"Timestamps\" option a Received row carries the arrival and raise times in value1 and value2. A ReceivedFrame row carries the array type code and header length with the whole frame as payload, Request and Reply rows the call id, RelayOpened the target socket, RelayClosed the target and the bytes forwarded each way, SendComplete the sends, bytes and copied flag.";
+
+
+CSocketRecord::usage =
+"CSocketRecord[list, path] appends every accept, receive, send and close of the list's poll loop to a binary log at path. CSocketRecord[list, None] stops and gives {records, bytes}.";
+
+
+CSocketReplay::usage =
+"CSocketReplay[path, host, port, speed] replays the client side of a log from CSocketRecord against host:port, one connection per recorded accept. speed 1 keeps the recorded timing and 0 sends as fast as possible. Gives <|\"Connections\" -> ..., \"BytesSent\" -> ..., \"BytesReceived\" -> ..., \"BytesRecorded\" -> ..., \"Time\" -> seconds|>.";
+
+
+CSocketImpair::usage =
+"CSocketImpair[socket, <|\"Delay\" -> seconds, \"Jitter\" -> seconds, \"Bandwidth\" -> bytesPerSecond, \"Segment\" -> bytes, \"Drop\" -> p, \"Reorder\" -> p|>] simulates a slow link on the socket. Delay, jitter and bandwidth hold back what the socket sends, segment caps every read and write, drop and reorder apply to sent datagrams. Set on a server it applies to every accepted connection. CSocketImpair[socket, None] turns it off.";
+
+
+CSocketLatency::usage =
+"CSocketLatency[server, True] times every request on the server's connections, from the message being handed to the kernel to the next send on that connection. CSocketLatency[server] gives <|\"Count\", \"InFlight\", \"Mean\", \"P50\", \"P90\", \"P99\", \"P999\", \"Max\"|> with times in seconds, CSocketLatency[server, \"Reset\"] gives them and starts over.";
+
+
+CSocketRpc::usage =
+"CSocketRpc[socket, \"Client\"] turns the connection into an RPC channel of id-tagged messages, many calls can be in flight at once. CSocketRpc[server, \"Server\"] does it for every accepted connection, each message arrives as a \"Request\" event and a ByteArray or String returned by the handler is sent back as the reply.";
+
+
+CSocketRpcCall::usage =
+"CSocketRpcCall[socket, payload] sends a call and gives its id, collect the reply with CSocketRpcWait. CSocketRpcCall[socket, payload, False] raises a \"Reply\" event in the loop that owns the socket instead.";
+
+
+CSocketRpcWait::usage =
+"CSocketRpcWait[socket, id, timeout] waits up to timeout seconds for the reply to a call and gives it as a ByteArray, or $Failed. A call that timed out stays pending.";
+
+
+CSocketRpcReply::usage =
+"CSocketRpcReply[socket, id, payload] answers a \"Request\" later than the handler returned.";
+
+
+CSocketRpcCancel::usage =
+"CSocketRpcCancel[socket, id] forgets a call, its reply is discarded.";
+
+
+CSocketRpcPending::usage =
+"CSocketRpcPending[socket] gives the number of calls whose replies were not collected yet.";
+
+
 CSocketHandler::usage =
 "CSocketHandler[] mutable handler object.";
 
 
+CSocketRelay::usage =
+"CSocketRelay[socket, target] forwards data between two sockets inside the poll loop without raising Received events.";
+
+
+CSocketDispatch::usage =
+"CSocketDispatch[server, path, workers, mode] waits for worker kernels on a unix socket and hands accepted connections to them. mode is \"RoundRobin\" or \"LeastLoaded\".";
+
+
+CSocketHandoffConnect::usage =
+"CSocketHandoffConnect[path] connects a worker kernel to a dispatching kernel, use SocketListen on the result to serve handed off connections.";
+
+
+CSocketPluginLoad::usage =
+"CSocketPluginLoad[path] loads a native handler plugin and returns CSocketPlugin[ptr].";
+
+
+CSocketPluginAttach::usage =
+"CSocketPluginAttach[socket, plugin] runs the plugin callbacks on the poll loop thread for the socket and, for a server, for every accepted connection.";
+
+
+CSocketCoalesce::usage =
+"CSocketCoalesce[socket, threshold] queues writes to the socket natively and lets the poll loop send them with one call per iteration or once threshold bytes are queued. CSocketCoalesce[socket, False] turns it off. Set on a server it applies to every accepted connection.";
+
+
+CSocketSetMemoryLimits::usage =
+"CSocketSetMemoryLimits[total, perConnection, shed] limits the bytes the library holds in total and per connection, 0 means no limit. Connections over a limit stop being read, or are closed when shed is True, and raise a \"MemoryLimit\" event.";
+
+
+CSocketMemoryUsage::usage =
+"CSocketMemoryUsage[] gives the bytes held by the library and CSocketMemoryUsage[socket] also those held for the socket.";
+
+
+CSocketPoolStats::usage =
+"CSocketPoolStats[] gives the counters of the native buffer pool.";
+
+
+CSocketCheckout::usage =
+"CSocketCheckout[host, port, protocol, timeout] gives a connection to host:port from the native connection pool, an idle one still connected when there is one and a new one otherwise, or $Failed. Give it back with CSocketCheckin.";
+
+
+CSocketCheckin::usage =
+"CSocketCheckin[socket] returns a connection to the pool for the next CSocketCheckout. CSocketCheckin[socket, False] closes it, use it when the connection is in an unknown state.";
+
+
+CSocketConnectionPoolLimits::usage =
+"CSocketConnectionPoolLimits[maxIdle, maxPerHost, idleTimeout] sets the idle connections kept per host, the connections per host that can be checked out at once, 0 means no limit, and the seconds an idle connection is kept.";
+
+
+CSocketConnectionPoolStats::usage =
+"CSocketConnectionPoolStats[] gives the counters of the connection pool.";
+
+
+CSocketConnectionPoolClear::usage =
+"CSocketConnectionPoolClear[] closes every idle connection of the pool.";
+
+
+CSocketPlugin::usage =
+"CSocketPlugin[ptr] loaded native handler plugin.";
+
+
 Begin["`Private`"];
 
 
@@ -110,6 +250,30 @@ CSocketObject /: BinaryWrite[CSocketObject[socketId_Integer, internalType_Intege
 socketSend[socketId, byteArray, Length[byteArray]];
 
 
+CSocketObject /: BinaryWrite[CSocketObject[socketId_Integer, internalType_Integer], numericArray_NumericArray] :=
+socketSendFrame[socketId, numericArray];
+
+
+CSocketFrames[CSocketObject[socketId_Integer, _], enable: True | False] :=
+socketFramesEnable[socketId, enable];
+
+
+CSocketZeroCopy[CSocketObject[socketId_Integer, _], threshold_Integer: 65536] :=
+socketZeroCopyEnable[socketId, threshold];
+
+
+CSocketZeroCopy[CSocketObject[socketId_Integer, _], False] :=
+socketZeroCopyEnable[socketId, 0];
+
+
+CSocketSendSegmented[CSocketObject[socketId_Integer, _], host_String, port_Integer, byteArray_ByteArray, segmentSize_Integer] :=
+socketSendToSegmented[socketId, host, port, byteArray, Length[byteArray], segmentSize];
+
+
+CSocketGRO[CSocketObject[socketId_Integer, _], enable: True | False] :=
+socketUdpGroEnable[socketId, enable];
+
+
 CSocketObject /: SocketReadyQ[CSocketObject[socketId_Integer, _], t_: 0] :=
 With[{validSockets = socketsCheck[{socketId}, 1]},
     If[validSockets =!= {socketId} || !socketIsConnected[socketId],
@@ -147,6 +311,76 @@ CSocketList /: Delete[CSocketList[socketListId_Integer], CSocketObject[socketId_
 socketListDelete[socketListId, socketId];
 
 
+CSocketBroadcast[sockets: {___CSocketObject}, byteArray_ByteArray] :=
+socketBroadcast[sockets[[All, 1]], byteArray];
+
+
+CSocketGroup[sockets: {___CSocketObject}] :=
+With[{groupId = socketGroupCreate[]},
+    Scan[socketGroupAdd[groupId, #[[1]]]&, sockets];
+    CSocketGroup[groupId]
+];
+
+
+CSocketGroup /: Append[CSocketGroup[groupId_Integer], CSocketObject[socketId_Integer, _]] :=
+socketGroupAdd[groupId, socketId];
+
+
+CSocketGroup /: Delete[CSocketGroup[groupId_Integer], CSocketObject[socketId_Integer, _]] :=
+socketGroupRemove[groupId, socketId];
+
+
+CSocketGroup /: Length[CSocketGroup[groupId_Integer]] :=
+Length[socketGroupMembers[groupId]];
+
+
+CSocketGroup /: Normal[CSocketGroup[groupId_Integer]] :=
+socketGroupMembers[groupId];
+
+
+CSocketGroup /: BinaryWrite[CSocketGroup[groupId_Integer], byteArray_ByteArray] :=
+socketGroupBroadcast[groupId, byteArray];
+
+
+CSocketGroup /: Close[CSocketGroup[groupId_Integer]] :=
+socketGroupDelete[groupId];
+
+
+CSocketPollSet[sockets: {___CSocketObject}, events_Integer: $POLLIN] :=
+With[{pollSetId = socketPollSetCreate[]},
+    Scan[socketPollSetAdd[pollSetId, #[[1]], events]&, sockets];
+    CSocketPollSet[pollSetId]
+];
+
+
+CSocketPollSet /: Append[CSocketPollSet[pollSetId_Integer], CSocketObject[socketId_Integer, _]] :=
+socketPollSetAdd[pollSetId, socketId, $POLLIN];
+
+
+CSocketPollSet /: Append[CSocketPollSet[pollSetId_Integer], CSocketObject[socketId_Integer, _] -> events_Integer] :=
+socketPollSetAdd[pollSetId, socketId, events];
+
+
+CSocketPollSet /: Delete[CSocketPollSet[pollSetId_Integer], CSocketObject[socketId_Integer, _]] :=
+socketPollSetRemove[pollSetId, socketId];
+
+
+CSocketPollSet /: Length[CSocketPollSet[pollSetId_Integer]] :=
+socketPollSetLength[pollSetId];
+
+
+CSocketPollSet /: Close[CSocketPollSet[pollSetId_Integer]] :=
+socketPollSetDelete[pollSetId];
+
+
+CSocketPollSetModify[CSocketPollSet[pollSetId_Integer], CSocketObject[socketId_Integer, _], events_Integer] :=
+socketPollSetModify[pollSetId, socketId, events];
+
+
+CSocketPollSetWait[CSocketPollSet[pollSetId_Integer], timeout_: Infinity, maxEvents_Integer: 0] :=
+socketPollSetWait[pollSetId, maxEvents, If[timeout === Infinity, -1, Round[timeout * 10^6]]];
+
+
 CSocketList /: SocketListen[CSocketList[socketListId_Integer], handler_] :=
 With[{
     bufferSize = 8 * 1024,
@@ -156,554 +390,1564 @@ With[{
     Internal`CreateAsynchronousTask[
         createSocketsPollLoop,
         {socketListId, bufferSize, usecInterval, eventMask},
-        handler[createEvent[##]]&
+        (
+            handler[createEvent[##]];
+            If[$memoryLimited || KeyExistsQ[$flowControlled, socketListId], ackEvent[##]]
+        )&
     ]
 ];
 
 
-CSocketObject /: SocketListen[serverSocket_CSocketObject, handler_] :=
-SocketListen[CSocketList[{serverSocket}], handler];
+(*Loops that ever had a watermark, the counts they keep stay acknowledged after it is removed*)
+$flowControlled = <||>;
 
 
-createEvent[task_, eventName_, {socketId_, socketType_, data__}] :=
-With[{eventData = createEventData[eventName, socketId, socketType, data]},
-    Join[<|
-        "Timestamp" -> Now,
-        "MultipartComplete" -> True,
-        "Task" -> task,
-        "Event" -> eventName
-    |>, eventData]
-];
+(*Set once a memory limit was given, every loop then counts its events*)
+$memoryLimited = False;
 
 
-createEventData["Accepted", listenSocketId_, listenSocketType_, acceptedSocketId_, acceptedSocketType_] :=
-With[{
-    listenSocket = CSocketObject[listenSocketId, listenSocketType],
-    acceptedSocket = CSocketObject[acceptedSocketId, acceptedSocketType]
-},
-    $csockets[acceptedSocket] = listenSocket;
-    <|
-        "ListenSocket" -> listenSocket,
-        "AcceptedSocket" -> acceptedSocket
-    |>
+(*Lets the poll loop resume a connection paused by "HighWatermark" or "LoopHighWatermark"*)
+ackEvent[_, "Received" | "ReceivedFrom", {socketId_, _, data_, ___}] :=
+socketEventAck[socketId, Length[data]];
+
+
+ackEvent[_, "ReceivedFrame", {socketId_, _, frame_}] :=
+socketEventAck[socketId, Times @@ Dimensions[frame] * $frameElementSizes[NumericArrayType[frame]]];
+
+
+ackEvent[_, "Request" | "Reply", {socketId_, _, _, payload_}] :=
+socketEventAck[socketId, Length[payload]];
+
+
+ackEvent[___] :=
+Null;
+
+
+CSocketList /: SocketListen[socketList_CSocketList, handler_, options__Rule] :=
+(
+    SetOptions[socketList, options];
+    SocketListen[socketList, handler]
+);
+
+
+CSocketObject /: SocketListen[serverSocket_CSocketObject, handler_, options___Rule] :=
+SocketListen[CSocketList[{serverSocket}], handler, options];
+
+
+(*"ReceiveLimit" - max bytes per recv call, "DrainBudget" - max bytes read from a connection per wakeup,
+"ListenerBudget" - max accepts per loop iteration, "ClientBudget" - max connections read per loop iteration,
+"HighWatermark" / "LowWatermark" - unhandled bytes at which a connection stops / resumes reading,
+"LoopHighWatermark" / "LoopLowWatermark" - the same for all connections of the loop, 0 - no limit,
+"EventQueue" - payload bytes of a queue the loop fills instead of raising events, read with CSocketEventsDrain, 0 - off,
+"Timestamps" - True adds the kernel arrival time and the time the loop raised the event to Received and ReceivedFrom*)
+CSocketList /: SetOptions[CSocketList[socketListId_Integer], options__Rule] :=
+(
+    If[MemberQ[{options}, ("HighWatermark" | "LoopHighWatermark") -> _?Positive],
+        $flowControlled[socketListId] = True
+    ];
+    Scan[socketListSetOption[socketListId, #[[1]] /. $socketListOptions, Replace[#[[2]], {True -> 1, False -> 0}]]&, {options}]
+);
+
+
+CSocketEventsDrain[CSocketList[socketListId_Integer], max_Integer: 0, timeout_: 0] :=
+With[{drained = socketEventsDrain[socketListId, max, If[timeout === Infinity, -1, Round[timeout * 10^6]]]},
+    <|"Kinds" -> $eventKinds, "Events" -> drained[[1]], "Payloads" -> drained[[2]]|>
 ];
 
 
-createEventData["Closed", closedSocketId_, socketType_, _] :=
-<|"ClosedSocket" -> CSocketObject[closedSocketId, socketType]|>;
+CSocketRecord[CSocketList[socketListId_Integer], path_String] :=
+socketRecorderStart[socketListId, ExpandFileName[path]];
 
 
-createEventData["Error", socketId_, socketType_, errorCode_] :=
-<|
-    "ErrorSocket" -> CSocketObject[socketId, socketType],
-    "ErrorCode" -> errorCode
-|>;
+CSocketRecord[CSocketList[socketListId_Integer], None] :=
+socketRecorderStop[socketListId];
 
 
-createEventData["Received", socketId_, socketType_, receivedData_] :=
-With[{
-    byteArray = ByteArray[receivedData],
-    sourceSocket = CSocketObject[socketId, socketType]}, {
-    socket = $csockets[sourceSocket]
-},
+CSocketReplay[path_String, host_String, port_Integer, speed_?NonNegative: 1] :=
+With[{result = socketReplay[ExpandFileName[path], host, port, N[speed]]},
     <|
-        "Socket" -> socket,
-        "SourceSocket" -> sourceSocket,
-        "Data" :> ByteArrayToString[byteArray],
-        "DataBytes" :> Normal[byteArray],
-        "DataByteArray" :> byteArray
+        "Connections" -> result[[1]],
+        "BytesSent" -> result[[2]],
+        "BytesReceived" -> result[[3]],
+        "BytesRecorded" -> result[[4]],
+        "Time" -> result[[5]] / 10^9.
     |>
 ];
 
 
-Options[CSocketHandler] = {
-    "Logger" :> Function[#],
-    "Buffer" :> CreateDataStructure["HashTable"],
-    "Serializer" :> Function[#],
-    "Deserializer" :> Function[#],
-    "Accumulator" :> Function[Length[#DataByteArray]],
-    "Received" :> Function[Null],
-    "Accepted" :> Function[Null],
-    "Closed" :> Function[Null],
-    "Error" :> Function[Null]
-};
+CSocketImpair[CSocketObject[socketId_Integer, _], settings: _Association | {___Rule}] :=
+With[{impairment = Association[settings]},
+    socketImpair[
+        socketId,
+        Round[Lookup[impairment, "Delay", 0] * 10^6],
+        Round[Lookup[impairment, "Jitter", 0] * 10^6],
+        Round[Lookup[impairment, "Bandwidth", 0]],
+        Round[Lookup[impairment, "Segment", 0]],
+        N[Lookup[impairment, "Drop", 0]],
+        N[Lookup[impairment, "Reorder", 0]]
+    ]
+];
 
 
-With[{store = Language`NewExpressionStore["CSocketHandler"]},
+CSocketImpair[CSocketObject[socketId_Integer, _], None] :=
+socketImpair[socketId, 0, 0, 0, 0, 0., 0.];
 
-    CSocketHandler[OptionsPattern[]] :=
-    With[{handler = CSocketHandler[Null]},
-        Map[store["put"[handler, #, OptionValue[#]]]&] @ Keys[Options[CSocketHandler]];
 
-        handler
-    ];
+CSocketLatency[CSocketObject[socketId_Integer, _], enable: True | False] :=
+socketLatencyEnable[socketId, enable];
 
-    (handler_CSocketHandler)[key_] := store["get"[handler, key]];
 
-    (handler_CSocketHandler)[key_, rest__] := store["get"[handler, key]][rest];
+CSocketLatency[CSocketObject[socketId_Integer, _]] :=
+latencyStats[socketLatencyStats[socketId, False]];
 
-    CSocketHandler /: Set[(handler_CSocketHandler)[key_], value_] := (store["put"[handler, key, value]]; value);
-];
 
+CSocketLatency[CSocketObject[socketId_Integer, _], "Reset"] :=
+latencyStats[socketLatencyStats[socketId, True]];
 
-Unprotect[Set];
 
+latencyStats[stats_List] :=
+Join[
+    AssociationThread[{"Count", "InFlight"}, stats[[;; 2]]],
+    AssociationThread[{"Mean", "P50", "P90", "P99", "P999", "Max"}, stats[[3 ;;]] / 10^9.]
+];
 
-(*TODO: replace to MutationHandler*)
-Set[(handler_?(Head[#] === CSocketHandler&))[keys__], value_] :=
-With[{$handler$ = handler}, $handler$[keys] = value];
 
+CSocketRpc[CSocketObject[socketId_Integer, _], mode: "Client" | "Server"] :=
+socketRpcEnable[socketId, mode === "Server"];
 
-Protect[Set];
 
+CSocketRpcCall[CSocketObject[socketId_Integer, _], payload_String, wait: True | False: True] :=
+socketRpcCall[socketId, StringToByteArray[payload], wait];
 
-Format[handler_CSocketHandler, InputForm] :=
-SequenceForm[CSocketHandler] @ Map[Function[# -> handler[#]]] @ Keys @ Options[CSocketHandler];
 
+CSocketRpcCall[CSocketObject[socketId_Integer, _], payload_ByteArray, wait: True | False: True] :=
+socketRpcCall[socketId, payload, wait];
 
-CSocketHandler /: MakeBoxes[handler: CSocketHandler[Null], form: (StandardForm | TraditionalForm)] :=
-Module[{above, below},
-    {above, below} = TakeDrop[Map[# -> handler[#]&] @ Keys @ Options[CSocketHandler], 2];
 
-    BoxForm`ArrangeSummaryBox[CSocketHandler, handler, Null, above, below, form, "Interpretable" -> Automatic]
+CSocketRpcWait[CSocketObject[socketId_Integer, _], id_Integer, timeout_: Infinity] :=
+Replace[
+    Quiet[socketRpcWait[socketId, id, If[timeout === Infinity, -1, Round[timeout * 10^6]]]],
+    Except[_ByteArray] -> $Failed
 ];
 
 
-(handler_CSocketHandler)[packet_Association] :=
-Module[{extendedPacket, result, extraPacket, extraPacketDataLength},
-    ConsoleEcho["PACKET"][packet];
-    If[(KeyExistsQ[packet, "Event"] && packet["Event"] === "Received") ||
-        KeyExistsQ[packet, "DataByteArray"] && ByteArrayQ[packet["DataByteArray"]],
+CSocketRpcReply[CSocketObject[socketId_Integer, _], id_Integer, payload_String] :=
+socketRpcReply[socketId, id, StringToByteArray[payload]];
 
-        extendedPacket = getExtendedPacket[handler, packet]; (*Association[]*)
 
-        If[extendedPacket["Completed"],
-            With[{message = getMessage[handler, extendedPacket]},
-                extendedPacket["DataByteArray"] := message; (*ByteArray[]*)
-                extendedPacket["Data"] := ByteArrayToString[message];
-                extendedPacket["DataBytes"] := Normal[message];
-                With[{content = handler["Deserializer"][message]},
-                    extendedPacket["Message"] := content;
-                ];
-            ];
+CSocketRpcReply[CSocketObject[socketId_Integer, _], id_Integer, payload_ByteArray] :=
+socketRpcReply[socketId, id, payload];
 
-            result = handler["Serializer"] @ invokeHandler[handler, extendedPacket]; (*ByteArray[] | _String | Null*)
 
-            sendResponse[handler, packet, result];
+CSocketRpcCancel[CSocketObject[socketId_Integer, _], id_Integer] :=
+socketRpcCancel[socketId, id];
 
-            If[extendedPacket["StoredLength"] > extendedPacket["ExpectedLength"],
-                extraPacket = packet;
-                extraPacketDataLength = extendedPacket["StoredLength"] - extendedPacket["ExpectedLength"];
-                extraPacket["DataByteArray"] = packet["DataByteArray"][[-extraPacketDataLength ;; ]];
-                clearBuffer[handler, packet];
-                handler[extraPacket],
-            (*Else*)
-                clearBuffer[handler, extendedPacket]
-            ];
 
-            Return[result],
-        (*Else*)
-            savePacketToBuffer[handler, extendedPacket]
-        ];,
+CSocketRpcPending[CSocketObject[socketId_Integer, _]] :=
+socketRpcPending[socketId];
 
-    (*Else*)
-        handler[packet["Event"]][packet]
-    ];
+
+CSocketRelay[CSocketObject[socketId_Integer, _], CSocketObject[targetSocketId_Integer, _]] :=
+socketRelay[socketId, targetSocketId];
+
+
+CSocketPluginLoad[path_String] :=
+CSocketPlugin[socketPluginLoad[path]];
+
+
+CSocketPluginAttach[CSocketObject[socketId_Integer, _], CSocketPlugin[pluginPtr_Integer]] :=
+socketPluginAttach[socketId, pluginPtr];
+
+
+CSocketCoalesce[CSocketObject[socketId_Integer, _], threshold_Integer?Positive] :=
+socketCoalesceEnable[socketId, threshold];
+
+
+CSocketCoalesce[CSocketObject[socketId_Integer, _], False] :=
+(
+    socketCoalesceEnable[socketId, 0];
+    socketCoalesceFlush[socketId];
+);
+
+
+CSocketSetMemoryLimits[total_Integer, perConnection_Integer, shed: True | False: False] :=
+(
+    If[total > 0 || perConnection > 0, $memoryLimited = True];
+    socketMemorySetLimits[total, perConnection, shed]
+);
+
+
+CSocketMemoryUsage[] :=
+With[{usage = socketMemoryUsage[0]},
+    <|"Bytes" -> usage[[1]], "Limit" -> usage[[2]]|>
 ];
 
 
-getExtendedPacket[handler_, packet_] :=
-With[{uuid = packet["SourceSocket"][[1]]},
-    Module[{
-        dataLength,
-        last,
-        expectedLength,
-        storedLength,
-        completed,
-        buffer
-    },
+CSocketMemoryUsage[CSocketObject[socketId_Integer, _]] :=
+With[{usage = socketMemoryUsage[socketId]},
+    <|"Bytes" -> usage[[1]], "Limit" -> usage[[2]], "ConnectionBytes" -> usage[[3]], "ConnectionLimit" -> usage[[4]]|>
+];
+
+
+CSocketPoolStats[] :=
+With[{stats = socketPoolStats[]},
+    <|"Allocations" -> stats[[1]], "Hits" -> stats[[2]], "Large" -> stats[[3]], "Frees" -> stats[[4]], "CachedBytes" -> stats[[5]]|>
+];
+
+
+CSocketCheckout[host_String: "localhost", port_Integer, protocol: "TCP" | "UDP": "TCP", timeout_: 10] :=
+With[{
+    socketId = Quiet[socketConnPoolCheckout[host, port,
+        protocol /. {"TCP" -> $SOCKSTREAM, "UDP" -> $SOCKDGRAM},
+        If[timeout === Infinity, -1, Round[timeout * 10^6]]
+    ]]
+},
+    If[IntegerQ[socketId],
+        CSocketObject[socketId, If[protocol === "TCP", $TCPCLIENT, $UDPCLIENT]],
+    (*Else*)
+        $Failed
+    ]
+];
+
+
+CSocketCheckin[CSocketObject[socketId_Integer, _], reuse: True | False: True] :=
+socketConnPoolCheckin[socketId, reuse];
+
+
+CSocketConnectionPoolLimits[maxIdle_Integer, maxPerHost_Integer, idleTimeout_?NonNegative] :=
+socketConnPoolSetLimits[maxIdle, maxPerHost, Round[idleTimeout * 10^6]];
+
+
+CSocketConnectionPoolStats[] :=
+With[{stats = socketConnPoolStats[]},
+    <|"Hosts" -> stats[[1]], "Idle" -> stats[[2]], "CheckedOut" -> stats[[3]], "Hits" -> stats[[4]], "Misses" -> stats[[5]], "Evictions" -> stats[[6]]|>
+];
+
+
+CSocketConnectionPoolClear[] :=
+socketConnPoolClear[];
+
+
+CSocketDispatch[CSocketObject[serverSocketId_Integer, _], path_String, workers_Integer, mode: "RoundRobin" | "LeastLoaded": "RoundRobin"] :=
+Module[{listener = socketCreate[$AFUNIX, $SOCKSTREAM, $IPPROTOAUTO], channels, dispatcher},
+    socketUnixBind[listener, path];
+    socketListen[listener, workers];
+
+    channels = Table[socketAccept[listener], {workers}];
+    socketClose[listener];
+
+    dispatcher = socketDispatcherCreate[channels, workers, mode /. {"RoundRobin" -> 0, "LeastLoaded" -> 1}];
+    socketDispatcherAttach[serverSocketId, dispatcher];
+
+    (*Return*)
+    dispatcher
+];
+
+
+CSocketHandoffConnect[path_String] :=
+With[{socketId = socketCreate[$AFUNIX, $SOCKSTREAM, $IPPROTOAUTO]},
+    socketUnixConnect[socketId, path];
+
+    (*Return*)
+    CSocketObject[socketId, $HANDOFFCHANNEL]
+];
+
+
+createEvent[task_, eventName_, {socketId_, socketType_, data__}] :=
+With[{eventData = createEventData[eventName, socketId, socketType, data]},
+    Join[<|
+        "Timestamp" -> Now,
+        "MultipartComplete" -> True,
+        "Task" -> task,
+        "Event" -> eventName
+    |>, eventData]
+];
+
+
+createEventData["Accepted", listenSocketId_, listenSocketType_, acceptedSocketId_, acceptedSocketType_] :=
+With[{
+    listenSocket = CSocketObject[listenSocketId, listenSocketType],
+    acceptedSocket = CSocketObject[acceptedSocketId, acceptedSocketType]
+},
+    $csockets[acceptedSocket] = listenSocket;
+    <|
+        "ListenSocket" -> listenSocket,
+        "AcceptedSocket" -> acceptedSocket
+    |>
+];
+
+
+createEventData["AcceptedBatch", listenSocketId_, listenSocketType_, accepted_, newHosts___] :=
+With[{
+    listenSocket = CSocketObject[listenSocketId, listenSocketType],
+    acceptedSockets = Map[CSocketObject[#, $TCPCLIENT]&, accepted[[All, 1]]]
+},
+    Scan[($peerHosts[#[[1]]] = #[[2]])&, Partition[{newHosts}, 2]];
+    Scan[($csockets[#] = listenSocket)&, acceptedSockets];
+    <|
+        "ListenSocket" -> listenSocket,
+        "AcceptedSockets" -> acceptedSockets,
+        "Hosts" -> Map[peerHost, accepted[[All, 2]]],
+        "Ports" -> accepted[[All, 3]]
+    |>
+];
+
+
+(*An id no socket holds is freed once enough newer hosts came by, ids are never reused*)
+peerHost[hostId_Integer] :=
+Lookup[$peerHosts, hostId, With[{host = Quiet[socketPeerHost[hostId]]}, If[StringQ[host], $peerHosts[hostId] = host, Missing["Freed", hostId]]]];
+
+
+createEventData["Closed", closedSocketId_, socketType_, _] :=
+<|"ClosedSocket" -> CSocketObject[closedSocketId, socketType]|>;
+
+
+createEventData["MemoryLimit", socketId_, socketType_, status_, connectionBytes_, shed_] :=
+<|
+    "Socket" -> CSocketObject[socketId, socketType],
+    "Reason" -> If[status === 1, "Connection", "Global"],
+    "ConnectionBytes" -> connectionBytes,
+    "Shed" -> shed === 1
+|>;
+
+
+createEventData["Error", socketId_, socketType_, errorCode_] :=
+<|
+    "ErrorSocket" -> CSocketObject[socketId, socketType],
+    "ErrorCode" -> errorCode
+|>;
+
+
+createEventData["RelayOpened", socketId_, socketType_, targetSocketId_] :=
+<|
+    "Socket" -> CSocketObject[socketId, socketType],
+    "TargetSocket" -> CSocketObject[targetSocketId, $TCPCLIENT]
+|>;
+
+
+createEventData["RelayClosed", socketId_, socketType_, targetSocketId_, forwardBytes_, backwardBytes_] :=
+<|
+    "Socket" -> CSocketObject[socketId, socketType],
+    "TargetSocket" -> CSocketObject[targetSocketId, $TCPCLIENT],
+    "BytesForwarded" -> forwardBytes,
+    "BytesReturned" -> backwardBytes
+|>;
+
+
+createEventData["ReceivedFrom", socketId_, socketType_, receivedData_, host_, port_, offsets_List: {0}, times___Integer] :=
+With[{byteArray = ByteArray[receivedData]},
+    Join[<|
+        "SourceSocket" -> CSocketObject[socketId, socketType],
+        "Host" -> host,
+        "Port" -> port,
+        "Payload" -> byteArray,
+        "Offsets" -> offsets
+    |>, receiveTimes[times]]
+];
+
+
+(*Unix time in nanoseconds when the kernel received the data and when the loop raised the event*)
+receiveTimes[arrival_Integer, raised_Integer] :=
+<|"ArrivalTime" -> arrival, "RaisedTime" -> raised|>;
+
+
+receiveTimes[] :=
+<||>;
+
+
+createEventData["SendComplete", socketId_, socketType_, sends_, bytes_, copied_] :=
+<|
+    "Socket" -> CSocketObject[socketId, socketType],
+    "Sends" -> sends,
+    "Bytes" -> bytes,
+    "Copied" -> copied === 1
+|>;
+
+
+createEventData["ReceivedFrame", socketId_, socketType_, frame_] :=
+With[{sourceSocket = CSocketObject[socketId, socketType]},
+    <|
+        "Socket" -> $csockets[sourceSocket],
+        "SourceSocket" -> sourceSocket,
+        "Frame" -> frame
+    |>
+];
+
+
+createEventData[event: "Request" | "Reply", socketId_, socketType_, id_, payload_] :=
+With[{sourceSocket = CSocketObject[socketId, socketType]},
+    <|
+        "Socket" -> $csockets[sourceSocket],
+        "SourceSocket" -> sourceSocket,
+        "Id" -> id,
+        "Payload" -> ByteArray[payload]
+    |>
+];
+
+
+createEventData["Received", socketId_, socketType_, receivedData_, times___Integer] :=
+With[{
+    byteArray = ByteArray[receivedData],
+    sourceSocket = CSocketObject[socketId, socketType]}, {
+    socket = $csockets[sourceSocket]
+},
+    Join[<|
+        "Socket" -> socket,
+        "SourceSocket" -> sourceSocket,
+        "Data" :> ByteArrayToString[byteArray],
+        "DataBytes" :> Normal[byteArray],
+        "DataByteArray" :> byteArray
+    |>, receiveTimes[times]]
+];
+
+
+Options[CSocketHandler] = {
+    "Logger" :> Function[#],
+    "Buffer" :> CreateDataStructure["HashTable"],
+    "Serializer" :> Function[#],
+    "Deserializer" :> Function[#],
+    "Accumulator" :> Function[Length[#DataByteArray]],
+    "CacheTime" :> 0,
+    "MaxMessageLength" :> Infinity,
+    "Received" :> Function[Null],
+    "ReceivedFrame" :> Function[Null],
+    "Request" :> Function[Null],
+    "Reply" :> Function[Null],
+    "ReceivedFrom" :> Function[Null],
+    "SendComplete" :> Function[Null],
+    "Accepted" :> Function[Null],
+    "AcceptedBatch" :> Automatic,
+    "Closed" :> Function[Null],
+    "Error" :> Function[Null],
+    "RelayOpened" :> Function[Null],
+    "RelayClosed" :> Function[Null],
+    "MemoryLimit" :> Function[Null]
+};
+
+
+With[{store = Language`NewExpressionStore["CSocketHandler"]},
+
+    CSocketHandler[OptionsPattern[]] :=
+    With[{handler = CSocketHandler[Null]},
+        Map[store["put"[handler, #, OptionValue[#]]]&] @ Keys[Options[CSocketHandler]];
+
+        handler
+    ];
+
+    (handler_CSocketHandler)[key_] := store["get"[handler, key]];
+
+    (handler_CSocketHandler)[key_, rest__] := store["get"[handler, key]][rest];
+
+    CSocketHandler /: Set[(handler_CSocketHandler)[key_], value_] := (store["put"[handler, key, value]]; value);
+];
+
+
+Unprotect[Set];
+
+
+(*TODO: replace to MutationHandler*)
+Set[(handler_?(Head[#] === CSocketHandler&))[keys__], value_] :=
+With[{$handler$ = handler}, $handler$[keys] = value];
+
+
+Protect[Set];
+
+
+Format[handler_CSocketHandler, InputForm] :=
+SequenceForm[CSocketHandler] @ Map[Function[# -> handler[#]]] @ Keys @ Options[CSocketHandler];
+
+
+CSocketHandler /: MakeBoxes[handler: CSocketHandler[Null], form: (StandardForm | TraditionalForm)] :=
+Module[{above, below},
+    {above, below} = TakeDrop[Map[# -> handler[#]&] @ Keys @ Options[CSocketHandler], 2];
+
+    BoxForm`ArrangeSummaryBox[CSocketHandler, handler, Null, above, below, form, "Interpretable" -> Automatic]
+];
+
+
+(handler_CSocketHandler)[packet_Association] :=
+Module[{extendedPacket, result, extraPacket, extraPacketDataLength},
+    ConsoleEcho["PACKET"][packet];
+    If[(KeyExistsQ[packet, "Event"] && packet["Event"] === "Received") ||
+        KeyExistsQ[packet, "DataByteArray"] && ByteArrayQ[packet["DataByteArray"]],
+
+        extendedPacket = getExtendedPacket[handler, packet]; (*Association[]*)
+
+        If[extendedPacket["ExpectedLength"] > handler["MaxMessageLength"],
+            clearBuffer[handler, extendedPacket];
+            Close[packet["SourceSocket"]];
+            handler["MemoryLimit"][<|
+                packet,
+                "Event" -> "MemoryLimit",
+                "Socket" -> packet["SourceSocket"],
+                "Reason" -> "MessageLength",
+                "ExpectedLength" -> extendedPacket["ExpectedLength"],
+                "Shed" -> True
+            |>];
+            Return[Null]
+        ];
+
+        If[extendedPacket["Completed"],
+            With[{message = getMessage[handler, extendedPacket]},
+                extendedPacket["DataByteArray"] := message; (*ByteArray[]*)
+                extendedPacket["Data"] := ByteArrayToString[message];
+                extendedPacket["DataBytes"] := Normal[message];
+                With[{content = handler["Deserializer"][message]},
+                    extendedPacket["Message"] := content;
+                ];
+            ];
+
+            result = handler["Serializer"] @ invokeHandler[handler, extendedPacket]; (*ByteArray[] | _String | Null*)
+
+            sendResponse[handler, packet, result];
+
+            If[handler["CacheTime"] > 0 && extendedPacket["DataLength"] === extendedPacket["StoredLength"] === extendedPacket["ExpectedLength"],
+                cacheResponse[packet, result, handler["CacheTime"]]
+            ];
+
+            If[extendedPacket["StoredLength"] > extendedPacket["ExpectedLength"],
+                extraPacket = packet;
+                extraPacketDataLength = extendedPacket["StoredLength"] - extendedPacket["ExpectedLength"];
+                extraPacket["DataByteArray"] = packet["DataByteArray"][[-extraPacketDataLength ;; ]];
+                clearBuffer[handler, packet];
+                handler[extraPacket],
+            (*Else*)
+                clearBuffer[handler, extendedPacket]
+            ];
+
+            Return[result],
+        (*Else*)
+            savePacketToBuffer[handler, extendedPacket]
+        ];,
+
+    (*Else*)
+        Which[
+            packet["Event"] === "AcceptedBatch" && handler["AcceptedBatch"] === Automatic,
+                Scan[handler["Accepted"], acceptedPackets[packet]],
+
+            packet["Event"] === "Request",
+                sendReply[packet, handler["Request"][packet]],
+
+            True,
+                handler[packet["Event"]][packet]
+        ]
+    ];
+];
+
+
+(*Splits a batch into the packets of single "Accepted" events*)
+acceptedPackets[packet_Association] :=
+MapThread[
+    Join[KeyDrop[packet, {"AcceptedSockets", "Hosts", "Ports"}], <|
+        "Event" -> "Accepted",
+        "AcceptedSocket" -> #1,
+        "Host" -> #2,
+        "Port" -> #3
+    |>]&,
+    {packet["AcceptedSockets"], packet["Hosts"], packet["Ports"]}
+];
+
+
+getExtendedPacket[handler_, packet_] :=
+With[{uuid = packet["SourceSocket"][[1]]},
+    Module[{
+        dataLength,
+        last,
+        expectedLength,
+        storedLength,
+        completed,
+        buffer
+    },
         dataLength = Length[packet["DataByteArray"]];
         buffer = handler["Buffer"]["Lookup", uuid]; (*DataStructure[DynamicArray]*)
 
-        If[!MissingQ[buffer] && buffer["Length"] > 0,
-            last = buffer["Part", -1]; (*Association[]*)
-            expectedLength = last["ExpectedLength"];
-            storedLength = last["StoredLength"];,
+        If[!MissingQ[buffer] && buffer["Length"] > 0,
+            last = buffer["Part", -1]; (*Association[]*)
+            expectedLength = last["ExpectedLength"];
+            storedLength = last["StoredLength"];,
+
+        (*Else*)
+            expectedLength = conditionApply[handler["Accumulator"]][packet];
+            storedLength = 0;
+        ];
+
+        completed = storedLength + dataLength >= expectedLength;
+
+        (*Return: Association[]*)
+        Join[packet, <|
+            "Completed" -> completed,
+            "ExpectedLength" -> expectedLength,
+            "StoredLength" -> storedLength + dataLength,
+            "DataLength" -> dataLength
+        |>]
+    ]
+];
+
+
+getMessage[handler_, extendedPacket_] :=
+With[{
+    buffer = handler["Buffer"]["Lookup", extendedPacket["SourceSocket"][[1]]],
+    expectedLength = extendedPacket["ExpectedLength"]
+},
+    If[!MissingQ[buffer] && buffer["Length"] > 0,
+
+        (*Return: _ByteArray*)
+        Part[#, 1 ;; expectedLength]& @
+        Apply[Join] @
+        Append[extendedPacket["DataByteArray"]] @
+        buffer["Elements"][[All, "DataByteArray"]],
+
+    (*Else*)
+
+        (*Return: _ByteArray*)
+        extendedPacket["DataByteArray"][[1 ;; expectedLength]]
+    ]
+];
+
+
+invokeHandler[handler_, packet_] :=
+Module[{messageHandler, defaultMessageHandler},
+    messageHandler = handler["Received"];
+
+    (*Return: ByteArray[] | _String | Null*)
+    conditionApply[messageHandler, defaultMessageHandler][packet]
+];
+
+
+CSocketHandler::cntsnd =
+"Can't send result to the client\n `1`";
+
+
+sendResponse[handler_, packet_, result: _ByteArray | _String | Null] :=
+With[{client = packet["SourceSocket"]},
+    Switch[result,
+        _String,
+            WriteString[client, result],
+
+        _ByteArray,
+            BinaryWrite[client, result],
+
+        Null,
+            Null
+    ]
+];
+
+
+sendResponse[_, _, result_] :=
+Message[CSocketHandler::cntsnd, result];
+
+
+(*A request handler returning Null replies later with CSocketRpcReply*)
+sendReply[packet_, result: _ByteArray | _String] :=
+CSocketRpcReply[packet["SourceSocket"], packet["Id"], result];
+
+
+sendReply[_, Null] :=
+Null;
+
+
+sendReply[_, result_] :=
+Message[CSocketHandler::cntsnd, result];
+
+
+(*Responses to single packet messages are served by the poll loop next time*)
+cacheResponse[packet_, result_String, ttl_] :=
+cacheResponse[packet, StringToByteArray[result], ttl];
+
+
+cacheResponse[packet_, result_ByteArray, ttl_] :=
+With[{request = packet["DataByteArray"], listenSocket = packet["Socket"], sourceSocket = packet["SourceSocket"][[1]]},
+    (*Each listener answers only from its own responses*)
+    socketCachePut[
+        If[MatchQ[listenSocket, CSocketObject[_Integer, _]], listenSocket[[1]], sourceSocket],
+        request, Length[request], result, Length[result], Round[ttl * 10^6]
+    ];
+    socketCacheEnable[sourceSocket, True];
+
+    If[MatchQ[listenSocket, CSocketObject[_Integer, _]],
+        socketCacheEnable[listenSocket[[1]], True]
+    ];
+];
+
+
+cacheResponse[___] :=
+Null;
+
+
+savePacketToBuffer[handler_, extendedPacket_] :=
+With[{
+    buffer = handler["Buffer"]["Lookup", extendedPacket["SourceSocket"][[1]]],
+    uuid = extendedPacket["SourceSocket"][[1]]
+},
+    If[!MissingQ[buffer],
+        buffer["Append", extendedPacket],
+        handler["Buffer"]["Insert", uuid -> CreateDataStructure["DynamicArray", {extendedPacket}]]
+    ]
+];
+
+
+clearBuffer[handler_, packet_] :=
+With[{buffer = handler["Buffer"]["Lookup", packet["SourceSocket"][[1]]]},
+    buffer["DropAll"];
+];
+
+
+conditionApply[conditionAndFunctions: _?AssociationQ: <||>, defalut_: Function[Null], ___] :=
+Function[
+    With[{selected = SelectFirst[conditionAndFunctions, Function[f, First[f][##]], {defalut}]},
+        selected[[-1]][##]
+    ]
+];
+
+
+$INTERUPTER = 0;
+
+
+$TCPSERVER = 1;
+
+
+$UDPSERVER = 2;
+
+
+$TCPCLIENT = 3;
+
+
+$UDPCLIENT = 4;
+
+
+$HANDOFFCHANNEL = 5;
+
+
+(* Poll loop options, see LIST_OPTION in list.h *)
+$socketListOptions = <|
+    "ReceiveLimit" -> 0,
+    "DrainBudget" -> 1,
+    "ListenerBudget" -> 2,
+    "ClientBudget" -> 3,
+    "HighWatermark" -> 4,
+    "LowWatermark" -> 5,
+    "LoopHighWatermark" -> 6,
+    "LoopLowWatermark" -> 7,
+    "EventQueue" -> 8,
+    "Timestamps" -> 9
+|>;
+
+
+$frameElementSizes = <|
+    "Integer8" -> 1, "UnsignedInteger8" -> 1,
+    "Integer16" -> 2, "UnsignedInteger16" -> 2,
+    "Integer32" -> 4, "UnsignedInteger32" -> 4, "Real32" -> 4,
+    "Integer64" -> 8, "UnsignedInteger64" -> 8, "Real64" -> 8, "ComplexReal32" -> 8,
+    "ComplexReal64" -> 16
+|>;
+
+
+(*Event kinds of drained rows, see EVENT_KIND in queue.h*)
+$eventKinds = {
+    "Received", "ReceivedFrom", "Accepted", "Closed", "Error", "MemoryLimit",
+    "ReceivedFrame", "Request", "Reply", "RelayOpened", "RelayClosed", "SendComplete"
+};
+
+
+(* Protocol levels *)
+$IPPROTOAUTO::usage = "IPPROTOAUTO - auto protocol level";
+$IPPROTOAUTO = 0;
+
+
+$IPPROTOTCP::usage = "IPPROTO_TCP - TCP protocol level";
+$IPPROTOTCP = 6;
+
+
+$IPPROTOUDP::usage = "IPPROTO_UDP - UDP protocol level";
+$IPPROTOUDP = 17;
+
+
+$IPPROTOIPV6::usage = "IPPROTO_IPV6 - IPv6 protocol level";
+$IPPROTOIPV6 = If[$OperatingSystem === "Windows", 41, 16^^0029];
+
+
+(* Socket level - platform dependent *)
+$SOL::usage = "SOL_SOCKET - socket-level options";
+$SOL = If[$OperatingSystem === "Windows", 16^^FFFF, 1];
+
+
+(* Socket options (SOL_SOCKET level) *)
+$SOKEEPALIVE::usage = "SO_KEEPALIVE - enable keep-alive packets";
+$SOKEEPALIVE = 16^^0008;
+
+
+$SORCVBUF::usage = "SO_RCVBUF - receive buffer size";
+$SORCVBUF = 16^^1002;
+
+
+$SOSNDBUF::usage = "SO_SNDBUF - send buffer size";
+$SOSNDBUF = 16^^1001;
+
+
+$SOLINGER::usage = "SO_LINGER - linger on close";
+$SOLINGER = 16^^0080;
+
+
+$SOBROADCAST::usage = "SO_BROADCAST - permit broadcast messages";
+$SOBROADCAST = 16^^0020;
+
+
+$SOERROR::usage = "SO_ERROR - get pending socket error";
+$SOERROR = 16^^1007;
+
+
+$SOMAXCONN::usage = "SOMAXCONN - maximum backlog for listen()";
+$SOMAXCONN = 16^^7FFFFFFF;
+
+
+$SOTYPE::usage = "SO_TYPE - get socket type (STREAM/DGRAM)";
+$SOTYPE = 16^^1008;
+
+
+$SOACCEPTCONN::usage = "SO_ACCEPTCONN - non-zero if socket is listening";
+$SOACCEPTCONN = 16^^0002;
+
+
+$SOREUSEADDR::usage = "SO_REUSEADDR - reuse local address";
+$SOREUSEADDR = If[$OperatingSystem === "Windows", 4, 16^^0002];
+
+
+(* TCP options (IPPROTO_TCP level) *)
+$TCPNODELAY::usage = "TCP_NODELAY - disable Nagle algorithm";
+$TCPNODELAY = 16^^0001;
+
+
+$TCPKEEPIDLE::usage = "TCP_KEEPIDLE - idle time before keep-alive probes";
+$TCPKEEPIDLE = If[$OperatingSystem === "MacOSX", 16^^0010, 16^^0004];
+
+$TCPKEEPINTVL::usage = "TCP_KEEPINTVL - interval between keep-alive probes";
+$TCPKEEPINTVL = If[$OperatingSystem === "MacOSX", 16^^0011, 16^^0005];
+
+$TCPKEEPCNT::usage = "TCP_KEEPCNT - number of keep-alive probes before drop";
+$TCPKEEPCNT = If[$OperatingSystem === "MacOSX", 16^^0012, 16^^0006];
+
+
+(* IPv4 options (IPPROTO_IP level) *)
+$IPTTL::usage = "IP_TTL - time-to-live for packets";
+$IPTTL = 16^^0004;
+
+
+$IPTOS::usage = "IP_TOS - type of service / DSCP";
+$IPTOS = 16^^0001;
+
+
+$IPMTUDISCOVER::usage = "IP_MTU_DISCOVER - path MTU discovery";
+$IPMTUDISCOVER = 16^^000A;
+
+
+(* IPv6 options (IPPROTO_IPV6 level) *)
+$IPV6V6ONLY::usage = "IPV6_V6ONLY - restrict socket to IPv6 only";
+$IPV6V6ONLY = If[$OperatingSystem === "Windows", 27, 16^^001A];
+
+
+(* Address families *)
+$AFUNIX::usage = "AF_UNIX - local interprocess communication";
+$AFUNIX = 16^^0001;
+
+
+$AFINET::usage = "AF_INET - IPv4 address family";
+$AFINET = 16^^0002;
+
+
+$AFINET6::usage = "AF_INET6 - IPv6 address family";
+$AFINET6 = 16^^000A;
+
+
+(* Socket types *)
+$SOCKSTREAM::usage = "SOCK_STREAM - reliable stream socket (TCP)";
+$SOCKSTREAM = 16^^0001;
+
+
+$SOCKDGRAM::usage = "SOCK_DGRAM - datagram socket (UDP)";
+$SOCKDGRAM = 16^^0002;
+
+
+(* Windows-specific *)
+$SOEXCLUSIVEADDRUSE::usage = "SO_EXCLUSIVEADDRUSE - exclusive address binding (Windows only)";
+$SOEXCLUSIVEADDRUSE = If[$OperatingSystem === "Windows", 16^^0001, -5];
+
+
+(*unified sockes_poll flags*)
+
+
+$POLLIN = 16^^0001;
+
+
+$POLLOUT = 16^^0002;
+
+
+$POLLERR = 16^^0004;
+
+
+$POLLHUP  = 16^^0008;
+
+
+$POLLNVAL = 16^^0010;
+
+
+If[!AssociationQ[$csockets],
+    $csockets = <||>
+];
+
+
+If[!AssociationQ[$peerHosts],
+    $peerHosts = <||>
+];
+
+
+getLibraryLinkVersion[] := getLibraryLinkVersion[] =
+Which[
+    $VersionNumber >= 14.1,
+        With[{n = LibraryVersionInformation[FindLibrary["demo"] ]["WolframLibraryVersion"]},
+            If[!NumberQ[n], If[$VersionNumber < 14.3, 7, 8], n]
+        ],
+    $VersionNumber >= 13.1,
+        7,
+    $VersionNumber >= 12.1,
+        6,
+    $VersionNumber >= 12.0,
+        5,
+    $VersionNumber >= 11.2,
+        4,
+    $VersionNumber >= 10.0,
+        3,
+    $VersionNumber >= 9.0,
+        2,
+    True,
+        1
+];
+
+
+$library = FileNameJoin[{
+    DirectoryName[$InputFileName, 2],
+    "LibraryResources",
+    $SystemID <> "-v" <> ToString[getLibraryLinkVersion[]],
+    "csockets." <> Internal`DynamicLibraryExtension[]
+}];
+
+
+(* :LibraryLoad: *)
+
+
+socketAddressInfoCreate::usage =
+"socketAddressInfoCreate[host, port, aiFamily, aiSocktype, aiProtocol, localIP] -> addressPtr.";
+
+
+socketAddressInfoCreate =
+LibraryFunctionLoad[$library, "socketAddressInfoCreate", {String, String, Integer, Integer, Integer, String}, Integer];
+
+
+socketAddressInfoRemove::usage =
+"socketAddressInfoRemove[addressPtr].";
+
+
+socketAddressInfoRemove =
+LibraryFunctionLoad[$library, "socketAddressInfoRemove", {Integer}, "Void"];
+
+
+socketPeerAddress::usage =
+"socketPeerAddress[socketId] -> address.";
+
+
+socketPeerAddress =
+LibraryFunctionLoad[$library, "socketPeerAddress", {Integer}, {Integer, 1}];
+
+
+socketPeerHost::usage =
+"socketPeerHost[hostId] -> host.";
+
+
+socketPeerHost =
+LibraryFunctionLoad[$library, "socketPeerHost", {Integer}, String];
+
+
+socketsSelectAsync::usage =
+"socketsSelectAsync[socketIds, length, timeout] -> taskId.";
+
+
+socketsSelectAsync =
+LibraryFunctionLoad[$library, "socketsSelectAsync", {{Integer, 1}, Integer, Integer}, Integer];
+
+
+createSocketsPollLoop::usage =
+"createSocketsPollLoop[socketList, bufferSize, timeout, eventsMask] -> taskId.";
+
+
+createSocketsPollLoop =
+LibraryFunctionLoad[$library, "createSocketsPollLoop", {Integer, Integer, Integer, Integer}, Integer];
+
+
+socketBroadcast::usage =
+"socketBroadcast[socketIds, byteArray] -> statuses.";
+
+
+socketBroadcast =
+LibraryFunctionLoad[$library, "socketBroadcast", {{Integer, 1}, {"ByteArray", "Shared"}}, {Integer, 1}];
+
+
+socketGroupCreate::usage =
+"socketGroupCreate[] -> groupPtr.";
+
+
+socketGroupCreate =
+LibraryFunctionLoad[$library, "socketGroupCreate", {}, Integer];
+
+
+socketGroupAdd::usage =
+"socketGroupAdd[group, socketId].";
+
+
+socketGroupAdd =
+LibraryFunctionLoad[$library, "socketGroupAdd", {Integer, Integer}, "Void"];
+
+
+socketGroupRemove::usage =
+"socketGroupRemove[group, socketId].";
+
+
+socketGroupRemove =
+LibraryFunctionLoad[$library, "socketGroupRemove", {Integer, Integer}, "Void"];
+
+
+socketGroupMembers::usage =
+"socketGroupMembers[group] -> members.";
+
+
+socketGroupMembers =
+LibraryFunctionLoad[$library, "socketGroupMembers", {Integer}, {Integer, 1}];
+
+
+socketGroupBroadcast::usage =
+"socketGroupBroadcast[group, byteArray] -> statuses.";
+
+
+socketGroupBroadcast =
+LibraryFunctionLoad[$library, "socketGroupBroadcast", {Integer, {"ByteArray", "Shared"}}, {Integer, 2}];
+
+
+socketGroupDelete::usage =
+"socketGroupDelete[group].";
+
+
+socketGroupDelete =
+LibraryFunctionLoad[$library, "socketGroupDelete", {Integer}, "Void"];
+
+
+socketBufferCreate::usage =
+"socketBufferCreate[bufferSize] -> bufferPtr.";
+
+
+socketBufferCreate =
+LibraryFunctionLoad[$library, "socketBufferCreate", {Integer}, Integer];
+
+
+socketBufferRemove::usage =
+"socketBufferRemove[buffer].";
+
+
+socketBufferRemove =
+LibraryFunctionLoad[$library, "socketBufferRemove", {Integer}, "Void"];
+
+
+socketCacheEnable::usage =
+"socketCacheEnable[socketId, enabled].";
+
+
+socketCacheEnable =
+LibraryFunctionLoad[$library, "socketCacheEnable", {Integer, Boolean}, "Void"];
+
+
+socketCacheKey::usage =
+"socketCacheKey[listener, byteArray, length] -> key.";
+
+
+socketCacheKey =
+LibraryFunctionLoad[$library, "socketCacheKey", {Integer, {"ByteArray", "Shared"}, Integer}, Integer];
+
+
+socketCachePut::usage =
+"socketCachePut[listener, requestArray, requestLength, byteArray, length, ttl] -> key.";
+
+
+socketCachePut =
+LibraryFunctionLoad[$library, "socketCachePut", {Integer, {"ByteArray", "Shared"}, Integer, {"ByteArray", "Shared"}, Integer, Integer}, Integer];
+
+
+socketCacheInvalidate::usage =
+"socketCacheInvalidate[key].";
+
+
+socketCacheInvalidate =
+LibraryFunctionLoad[$library, "socketCacheInvalidate", {Integer}, "Void"];
+
+
+socketCacheClear::usage =
+"socketCacheClear[].";
+
+
+socketCacheClear =
+LibraryFunctionLoad[$library, "socketCacheClear", {}, "Void"];
+
+
+socketCacheSetBudget::usage =
+"socketCacheSetBudget[budget].";
+
+
+socketCacheSetBudget =
+LibraryFunctionLoad[$library, "socketCacheSetBudget", {Integer}, "Void"];
+
+
+socketCacheStats::usage =
+"socketCacheStats[] -> stats.";
+
+
+socketCacheStats =
+LibraryFunctionLoad[$library, "socketCacheStats", {}, {Integer, 1}];
+
+
+socketCoalesceEnable::usage =
+"socketCoalesceEnable[socketId, threshold].";
+
+
+socketCoalesceEnable =
+LibraryFunctionLoad[$library, "socketCoalesceEnable", {Integer, Integer}, "Void"];
+
+
+socketCoalesceFlush::usage =
+"socketCoalesceFlush[socketId].";
+
+
+socketCoalesceFlush =
+LibraryFunctionLoad[$library, "socketCoalesceFlush", {Integer}, "Void"];
+
+
+socketConnPoolCheckout::usage =
+"socketConnPoolCheckout[host, port, protocol, timeout] -> socketId.";
+
+
+socketConnPoolCheckout =
+LibraryFunctionLoad[$library, "socketConnPoolCheckout", {String, Integer, Integer, Integer}, Integer];
+
+
+socketConnPoolCheckin::usage =
+"socketConnPoolCheckin[socketId, reuse] -> leased.";
+
+
+socketConnPoolCheckin =
+LibraryFunctionLoad[$library, "socketConnPoolCheckin", {Integer, Boolean}, Boolean];
+
+
+socketConnPoolSetLimits::usage =
+"socketConnPoolSetLimits[maxIdle, maxPerHost, idleTimeout].";
+
+
+socketConnPoolSetLimits =
+LibraryFunctionLoad[$library, "socketConnPoolSetLimits", {Integer, Integer, Integer}, "Void"];
+
+
+socketConnPoolClear::usage =
+"socketConnPoolClear[].";
+
+
+socketConnPoolClear =
+LibraryFunctionLoad[$library, "socketConnPoolClear", {}, "Void"];
+
+
+socketConnPoolStats::usage =
+"socketConnPoolStats[] -> stats.";
+
+
+socketConnPoolStats =
+LibraryFunctionLoad[$library, "socketConnPoolStats", {}, {Integer, 1}];
+
+
+socketSendToSegmented::usage =
+"socketSendToSegmented[socketId, host, port, byteArray, length, segmentSize] -> sent.";
+
+
+socketSendToSegmented =
+LibraryFunctionLoad[$library, "socketSendToSegmented", {Integer, String, Integer, {"ByteArray", "Shared"}, Integer, Integer}, Integer];
+
+
+socketUdpGroEnable::usage =
+"socketUdpGroEnable[socketId, enable] -> enable.";
+
+
+socketUdpGroEnable =
+LibraryFunctionLoad[$library, "socketUdpGroEnable", {Integer, Boolean}, Boolean];
+
+
+socketEventAck::usage =
+"socketEventAck[socketId, bytes].";
+
+
+socketEventAck =
+LibraryFunctionLoad[$library, "socketEventAck", {Integer, Integer}, "Void"];
+
+
+socketFlowStats::usage =
+"socketFlowStats[socketId] -> stats.";
+
+
+socketFlowStats =
+LibraryFunctionLoad[$library, "socketFlowStats", {Integer}, {Integer, 1}];
+
+
+socketFramesEnable::usage =
+"socketFramesEnable[socketId, enable].";
+
+
+socketFramesEnable =
+LibraryFunctionLoad[$library, "socketFramesEnable", {Integer, Boolean}, "Void"];
+
+
+socketSendFrame::usage =
+"socketSendFrame[socketId, numericArray] -> sentLength.";
+
+
+socketSendFrame =
+LibraryFunctionLoad[$library, "socketSendFrame", {Integer, {"NumericArray", "Shared"}}, Integer];
+
+
+socketUnixBind::usage =
+"socketUnixBind[socketId, path].";
+
+
+socketUnixBind =
+LibraryFunctionLoad[$library, "socketUnixBind", {Integer, String}, "Void"];
+
+
+socketUnixConnect::usage =
+"socketUnixConnect[socketId, path].";
+
+
+socketUnixConnect =
+LibraryFunctionLoad[$library, "socketUnixConnect", {Integer, String}, "Void"];
+
+
+socketSendDescriptor::usage =
+"socketSendDescriptor[channel, socketId].";
+
+
+socketSendDescriptor =
+LibraryFunctionLoad[$library, "socketSendDescriptor", {Integer, Integer}, "Void"];
 
-        (*Else*)
-            expectedLength = conditionApply[handler["Accumulator"]][packet];
-            storedLength = 0;
-        ];
 
-        completed = storedLength + dataLength >= expectedLength;
+socketRecvDescriptor::usage =
+"socketRecvDescriptor[channel] -> receivedSocketId.";
 
-        (*Return: Association[]*)
-        Join[packet, <|
-            "Completed" -> completed,
-            "ExpectedLength" -> expectedLength,
-            "StoredLength" -> storedLength + dataLength,
-            "DataLength" -> dataLength
-        |>]
-    ]
-];
 
+socketRecvDescriptor =
+LibraryFunctionLoad[$library, "socketRecvDescriptor", {Integer}, Integer];
 
-getMessage[handler_, extendedPacket_] :=
-With[{
-    buffer = handler["Buffer"]["Lookup", extendedPacket["SourceSocket"][[1]]],
-    expectedLength = extendedPacket["ExpectedLength"]
-},
-    If[!MissingQ[buffer] && buffer["Length"] > 0,
 
-        (*Return: _ByteArray*)
-        Part[#, 1 ;; expectedLength]& @
-        Apply[Join] @
-        Append[extendedPacket["DataByteArray"]] @
-        buffer["Elements"][[All, "DataByteArray"]],
+socketDispatcherCreate::usage =
+"socketDispatcherCreate[channels, length, mode] -> dispatcherPtr.";
 
-    (*Else*)
 
-        (*Return: _ByteArray*)
-        extendedPacket["DataByteArray"][[1 ;; expectedLength]]
-    ]
-];
+socketDispatcherCreate =
+LibraryFunctionLoad[$library, "socketDispatcherCreate", {{Integer, 1}, Integer, Integer}, Integer];
 
 
-invokeHandler[handler_, packet_] :=
-Module[{messageHandler, defaultMessageHandler},
-    messageHandler = handler["Received"];
+socketDispatcherAttach::usage =
+"socketDispatcherAttach[socketId, dispatcher].";
 
-    (*Return: ByteArray[] | _String | Null*)
-    conditionApply[messageHandler, defaultMessageHandler][packet]
-];
 
+socketDispatcherAttach =
+LibraryFunctionLoad[$library, "socketDispatcherAttach", {Integer, Integer}, "Void"];
 
-CSocketHandler::cntsnd =
-"Can't send result to the client\n `1`";
 
+socketDispatcherLoads::usage =
+"socketDispatcherLoads[dispatcher] -> loads.";
 
-sendResponse[handler_, packet_, result: _ByteArray | _String | Null] :=
-With[{client = packet["SourceSocket"]},
-    Switch[result,
-        _String,
-            WriteString[client, result],
 
-        _ByteArray,
-            BinaryWrite[client, result],
+socketDispatcherLoads =
+LibraryFunctionLoad[$library, "socketDispatcherLoads", {Integer}, {Integer, 1}];
 
-        Null,
-            Null
-    ]
-];
 
+socketImpair::usage =
+"socketImpair[socketId, delay, jitter, bandwidth, segment, drop, reorder].";
 
-sendResponse[_, _, result_] :=
-Message[CSocketHandler::cntsnd, result];
 
+socketImpair =
+LibraryFunctionLoad[$library, "socketImpair", {Integer, Integer, Integer, Integer, Integer, Real, Real}, "Void"];
 
-savePacketToBuffer[handler_, extendedPacket_] :=
-With[{
-    buffer = handler["Buffer"]["Lookup", extendedPacket["SourceSocket"][[1]]],
-    uuid = extendedPacket["SourceSocket"][[1]]
-},
-    If[!MissingQ[buffer],
-        buffer["Append", extendedPacket],
-        handler["Buffer"]["Insert", uuid -> CreateDataStructure["DynamicArray", {extendedPacket}]]
-    ]
-];
 
+socketLatencyEnable::usage =
+"socketLatencyEnable[socketId, enable].";
 
-clearBuffer[handler_, packet_] :=
-With[{buffer = handler["Buffer"]["Lookup", packet["SourceSocket"][[1]]]},
-    buffer["DropAll"];
-];
 
+socketLatencyEnable =
+LibraryFunctionLoad[$library, "socketLatencyEnable", {Integer, Boolean}, "Void"];
 
-conditionApply[conditionAndFunctions: _?AssociationQ: <||>, defalut_: Function[Null], ___] :=
-Function[
-    With[{selected = SelectFirst[conditionAndFunctions, Function[f, First[f][##]], {defalut}]},
-        selected[[-1]][##]
-    ]
-];
 
+socketLatencyStats::usage =
+"socketLatencyStats[socketId, reset] -> stats.";
 
-$INTERUPTER = 0;
 
+socketLatencyStats =
+LibraryFunctionLoad[$library, "socketLatencyStats", {Integer, Boolean}, {Integer, 1}];
 
-$TCPSERVER = 1;
 
+socketListCreate::usage =
+"socketListCreate[sockets, types, length] -> socketListPtr.";
 
-$UDPSERVER = 2;
 
+socketListCreate =
+LibraryFunctionLoad[$library, "socketListCreate", {{Integer, 1}, {Integer, 1}, Integer}, Integer];
 
-$TCPCLIENT = 3;
 
+socketListAdd::usage =
+"socketListAdd[socketList, socketId, socketType].";
 
-$UDPCLIENT = 4
 
+socketListAdd =
+LibraryFunctionLoad[$library, "socketListAdd", {Integer, Integer, Integer}, "Void"];
 
-(* Protocol levels *)
-$IPPROTOAUTO::usage = "IPPROTOAUTO - auto protocol level";
-$IPPROTOAUTO = 0;
 
+socketListSetOption::usage =
+"socketListSetOption[socketList, option, value].";
 
-$IPPROTOTCP::usage = "IPPROTO_TCP - TCP protocol level";
-$IPPROTOTCP = 6;
 
+socketListSetOption =
+LibraryFunctionLoad[$library, "socketListSetOption", {Integer, Integer, Integer}, "Void"];
 
-$IPPROTOUDP::usage = "IPPROTO_UDP - UDP protocol level";
-$IPPROTOUDP = 17;
 
+socketListGetAll::usage =
+"socketListGetAll[socketList] -> socketsTensor.";
 
-$IPPROTOIPV6::usage = "IPPROTO_IPV6 - IPv6 protocol level";
-$IPPROTOIPV6 = If[$OperatingSystem === "Windows", 41, 16^^0029];
 
+socketListGetAll =
+LibraryFunctionLoad[$library, "socketListGetAll", {Integer}, {Integer, 2}];
 
-(* Socket level - platform dependent *)
-$SOL::usage = "SOL_SOCKET - socket-level options";
-$SOL = If[$OperatingSystem === "Windows", 16^^FFFF, 1];
 
+socketListPrune::usage =
+"socketListPrune[socketList].";
 
-(* Socket options (SOL_SOCKET level) *)
-$SOKEEPALIVE::usage = "SO_KEEPALIVE - enable keep-alive packets";
-$SOKEEPALIVE = 16^^0008;
 
+socketListPrune =
+LibraryFunctionLoad[$library, "socketListPrune", {Integer}, "Void"];
 
-$SORCVBUF::usage = "SO_RCVBUF - receive buffer size";
-$SORCVBUF = 16^^1002;
 
+socketListDelete::usage =
+"socketListDelete[socketList].";
 
-$SOSNDBUF::usage = "SO_SNDBUF - send buffer size";
-$SOSNDBUF = 16^^1001;
 
+socketListDelete =
+LibraryFunctionLoad[$library, "socketListDelete", {Integer}, "Void"];
 
-$SOLINGER::usage = "SO_LINGER - linger on close";
-$SOLINGER = 16^^0080;
 
+socketMemorySetLimits::usage =
+"socketMemorySetLimits[limit, connectionLimit, shed].";
 
-$SOBROADCAST::usage = "SO_BROADCAST - permit broadcast messages";
-$SOBROADCAST = 16^^0020;
 
+socketMemorySetLimits =
+LibraryFunctionLoad[$library, "socketMemorySetLimits", {Integer, Integer, Boolean}, "Void"];
 
-$SOERROR::usage = "SO_ERROR - get pending socket error";
-$SOERROR = 16^^1007;
 
+socketMemoryUsage::usage =
+"socketMemoryUsage[socketId] -> usage.";
 
-$SOMAXCONN::usage = "SOMAXCONN - maximum backlog for listen()";
-$SOMAXCONN = 16^^7FFFFFFF;
 
+socketMemoryUsage =
+LibraryFunctionLoad[$library, "socketMemoryUsage", {Integer}, {Integer, 1}];
 
-$SOTYPE::usage = "SO_TYPE - get socket type (STREAM/DGRAM)";
-$SOTYPE = 16^^1008;
 
+socketPluginLoad::usage =
+"socketPluginLoad[path] -> pluginPtr.";
 
-$SOACCEPTCONN::usage = "SO_ACCEPTCONN - non-zero if socket is listening";
-$SOACCEPTCONN = 16^^0002;
 
+socketPluginLoad =
+LibraryFunctionLoad[$library, "socketPluginLoad", {String}, Integer];
 
-$SOREUSEADDR::usage = "SO_REUSEADDR - reuse local address";
-$SOREUSEADDR = If[$OperatingSystem === "Windows", 4, 16^^0002];
 
+socketPluginAttach::usage =
+"socketPluginAttach[socketId, plugin].";
 
-(* TCP options (IPPROTO_TCP level) *)
-$TCPNODELAY::usage = "TCP_NODELAY - disable Nagle algorithm";
-$TCPNODELAY = 16^^0001;
 
+socketPluginAttach =
+LibraryFunctionLoad[$library, "socketPluginAttach", {Integer, Integer}, "Void"];
 
-$TCPKEEPIDLE::usage = "TCP_KEEPIDLE - idle time before keep-alive probes";
-$TCPKEEPIDLE = If[$OperatingSystem === "MacOSX", 16^^0010, 16^^0004];
 
-$TCPKEEPINTVL::usage = "TCP_KEEPINTVL - interval between keep-alive probes";
-$TCPKEEPINTVL = If[$OperatingSystem === "MacOSX", 16^^0011, 16^^0005];
+socketPollSetCreate::usage =
+"socketPollSetCreate[] -> pollSetPtr.";
 
-$TCPKEEPCNT::usage = "TCP_KEEPCNT - number of keep-alive probes before drop";
-$TCPKEEPCNT = If[$OperatingSystem === "MacOSX", 16^^0012, 16^^0006];
 
+socketPollSetCreate =
+LibraryFunctionLoad[$library, "socketPollSetCreate", {}, Integer];
 
-(* IPv4 options (IPPROTO_IP level) *)
-$IPTTL::usage = "IP_TTL - time-to-live for packets";
-$IPTTL = 16^^0004;
 
+socketPollSetAdd::usage =
+"socketPollSetAdd[pollSet, socketId, eventsMask].";
 
-$IPTOS::usage = "IP_TOS - type of service / DSCP";
-$IPTOS = 16^^0001;
 
+socketPollSetAdd =
+LibraryFunctionLoad[$library, "socketPollSetAdd", {Integer, Integer, Integer}, "Void"];
 
-$IPMTUDISCOVER::usage = "IP_MTU_DISCOVER - path MTU discovery";
-$IPMTUDISCOVER = 16^^000A;
 
+socketPollSetModify::usage =
+"socketPollSetModify[pollSet, socketId, eventsMask].";
 
-(* IPv6 options (IPPROTO_IPV6 level) *)
-$IPV6V6ONLY::usage = "IPV6_V6ONLY - restrict socket to IPv6 only";
-$IPV6V6ONLY = If[$OperatingSystem === "Windows", 27, 16^^001A];
 
+socketPollSetModify =
+LibraryFunctionLoad[$library, "socketPollSetModify", {Integer, Integer, Integer}, "Void"];
 
-(* Address families *)
-$AFINET::usage = "AF_INET - IPv4 address family";
-$AFINET = 16^^0002;
 
+socketPollSetRemove::usage =
+"socketPollSetRemove[pollSet, socketId].";
 
-$AFINET6::usage = "AF_INET6 - IPv6 address family";
-$AFINET6 = 16^^000A;
 
+socketPollSetRemove =
+LibraryFunctionLoad[$library, "socketPollSetRemove", {Integer, Integer}, "Void"];
 
-(* Socket types *)
-$SOCKSTREAM::usage = "SOCK_STREAM - reliable stream socket (TCP)";
-$SOCKSTREAM = 16^^0001;
 
+socketPollSetWait::usage =
+"socketPollSetWait[pollSet, maxEvents, timeout] -> readyTensor.";
 
-$SOCKDGRAM::usage = "SOCK_DGRAM - datagram socket (UDP)";
-$SOCKDGRAM = 16^^0002;
 
+socketPollSetWait =
+LibraryFunctionLoad[$library, "socketPollSetWait", {Integer, Integer, Integer}, {Integer, 2}];
 
-(* Windows-specific *)
-$SOEXCLUSIVEADDRUSE::usage = "SO_EXCLUSIVEADDRUSE - exclusive address binding (Windows only)";
-$SOEXCLUSIVEADDRUSE = If[$OperatingSystem === "Windows", 16^^0001, -5];
 
+socketPollSetLength::usage =
+"socketPollSetLength[pollSet] -> pollSet->length.";
 
-(*unified sockes_poll flags*)
 
+socketPollSetLength =
+LibraryFunctionLoad[$library, "socketPollSetLength", {Integer}, Integer];
 
-$POLLIN = 16^^0001;
 
+socketPollSetDelete::usage =
+"socketPollSetDelete[pollSet].";
 
-$POLLOUT = 16^^0002;
 
+socketPollSetDelete =
+LibraryFunctionLoad[$library, "socketPollSetDelete", {Integer}, "Void"];
 
-$POLLERR = 16^^0004;
 
+socketPoolStats::usage =
+"socketPoolStats[] -> stats.";
 
-$POLLHUP  = 16^^0008;
 
+socketPoolStats =
+LibraryFunctionLoad[$library, "socketPoolStats", {}, {Integer, 1}];
 
-$POLLNVAL = 16^^0010;
 
+socketEventsDrain::usage =
+"socketEventsDrain[socketList, max, timeout] -> dataStore.";
 
-If[!AssociationQ[$csockets],
-    $csockets = <||>
-];
 
+socketEventsDrain =
+LibraryFunctionLoad[$library, "socketEventsDrain", {Integer, Integer, Integer}, "DataStore"];
 
-getLibraryLinkVersion[] := getLibraryLinkVersion[] =
-Which[
-    $VersionNumber >= 14.1,
-        With[{n = LibraryVersionInformation[FindLibrary["demo"] ]["WolframLibraryVersion"]},
-            If[!NumberQ[n], If[$VersionNumber < 14.3, 7, 8], n]
-        ],
-    $VersionNumber >= 13.1,
-        7,
-    $VersionNumber >= 12.1,
-        6,
-    $VersionNumber >= 12.0,
-        5,
-    $VersionNumber >= 11.2,
-        4,
-    $VersionNumber >= 10.0,
-        3,
-    $VersionNumber >= 9.0,
-        2,
-    True,
-        1
-];
 
+socketReadExact::usage =
+"socketReadExact[socketId, length, timeout] -> byteArray.";
 
-$library = FileNameJoin[{
-    DirectoryName[$InputFileName, 2],
-    "LibraryResources",
-    $SystemID <> "-v" <> ToString[getLibraryLinkVersion[]],
-    "csockets." <> Internal`DynamicLibraryExtension[]
-}];
 
+socketReadExact =
+LibraryFunctionLoad[$library, "socketReadExact", {Integer, Integer, Integer}, "ByteArray"];
 
-(* :LibraryLoad: *)
 
+socketReadUntil::usage =
+"socketReadUntil[socketId, delimiterArray, delimiterLength, limit, timeout] -> byteArray.";
 
-socketAddressInfoCreate::usage =
-"socketAddressInfoCreate[host, port, aiFamily, aiSocktype, aiProtocol, localIP] -> addressPtr.";
 
+socketReadUntil =
+LibraryFunctionLoad[$library, "socketReadUntil", {Integer, {"ByteArray", "Shared"}, Integer, Integer, Integer}, "ByteArray"];
 
-socketAddressInfoCreate =
-LibraryFunctionLoad[$library, "socketAddressInfoCreate", {String, String, Integer, Integer, Integer, String}, Integer];
 
+socketReadToEOF::usage =
+"socketReadToEOF[socketId, limit, timeout] -> byteArray.";
 
-socketAddressInfoRemove::usage =
-"socketAddressInfoRemove[addressPtr].";
 
+socketReadToEOF =
+LibraryFunctionLoad[$library, "socketReadToEOF", {Integer, Integer, Integer}, "ByteArray"];
 
-socketAddressInfoRemove =
-LibraryFunctionLoad[$library, "socketAddressInfoRemove", {Integer}, "Void"];
 
+socketRecorderStart::usage =
+"socketRecorderStart[socketList, path] -> opened.";
 
-socketsSelectAsync::usage =
-"socketsSelectAsync[socketIds, length, timeout] -> taskId.";
 
+socketRecorderStart =
+LibraryFunctionLoad[$library, "socketRecorderStart", {Integer, String}, Boolean];
 
-socketsSelectAsync =
-LibraryFunctionLoad[$library, "socketsSelectAsync", {{Integer, 1}, Integer, Integer}, Integer];
 
+socketRecorderStop::usage =
+"socketRecorderStop[socketList] -> result.";
 
-createSocketsPollLoop::usage =
-"createSocketsPollLoop[socketList, bufferSize, timeout, eventsMask] -> taskId.";
 
+socketRecorderStop =
+LibraryFunctionLoad[$library, "socketRecorderStop", {Integer}, {Integer, 1}];
 
-createSocketsPollLoop =
-LibraryFunctionLoad[$library, "createSocketsPollLoop", {Integer, Integer, Integer, Integer}, Integer];
 
+socketReplay::usage =
+"socketReplay[path, host, port, speed] -> result.";
 
-socketBufferCreate::usage =
-"socketBufferCreate[bufferSize] -> bufferPtr.";
 
+socketReplay =
+LibraryFunctionLoad[$library, "socketReplay", {String, String, Integer, Real}, {Integer, 1}];
 
-socketBufferCreate =
-LibraryFunctionLoad[$library, "socketBufferCreate", {Integer}, Integer];
 
+socketRelay::usage =
+"socketRelay[source, target].";
 
-socketBufferRemove::usage =
-"socketBufferRemove[buffer].";
 
+socketRelay =
+LibraryFunctionLoad[$library, "socketRelay", {Integer, Integer}, "Void"];
 
-socketBufferRemove =
-LibraryFunctionLoad[$library, "socketBufferRemove", {Integer}, "Void"];
 
+socketRpcEnable::usage =
+"socketRpcEnable[socketId, server].";
 
-socketListCreate::usage =
-"socketListCreate[sockets, types, length] -> socketListPtr.";
 
+socketRpcEnable =
+LibraryFunctionLoad[$library, "socketRpcEnable", {Integer, Boolean}, "Void"];
 
-socketListCreate =
-LibraryFunctionLoad[$library, "socketListCreate", {{Integer, 1}, {Integer, 1}, Integer}, Integer];
 
+socketRpcCall::usage =
+"socketRpcCall[socketId, byteArray, wait] -> id.";
 
-socketListAdd::usage =
-"socketListAdd[socketList, socketId, socketType].";
 
+socketRpcCall =
+LibraryFunctionLoad[$library, "socketRpcCall", {Integer, {"ByteArray", "Shared"}, Boolean}, Integer];
 
-socketListAdd =
-LibraryFunctionLoad[$library, "socketListAdd", {Integer, Integer, Integer}, "Void"];
 
+socketRpcReply::usage =
+"socketRpcReply[socketId, id, byteArray] -> sentLength.";
 
-socketListGetAll::usage =
-"socketListGetAll[socketList] -> socketsTensor.";
 
+socketRpcReply =
+LibraryFunctionLoad[$library, "socketRpcReply", {Integer, Integer, {"ByteArray", "Shared"}}, Integer];
 
-socketListGetAll =
-LibraryFunctionLoad[$library, "socketListGetAll", {Integer}, {Integer, 2}];
 
+socketRpcWait::usage =
+"socketRpcWait[socketId, id, timeout] -> reply.";
 
-socketListPrune::usage =
-"socketListPrune[socketList].";
 
+socketRpcWait =
+LibraryFunctionLoad[$library, "socketRpcWait", {Integer, Integer, Integer}, "ByteArray"];
 
-socketListPrune =
-LibraryFunctionLoad[$library, "socketListPrune", {Integer}, "Void"];
 
+socketRpcCancel::usage =
+"socketRpcCancel[socketId, id] -> found.";
 
-socketListDelete::usage =
-"socketListDelete[socketList].";
 
+socketRpcCancel =
+LibraryFunctionLoad[$library, "socketRpcCancel", {Integer, Integer}, Boolean];
 
-socketListDelete =
-LibraryFunctionLoad[$library, "socketListDelete", {Integer}, "Void"];
+
+socketRpcPending::usage =
+"socketRpcPending[socketId] -> pending.";
+
+
+socketRpcPending =
+LibraryFunctionLoad[$library, "socketRpcPending", {Integer}, Integer];
 
 
 socketCreate::usage =
@@ -843,7 +2087,7 @@ LibraryFunctionLoad[$library, "socketsCheck", {{Integer, 1}, Integer}, {Integer,
 
 
 socketIsConnected::usage =
-"socketIsConnected[sockedId] -> False.";
+"socketIsConnected[sockedId] -> isConnectedSocket(sockedId.";
 
 
 socketIsConnected =
@@ -866,6 +2110,22 @@ socketsPoll =
 LibraryFunctionLoad[$library, "socketsPoll", {{Integer, 1}, Integer, Integer, Integer}, {Integer, 2}];
 
 
+socketZeroCopyEnable::usage =
+"socketZeroCopyEnable[socketId, threshold].";
+
+
+socketZeroCopyEnable =
+LibraryFunctionLoad[$library, "socketZeroCopyEnable", {Integer, Integer}, "Void"];
+
+
+socketZeroCopyPending::usage =
+"socketZeroCopyPending[socketId] -> pending.";
+
+
+socketZeroCopyPending =
+LibraryFunctionLoad[$library, "socketZeroCopyPending", {Integer}, {Integer, 1}];
+
+
 End[];
 
 
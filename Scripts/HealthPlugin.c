@@ -0,0 +1,34 @@
+/*
+Example native handler plugin: answers health checks on the I/O thread and
+forwards everything else to Wolfram Language.
+
+    CreateLibrary[{"Scripts/HealthPlugin.c"}, "healthplugin", "IncludeDirectories" -> {"Source"}]
+
+    plugin = CSocketPluginLoad[path];
+    CSocketPluginAttach[server, plugin];
+*/
+
+
+#include "plugin.h"
+
+
+static const char healthRequest[] = "GET /health ";
+
+
+static const char healthResponse[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Content-Type: text/plain\r\n"
+    "Content-Length: 2\r\n"
+    "\r\n"
+    "OK";
+
+
+DLLEXPORT int csockets_on_message(PluginContext context, const BYTE *data, size_t length)
+{
+    if (length < sizeof(healthRequest) - 1 || memcmp(data, healthRequest, sizeof(healthRequest) - 1) != 0) {
+        return PLUGIN_FORWARD;
+    }
+
+    context->send(context->socketId, (const BYTE *)healthResponse, sizeof(healthResponse) - 1);
+    return PLUGIN_HANDLED;
+}
\ No newline at end of file
@@ -1,6 +1,15 @@
 #include "address.h"
 
 
+static AddressHost addressBuckets[ADDRESS_BUCKETS];
+static AddressHost addressIds[ADDRESS_BUCKETS];
+static AddressHost addressIdleHead = NULL;
+static AddressHost addressIdleTail = NULL;
+static mint addressIdleCount = 0;
+static mint addressLastId = 0;
+static Mutex addressMutex = MUTEX_INITIALIZER;
+
+
 DLLEXPORT int socketAddressInfoCreate(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
 {
     char *host = MArgument_getUTF8String(Args[0]);        // remote host (can be NULL)
@@ -63,4 +72,214 @@ DLLEXPORT int socketAddressInfoRemove(WolframLibraryData libData, mint Argc, MAr
 
     freeaddrinfo(address);
     return LIBRARY_NO_ERROR;
-}
\ No newline at end of file
+}
+
+
+DLLEXPORT int socketPeerAddress(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+
+    SocketState state = socket_state_get(socketId);
+    if (state == NULL || state->peerHost == 0) {
+        socket_state_release(state);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MTensor address;
+    mint length = 2;
+    libData->MTensor_new(MType_Integer, 1, &length, &address);
+    mint *addressData = libData->MTensor_getIntegerData(address);
+    addressData[0] = state->peerHost;
+    addressData[1] = state->peerPort;
+    socket_state_release(state);
+
+    MArgument_setMTensor(Res, address);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPeerHost(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint hostId = MArgument_getInteger(Args[0]);
+
+    // the kernel copies the result after the call returns
+    static char host[INET6_ADDRSTRLEN];
+    if (!address_host(hostId, host, sizeof(host))) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setUTF8String(Res, host);
+    return LIBRARY_NO_ERROR;
+}
+
+
+static uint64_t address_hash(const char *host)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const char *c = host; *c != '\0'; c++) {
+        hash = (hash ^ (uint8_t)*c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+
+// Idle list helpers, the caller holds addressMutex
+static void address_idle_remove(AddressHost entry)
+{
+    if (entry->idlePrev != NULL) {
+        entry->idlePrev->idleNext = entry->idleNext;
+    } else {
+        addressIdleHead = entry->idleNext;
+    }
+    if (entry->idleNext != NULL) {
+        entry->idleNext->idlePrev = entry->idlePrev;
+    } else {
+        addressIdleTail = entry->idlePrev;
+    }
+    entry->idlePrev = NULL;
+    entry->idleNext = NULL;
+    addressIdleCount--;
+}
+
+
+static void address_idle_append(AddressHost entry)
+{
+    entry->idlePrev = addressIdleTail;
+    entry->idleNext = NULL;
+    if (addressIdleTail != NULL) {
+        addressIdleTail->idleNext = entry;
+    } else {
+        addressIdleHead = entry;
+    }
+    addressIdleTail = entry;
+    addressIdleCount++;
+}
+
+
+static void address_unlink(AddressHost entry)
+{
+    AddressHost *link = &addressBuckets[address_hash(entry->host) % ADDRESS_BUCKETS];
+    while (*link != entry) {
+        link = &(*link)->next;
+    }
+    *link = entry->next;
+
+    link = &addressIds[(uint64_t)entry->id % ADDRESS_BUCKETS];
+    while (*link != entry) {
+        link = &(*link)->idNext;
+    }
+    *link = entry->idNext;
+}
+
+
+// Frees the least recently seen unreferenced hosts past ADDRESS_IDLE_MAX
+static void address_trim()
+{
+    while (addressIdleCount > ADDRESS_IDLE_MAX) {
+        AddressHost entry = addressIdleHead;
+        address_idle_remove(entry);
+        address_unlink(entry);
+        free(entry);
+    }
+}
+
+
+// Looks the host up or adds it, the caller holds addressMutex
+static AddressHost address_find(const char *host, bool *created)
+{
+    AddressHost *link = &addressBuckets[address_hash(host) % ADDRESS_BUCKETS];
+    while (*link != NULL && strcmp((*link)->host, host) != 0) {
+        link = &(*link)->next;
+    }
+
+    *created = *link == NULL;
+    if (!*created) {
+        return *link;
+    }
+
+    AddressHost entry = calloc(1, sizeof(struct AddressHost_st));
+    if (entry == NULL) {
+        *created = false;
+        return NULL;
+    }
+    snprintf(entry->host, sizeof(entry->host), "%s", host);
+    entry->id = ++addressLastId;
+    *link = entry;
+
+    AddressHost *idLink = &addressIds[(uint64_t)entry->id % ADDRESS_BUCKETS];
+    entry->idNext = *idLink;
+    *idLink = entry;
+
+    address_idle_append(entry);
+    return entry;
+}
+
+
+// Returns a stable id starting from 1 without holding the host, which stays
+// resolvable until ADDRESS_IDLE_MAX newer unreferenced hosts push it out.
+// Sets created for a host seen first, 0 when out of memory.
+mint address_intern(const char *host, bool *created)
+{
+    mutex_lock(&addressMutex);
+    AddressHost entry = address_find(host, created);
+    mint id = 0;
+    if (entry != NULL) {
+        // seen again, so it is the last to go
+        if (entry->refs == 0) {
+            address_idle_remove(entry);
+            address_idle_append(entry);
+        }
+        id = entry->id;
+        address_trim();
+    }
+    mutex_unlock(&addressMutex);
+    return id;
+}
+
+
+// Same as address_intern but holds the host until address_release
+mint address_acquire(const char *host, bool *created)
+{
+    mutex_lock(&addressMutex);
+    AddressHost entry = address_find(host, created);
+    mint id = 0;
+    if (entry != NULL) {
+        if (entry->refs++ == 0) {
+            address_idle_remove(entry);
+        }
+        id = entry->id;
+    }
+    mutex_unlock(&addressMutex);
+    return id;
+}
+
+
+void address_release(mint id)
+{
+    mutex_lock(&addressMutex);
+    AddressHost entry = addressIds[(uint64_t)id % ADDRESS_BUCKETS];
+    while (entry != NULL && entry->id != id) {
+        entry = entry->idNext;
+    }
+    if (entry != NULL && entry->refs > 0 && --entry->refs == 0) {
+        address_idle_append(entry);
+        address_trim();
+    }
+    mutex_unlock(&addressMutex);
+}
+
+
+// Copies the host out, false when the id is unknown or was freed
+bool address_host(mint id, char *host, size_t hostLength)
+{
+    mutex_lock(&addressMutex);
+    AddressHost entry = id > 0 ? addressIds[(uint64_t)id % ADDRESS_BUCKETS] : NULL;
+    while (entry != NULL && entry->id != id) {
+        entry = entry->idNext;
+    }
+    if (entry != NULL) {
+        snprintf(host, hostLength, "%s", entry->host);
+    }
+    mutex_unlock(&addressMutex);
+    return entry != NULL;
+}
@@ -3,6 +3,41 @@
 
 
 #include "common.h"
+#include "state.h"
+
+
+#define ADDRESS_BUCKETS 1024
+
+
+// Hosts no socket refers to that are kept, oldest first out
+#define ADDRESS_IDLE_MAX 4096
+
+
+// Peer host strings are interned once and referred to by id afterwards.
+// Sockets hold a reference, unreferenced hosts wait on the idle list so a
+// returning peer keeps its id. Ids are never reused.
+typedef struct AddressHost_st
+{
+    mint id;
+    mint refs;
+    char host[INET6_ADDRSTRLEN];
+    struct AddressHost_st *next;
+    struct AddressHost_st *idNext;
+    struct AddressHost_st *idlePrev;
+    struct AddressHost_st *idleNext;
+} *AddressHost;
+
+
+mint address_intern(const char *host, bool *created);
+
+
+mint address_acquire(const char *host, bool *created);
+
+
+void address_release(mint id);
+
+
+bool address_host(mint id, char *host, size_t hostLength);
 
 
 #endif
\ No newline at end of file
@@ -1,6 +1,14 @@
 #include "async.h"
 
 
+// Every event leaves the library here
+static void async_raise(WolframLibraryData libData, mint taskId, char *event, DataStore dataStore)
+{
+    TRACE_RAISE(taskId, event);
+    libData->ioLibraryFunctions->raiseAsyncEvent(taskId, event, dataStore);
+}
+
+
 void socketsSelectTask(mint taskId, void *taskArgs)
 {
     SocketsSelectArgs socketsSelectTaskArgs = (SocketsSelectArgs)taskArgs;
@@ -28,12 +36,13 @@ void socketsSelectTask(mint taskId, void *taskArgs)
 
         DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
         libData->ioLibraryFunctions->DataStore_addMTensor(dataStore, readySockets);
-        libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Selected", dataStore);
+        async_raise(libData, taskId, "Selected", dataStore);
         libData->MTensor_free(readySockets);
     }
 
-    free(sockets);
-    free(taskArgs);
+    pool_free(sockets);
+    pool_free(taskArgs);
+    pool_thread_release();
 }
 
 
@@ -43,10 +52,10 @@ DLLEXPORT int socketsSelectAsync(WolframLibraryData libData, mint Argc, MArgumen
     size_t length = (size_t)MArgument_getInteger(Args[1]); // number of sockets
     int timeout = (int)MArgument_getInteger(Args[2]);      // timeout in microseconds
 
-    SOCKET *sockets = malloc(length * sizeof(SOCKET));
+    SOCKET *sockets = pool_alloc(length * sizeof(SOCKET));
     copy_tensor_to_socket_array(libData, socketIds, sockets, length);
 
-    SocketsSelectArgs taskArgs = malloc(sizeof(struct SocketsSelectArgs_st));
+    SocketsSelectArgs taskArgs = pool_alloc(sizeof(struct SocketsSelectArgs_st));
 
     taskArgs->libData = libData;
     taskArgs->sockets = sockets;
@@ -60,6 +69,442 @@ DLLEXPORT int socketsSelectAsync(WolframLibraryData libData, mint Argc, MArgumen
 }
 
 
+// Hands an event to the socket list's queue in queued mode, waiting while
+// the consumer catches up and splitting payloads larger than the arena,
+// returns false when the loop raises events instead
+static bool loop_queue(WolframLibraryData libData, mint taskId, SocketList socketList, EVENT_KIND kind,
+    SOCKET socketId, SOCKET_TYPE socketType, mint value1, mint value2, mint value3, const BYTE *payload, size_t length)
+{
+    EventQueue queue = socketList->eventQueue;
+    if (!event_queue_active(queue)) {
+        return false;
+    }
+
+    size_t offset = 0;
+    do {
+        struct EventRecord_st record = {kind, (mint)socketId, (mint)socketType, {value1, value2, value3}, 0, 0};
+        size_t chunk = length - offset < (size_t)queue->arenaCapacity ? length - offset : (size_t)queue->arenaCapacity;
+        record.length = (mint)chunk;
+
+        for (;;) {
+            mint generation = wakeup_generation(&queue->wakeup);
+            if (event_queue_push(queue, &record, payload != NULL ? payload + offset : NULL)) {
+                break;
+            }
+            if (!libData->ioLibraryFunctions->asynchronousTaskAliveQ(taskId)) {
+                return true;
+            }
+            wakeup_wait(&queue->wakeup, generation, EVENT_QUEUE_ALIVE_CHECK);
+        }
+        offset += chunk;
+    } while (offset < length);
+
+    return true;
+}
+
+
+// Returns true while writes queued for a connection whose peer finished
+// sending still have to go out, the peer may be reading until it sees them
+static bool peer_linger(SocketState state, SOCKET socketId)
+{
+    if (state == NULL || !coalesce_pending(state->coalesce) || coalesce_flush(socketId, state->coalesce) < 0) {
+        return false;
+    }
+    return coalesce_pending(state->coalesce);
+}
+
+
+// Closes both relayed sockets and reports how many bytes went each way
+static void relay_close(WolframLibraryData libData, mint taskId, SocketList socketList, Relay relay)
+{
+    SOCKET source = relay->forward.source;
+    SOCKET target = relay->forward.target;
+
+    socket_list_drop(socketList, socket_list_find(socketList, source));
+    socket_list_drop(socketList, socket_list_find(socketList, target));
+    CLOSESOCKET(source);
+    CLOSESOCKET(target);
+
+    if (!loop_queue(libData, taskId, socketList, EVENT_RELAY_CLOSED, source, TCP_CLIENT,
+        (mint)target, relay->forward.bytes, relay->backward.bytes, NULL, 0)) {
+        DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)source);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)target);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, relay->forward.bytes);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, relay->backward.bytes);
+        async_raise(libData, taskId, "RelayClosed", dataStore);
+    }
+
+    relay_free(relay);
+}
+
+
+// Adopts descriptors handed off by another process as TCP clients and
+// applies release notices from workers, returns false when the channel closed
+static bool handoff_channel_read(WolframLibraryData libData, mint taskId, SocketList socketList, SocketState state, SOCKET channel)
+{
+    SOCKET sockets[HANDOFF_MAX_DESCRIPTORS];
+    int socketsLength;
+    int releases;
+
+    int result = handoff_recv(channel, sockets, &socketsLength, &releases);
+    if (result <= 0) {
+        return result < 0 && is_wouldblock_err(GETSOCKETERRNO());
+    }
+
+    if (releases > 0 && state != NULL && state->dispatcher != NULL) {
+        dispatcher_release(state->dispatcher, channel, releases);
+    }
+
+    for (int i = 0; i < socketsLength; i++) {
+        socket_list_add(socketList, sockets[i], TCP_CLIENT)->handoffChannel = channel;
+
+        if (loop_queue(libData, taskId, socketList, EVENT_ACCEPTED, channel, HANDOFF_CHANNEL, (mint)sockets[i], 0, 0, NULL, 0)) {
+            continue;
+        }
+
+        DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)channel);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, HANDOFF_CHANNEL);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)sockets[i]);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+        async_raise(libData, taskId, "Accepted", dataStore);
+    }
+
+    return true;
+}
+
+
+// Drains the backlog up to the budget and reports the connections left to
+// the kernel in one AcceptedBatch event with rows {socketId, hostId, port}
+// followed by {hostId, host} pairs for hosts not seen before, returns the
+// number of connections taken from the backlog
+static mint accept_batch(WolframLibraryData libData, mint taskId, SocketList socketList, SocketState state,
+    SOCKET socketId, mint budget, bool *needPrune)
+{
+    mint *accepted = pool_alloc(sizeof(mint) * 3 * budget);
+    mint *createdHosts = pool_alloc(sizeof(mint) * budget);
+    mint count = 0;
+    mint forwarded = 0;
+    mint created = 0;
+    int err = 0;
+
+    while (count < budget) {
+        struct sockaddr_storage address;
+        socklen_t addressLength = sizeof(address);
+
+        SOCKET acceptedSocketId = accept_nonblocking(socketId, &address, &addressLength);
+        if (!ISVALIDSOCKET(acceptedSocketId)) {
+            err = GETSOCKETERRNO();
+            break;
+        }
+        TRACE_ACCEPT(socketId, acceptedSocketId);
+        count++;
+
+        if (state != NULL && state->dispatcher != NULL && dispatcher_handoff(state->dispatcher, acceptedSocketId)) {
+            CLOSESOCKET(acceptedSocketId);
+            continue;
+        }
+
+        SocketState acceptedState = socket_list_add(socketList, acceptedSocketId, TCP_CLIENT);
+        recorder_write(socketList->recorder, RECORD_ACCEPT, acceptedSocketId, TCP_CLIENT, socketId, NULL, 0);
+
+        acceptedState->listener = socketId;
+        acceptedState->cached = state != NULL && state->cached;
+        acceptedState->coalesceThreshold = state != NULL ? state->coalesceThreshold : 0;
+        acceptedState->framed = state != NULL && state->framed;
+        if (state != NULL && state->zerocopyThreshold > 0) {
+            #ifdef ZEROCOPY_SUPPORTED
+            int enable = 1;
+            setsockopt(acceptedSocketId, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable));
+            #endif
+            acceptedState->zerocopyThreshold = state->zerocopyThreshold;
+        }
+        impair_inherit(acceptedState, state);
+        latency_inherit(acceptedState, state);
+        rpc_inherit(acceptedState, state);
+
+        char host[INET6_ADDRSTRLEN];
+        unsigned short port = 0;
+        bool hostCreated = false;
+        if (socket_address_to_host(&address, host, sizeof(host), &port)) {
+            acceptedState->peerHost = address_acquire(host, &hostCreated);
+            acceptedState->peerPort = port;
+        }
+        if (hostCreated) {
+            createdHosts[created++] = acceptedState->peerHost;
+        }
+
+        if (state != NULL && state->plugin != NULL) {
+            acceptedState->plugin = state->plugin;
+
+            int verdict = plugin_accept(state->plugin, acceptedSocketId, socketId);
+            if (verdict == PLUGIN_CLOSE) {
+                socket_list_drop(socketList, socket_list_find(socketList, acceptedSocketId));
+                CLOSESOCKET(acceptedSocketId);
+                *needPrune = True;
+            }
+            if (verdict != PLUGIN_FORWARD) {
+                continue;
+            }
+        }
+
+        if (loop_queue(libData, taskId, socketList, EVENT_ACCEPTED, socketId, TCP_SERVER,
+            (mint)acceptedSocketId, acceptedState->peerHost, acceptedState->peerPort, NULL, 0)) {
+            continue;
+        }
+
+        accepted[forwarded * 3] = (mint)acceptedSocketId;
+        accepted[forwarded * 3 + 1] = acceptedState->peerHost;
+        accepted[forwarded * 3 + 2] = acceptedState->peerPort;
+        forwarded++;
+    }
+
+    if (count == 0 && !is_wouldblock_err(err) &&
+        !loop_queue(libData, taskId, socketList, EVENT_ERROR, socketId, TCP_SERVER, err, 0, 0, NULL, 0)) {
+        DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_SERVER);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, err);
+        async_raise(libData, taskId, "Error", dataStore);
+    }
+
+    if (forwarded > 0) {
+        MTensor acceptedTensor;
+        mint dims[2] = {forwarded, 3};
+        libData->MTensor_new(MType_Integer, 2, dims, &acceptedTensor);
+        memcpy(libData->MTensor_getIntegerData(acceptedTensor), accepted, sizeof(mint) * 3 * forwarded);
+
+        DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_SERVER);
+        libData->ioLibraryFunctions->DataStore_addMTensor(dataStore, acceptedTensor);
+        for (mint i = 0; i < created; i++) {
+            char createdHost[INET6_ADDRSTRLEN] = "";
+            address_host(createdHosts[i], createdHost, sizeof(createdHost));
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, createdHosts[i]);
+            libData->ioLibraryFunctions->DataStore_addString(dataStore, createdHost);
+        }
+        async_raise(libData, taskId, "AcceptedBatch", dataStore);
+        libData->MTensor_free(acceptedTensor);
+    }
+
+    pool_free(accepted);
+    pool_free(createdHosts);
+    return count;
+}
+
+
+// Stops reading a connection while it or the library is over its memory
+// limit, or closes it when shedding is on, and raises MemoryLimit
+// {socketId, socketType, status, connectionBytes, shed} once per episode,
+// returns false when the connection must not be read
+static bool memory_enforce(WolframLibraryData libData, mint taskId, SocketList socketList, SocketState state, mint index)
+{
+    MEMORY_STATUS status = memory_check(state);
+    bool limited = status != MEMORY_OK;
+    bool shed = status == MEMORY_CONNECTION_LIMIT && memory_shed();
+
+    if (limited && !state->memoryLimited) {
+        SOCKET socketId = state->socketId;
+        SOCKET_TYPE socketType = socketList->sockettypes[index];
+
+        if (!loop_queue(libData, taskId, socketList, EVENT_MEMORY_LIMIT, socketId, socketType, (mint)status, state->memory, shed, NULL, 0)) {
+            DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketType);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)status);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, state->memory);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, shed);
+            async_raise(libData, taskId, "MemoryLimit", dataStore);
+        }
+
+        if (shed) {
+            socket_list_drop(socketList, index);
+            CLOSESOCKET(socketId);
+
+            if (!loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, socketType, WL_POLLHUP, 0, 0, NULL, 0)) {
+                DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketType);
+                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, WL_POLLHUP);
+                async_raise(libData, taskId, "Closed", dataStore);
+            }
+            return false;
+        }
+    }
+
+    state->memoryLimited = limited;
+    return !limited;
+}
+
+
+// Queues a received frame with its type and header length as values and
+// the frame as it came in, with the elements in host order, as payload
+static bool loop_queue_frame(WolframLibraryData libData, mint taskId, SocketList socketList, SOCKET socketId,
+    MNumericArray array, mint bytes)
+{
+    if (!event_queue_active(socketList->eventQueue)) {
+        return false;
+    }
+
+    BYTE *payload = pool_alloc(FRAME_HEADER_MAX + (size_t)bytes);
+    if (payload == NULL) {
+        return false;
+    }
+
+    size_t headerLength = frame_header(libData, array, payload);
+    memcpy(payload + headerLength, libData->numericarrayLibraryFunctions->MNumericArray_getData(array), (size_t)bytes);
+
+    bool queued = loop_queue(libData, taskId, socketList, EVENT_RECEIVED_FRAME, socketId, TCP_CLIENT,
+        (mint)libData->numericarrayLibraryFunctions->MNumericArray_getType(array), (mint)headerLength, 0,
+        payload, headerLength + (size_t)bytes);
+    pool_free(payload);
+    return queued;
+}
+
+
+// Reads the frames a connection has ready, up to the loop's drain budget,
+// and raises ReceivedFrame {socketId, socketType, array} for each one,
+// returns how the last read ended
+static FRAME_RESULT frame_drain(WolframLibraryData libData, mint taskId, SocketList socketList, SocketState state, SOCKET socketId)
+{
+    mint drained = 0;
+    FRAME_RESULT result;
+    MNumericArray array;
+    mint bytes;
+
+    while ((result = frame_recv(libData, state, socketId, &array, &bytes)) == FRAME_COMPLETE) {
+        TRACE_RECV(socketId, bytes);
+        latency_request(state);
+
+        if (loop_queue_frame(libData, taskId, socketList, socketId, array, bytes)) {
+            libData->numericarrayLibraryFunctions->MNumericArray_free(array);
+        } else {
+            DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+            libData->ioLibraryFunctions->DataStore_addMNumericArray(dataStore, array);
+            flow_account(socketList, state, 1, bytes);
+            async_raise(libData, taskId, "ReceivedFrame", dataStore);
+        }
+
+        drained += bytes;
+        if (drained >= socketList->drainBudget) {
+            break;
+        }
+    }
+
+    return result;
+}
+
+
+// Reads the RPC messages a connection has ready, up to the loop's drain
+// budget. Server connections raise Request {socketId, socketType, id, array},
+// client connections hand replies to their calls and raise Reply with the
+// same fields for calls nobody waits on.
+static FRAME_RESULT rpc_drain(WolframLibraryData libData, mint taskId, SocketList socketList, SocketState state, SOCKET socketId)
+{
+    mint drained = 0;
+    FRAME_RESULT result;
+    MNumericArray array;
+    mint bytes;
+    mint id;
+
+    while ((result = rpc_recv(libData, state, socketId, &id, &array, &bytes)) == FRAME_COMPLETE) {
+        TRACE_RECV(socketId, bytes);
+        drained += bytes;
+
+        bool server = state->rpc->server;
+        if (server) {
+            latency_request(state);
+        }
+        if (!server && !rpc_deliver(state, id, array, false)) {
+            flow_account(socketList, state, 1, bytes);
+        } else if (loop_queue(libData, taskId, socketList, server ? EVENT_REQUEST : EVENT_REPLY, socketId, TCP_CLIENT, id, 0, 0,
+            libData->numericarrayLibraryFunctions->MNumericArray_getData(array), (size_t)bytes)) {
+            libData->numericarrayLibraryFunctions->MNumericArray_free(array);
+        } else {
+            flow_account(socketList, state, 1, bytes);
+            DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, id);
+            libData->ioLibraryFunctions->DataStore_addMNumericArray(dataStore, array);
+            async_raise(libData, taskId, server ? "Request" : "Reply", dataStore);
+        }
+
+        if (drained >= socketList->drainBudget) {
+            break;
+        }
+    }
+
+    return result;
+}
+
+
+// Reads what the connection has ready, up to the loop's drain budget, into
+// one growing buffer. The per-connection read size doubles while the peer
+// fills it and halves back toward minSize when the peer sends little.
+static int socket_drain(SocketList socketList, SocketState state, SOCKET socketId,
+    BYTE **buffer, size_t *bufferCapacity, size_t minSize, mint *arrival)
+{
+    size_t recvSize = state != NULL && state->recvSize >= minSize ? state->recvSize : minSize;
+    size_t recvLimit = (size_t)socketList->recvLimit > minSize ? (size_t)socketList->recvLimit : minSize;
+    size_t segment = impair_segment(state);
+    size_t received = 0;
+
+    // an impaired connection reads one short segment per wakeup
+    if (segment > 0 && segment < recvSize) {
+        recvSize = segment;
+        recvLimit = segment;
+    }
+    int result = 0;
+
+    do {
+        if (*bufferCapacity < received + recvSize) {
+            size_t capacity = received + recvSize;
+            BYTE *grown = memory_allowed(NULL, (mint)(capacity - *bufferCapacity)) ? realloc(*buffer, capacity) : NULL;
+            if (grown != NULL) {
+                memory_charge(NULL, (mint)(capacity - *bufferCapacity));
+                *buffer = grown;
+                *bufferCapacity = capacity;
+            } else if (*bufferCapacity > received) {
+                recvSize = *bufferCapacity - received;
+            } else {
+                break;
+            }
+        }
+
+        result = received > 0 ?
+            recv_nonblocking(socketId, *buffer + received, recvSize) :
+            arrival != NULL ?
+            timestamp_recv(socketId, *buffer, recvSize, arrival) :
+            recv(socketId, (char *)*buffer, (int)recvSize, 0);
+
+        if (result <= 0) {
+            break;
+        }
+        TRACE_RECV(socketId, result);
+
+        received += (size_t)result;
+
+        if ((size_t)result == recvSize && recvSize < recvLimit) {
+            recvSize = recvSize * 2 < recvLimit ? recvSize * 2 : recvLimit;
+        } else if ((size_t)result < recvSize / 4 && recvSize > minSize) {
+            recvSize /= 2;
+        }
+    } while (segment == 0 && received < (size_t)socketList->drainBudget && (size_t)result * 4 >= recvSize);
+
+    if (state != NULL) {
+        state->recvSize = recvSize;
+    }
+
+    return received > 0 ? (int)received : result;
+}
+
+
 void socketsPollLoop(mint taskId, void *taskArgs)
 {
     ServerLoopArgs args = (ServerLoopArgs)taskArgs;
@@ -68,15 +513,15 @@ void socketsPollLoop(mint taskId, void *taskArgs)
 
     WolframLibraryData libData = args->libData;
     mint bufferSize = args->bufferSize;
-    BYTE *buffer = malloc(bufferSize);
+    size_t bufferCapacity = (size_t)bufferSize;
+    BYTE *buffer = malloc(bufferCapacity);
+    memory_charge(NULL, (mint)bufferCapacity);
     mint timeout = args->timeout;
     mint eventsMask = args->eventsMask;
     int nativeEvents = convert_wl_to_native_events(eventsMask);
 
     int result;
     mint dims;
-    int recvResult;
-    SOCKET acceptedSocketId;
     MNumericArray byteArray;
     DataStore dataStore;
     bool needPrune = False;
@@ -84,64 +529,305 @@ void socketsPollLoop(mint taskId, void *taskArgs)
     while (libData->ioLibraryFunctions->asynchronousTaskAliveQ(taskId))
     {
         if (needPrune) {
+            mint before = socketList->length;
             socket_list_prune(socketList);
+            TRACE_PRUNE(before, socketList->length);
             needPrune = False;
         }
 
-        size_t length = socketList->length;
+        // queued writes held back by an impairment shorten the wait
+        mint wait = timeout;
+
+        for (mint i = 0; i < socketList->length; i++) {
+            SOCKET socketId = socketList->pollfds[i].fd;
+            int events = socketList->sockettypes[i] == INTERUPTER ? POLLIN_FLAG : nativeEvents;
+
+            SocketState state = socketId != INVALID_SOCKET ? socketList->states[i] : NULL;
+            if (state != NULL && state->relay != NULL) {
+                Relay relay = state->relay;
+                if (relay_attach(socketList, relay) &&
+                    !loop_queue(libData, taskId, socketList, EVENT_RELAY_OPENED, relay->forward.source, TCP_CLIENT,
+                        (mint)relay->forward.target, 0, 0, NULL, 0)) {
+                    dataStore = libData->ioLibraryFunctions->createDataStore();
+                    libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)relay->forward.source);
+                    libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+                    libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)relay->forward.target);
+                    async_raise(libData, taskId, "RelayOpened", dataStore);
+                }
+                events = relay_poll_events(relay, socketId);
+            }
+
+            // the peer finished sending, Closed waits until the queue is out
+            if (state != NULL && state->eof) {
+                events &= ~POLLIN_FLAG;
+
+                if (!peer_linger(state, socketId)) {
+                    socket_list_drop(socketList, i);
+                    socketList->pollfds[i].events = 0;
+                    socketList->pollfds[i].revents = 0;
+                    needPrune = True;
+
+                    if (!loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, TCP_CLIENT, WL_POLLHUP, 0, 0, NULL, 0)) {
+                        dataStore = libData->ioLibraryFunctions->createDataStore();
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, WL_POLLHUP);
+                        async_raise(libData, taskId, "Closed", dataStore);
+                    }
+                    continue;
+                }
+            }
+
+            bool readable = socketList->sockettypes[i] == TCP_CLIENT || socketList->sockettypes[i] == UDP_CLIENT ||
+                socketList->sockettypes[i] == UDP_SERVER;
+
+            if (readable && flow_paused(socketList, state)) {
+                events &= ~POLLIN_FLAG;
+            }
+
+            if (readable && state != NULL && state->relay == NULL && !memory_enforce(libData, taskId, socketList, state, i)) {
+                events &= ~POLLIN_FLAG;
+
+                if (socketList->pollfds[i].fd == INVALID_SOCKET) {
+                    socketList->pollfds[i].events = 0;
+                    socketList->pollfds[i].revents = 0;
+                    needPrune = True;
+                    continue;
+                }
+            }
+
+            if (state != NULL && coalesce_pending(state->coalesce) && coalesce_flush(socketId, state->coalesce) == 0) {
+                events |= POLLOUT_FLAG;
+            }
+
+            mint due = state != NULL ? coalesce_due(state->coalesce) : 0;
+            if (due > 0) {
+                mint remaining = (due - get_monotonic_time()) / 1000;
+                remaining = remaining > 0 ? remaining : 0;
+                wait = wait < 0 || remaining < wait ? remaining : wait;
+            }
 
-        for (size_t i = 0; i < length; i++) {
-            POLL_FD *pollfd = &socketList->pollfds[i];
-            pollfd->events = nativeEvents;
-            pollfd->revents = 0;
+            if (state != NULL && state->dispatcher != NULL && socketList->sockettypes[i] == TCP_SERVER) {
+                dispatcher_attach(socketList, state->dispatcher);
+            }
+
+            socketList->pollfds[i].events = events;
+            socketList->pollfds[i].revents = 0;
         }
 
+        size_t length = socketList->length;
         POLL_FD *pollfds = socketList->pollfds;
 
-        result = sockets_poll(pollfds, length, timeout);
+        TRACE_POLL_BEGIN(length, wait);
+        result = sockets_poll(pollfds, length, wait);
+        TRACE_POLL_END(result);
         if (result > 0) {
-            for (size_t i = 0; i < length; i++) {
-                mint wl_revents = convert_native_to_wl_events(pollfds[i].revents);
-                SOCKET socketId = pollfds[i].fd;
+            // Round robin start with separate budgets for accepts and for
+            // client reads, sockets skipped over budget go first next time
+            size_t start = (size_t)socketList->cursor % length;
+            mint deferred = -1;
+            mint accepts = 0;
+            mint reads = 0;
+
+            for (size_t k = 0; k < length; k++) {
+                size_t i = (start + k) % length;
+                mint wl_revents = convert_native_to_wl_events(socketList->pollfds[i].revents);
+                SOCKET socketId = socketList->pollfds[i].fd;
                 SOCKET_TYPE socketType = socketList->sockettypes[i];
 
+                if (wl_revents == 0 || socketId == INVALID_SOCKET) {
+                    continue;
+                }
+
+                if (socketType == INTERUPTER) {
+                    socket_list_interrupter_drain(socketList);
+                    continue;
+                }
+
+                SocketState state = socketList->states[i];
+                if (state != NULL && state->relay != NULL) {
+                    Relay relay = state->relay;
+                    if (!relay_handle(relay, socketId, wl_revents)) {
+                        relay_close(libData, taskId, socketList, relay);
+                        needPrune = True;
+                    }
+                    continue;
+                }
+
+                if (socketType == HANDOFF_CHANNEL) {
+                    if (!handoff_channel_read(libData, taskId, socketList, state, socketId)) {
+                        CLOSESOCKET(socketId);
+                        socket_list_drop(socketList, i);
+                        needPrune = True;
+
+                        if (loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, socketType, wl_revents, 0, 0, NULL, 0)) {
+                            continue;
+                        }
+
+                        dataStore = libData->ioLibraryFunctions->createDataStore();
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketType);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)wl_revents);
+                        async_raise(libData, taskId, "Closed", dataStore);
+                    }
+                    continue;
+                }
+
+                // zero-copy completions arrive on the error queue and wake
+                // poll with POLLERR while the connection is fine
+                if ((wl_revents & WL_POLLERR) && state != NULL && state->zerocopy != NULL) {
+                    mint bytes;
+                    bool copied;
+                    mint completed = zerocopy_reap(state, socketId, &bytes, &copied);
+                    if (completed > 0 &&
+                        !loop_queue(libData, taskId, socketList, EVENT_SEND_COMPLETE, socketId, socketType, completed, bytes, copied, NULL, 0)) {
+                        dataStore = libData->ioLibraryFunctions->createDataStore();
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketType);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, completed);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, bytes);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, copied);
+                        async_raise(libData, taskId, "SendComplete", dataStore);
+                    }
+
+                    int socketError = 0;
+                    socklen_t socketErrorLength = sizeof(socketError);
+                    if (!(wl_revents & (WL_POLLHUP | WL_POLLNVAL)) &&
+                        getsockopt(socketId, SOL_SOCKET, SO_ERROR, (char *)&socketError, &socketErrorLength) == 0 && socketError == 0) {
+                        wl_revents &= ~WL_POLLERR;
+                    }
+                    if (wl_revents == 0) {
+                        continue;
+                    }
+                }
+
                 if (wl_revents & (WL_POLLERR | WL_POLLHUP | WL_POLLNVAL)) {
+                    zerocopy_close(state, socketId, 0);
+                    socket_list_drop(socketList, i);
                     CLOSESOCKET(socketId);
-                    pollfds[i].fd = INVALID_SOCKET;
                     needPrune = True;
 
+                    if (loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, socketType, wl_revents, 0, 0, NULL, 0)) {
+                        continue;
+                    }
+
                     dataStore = libData->ioLibraryFunctions->createDataStore();
                     libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
                     libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketType);
                     libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)wl_revents);
-                    libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Closed", dataStore);
+                    async_raise(libData, taskId, "Closed", dataStore);
 
                     continue;
                 }
 
                 if (wl_revents & WL_POLLIN) {
+                    bool overBudget = socketType == TCP_SERVER ?
+                        accepts >= socketList->listenerBudget :
+                        reads >= socketList->clientBudget;
+
+                    if (overBudget) {
+                        if (deferred < 0) {
+                            deferred = (mint)i;
+                        }
+                        continue;
+                    }
+
+                    if (socketType != TCP_SERVER) {
+                        reads++;
+                    }
+
                     dataStore = libData->ioLibraryFunctions->createDataStore();
                     libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
                     libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketType);
 
                     if (socketType == TCP_SERVER) {
-                        acceptedSocketId = accept(socketId, NULL, NULL);
-                        if (ISVALIDSOCKET(acceptedSocketId)) {
-                            socket_list_add(socketList, acceptedSocketId, TCP_CLIENT);
+                        libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                        accepts += accept_batch(libData, taskId, socketList, state, socketId, socketList->listenerBudget - accepts, &needPrune);
+                    }
 
-                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)acceptedSocketId);
-                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Accepted", dataStore);
-                        } else {
-                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, GETSOCKETERRNO());
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Error", dataStore);
+                    else if (socketType == TCP_CLIENT && state != NULL && (state->framed || state->rpc != NULL)) {
+                        libData->ioLibraryFunctions->deleteDataStore(dataStore);
+
+                        FRAME_RESULT frameResult = state->rpc != NULL ?
+                            rpc_drain(libData, taskId, socketList, state, socketId) :
+                            frame_drain(libData, taskId, socketList, state, socketId);
+                        if (frameResult == FRAME_COMPLETE || frameResult == FRAME_PARTIAL) {
                             continue;
                         }
+
+                        int err = GETSOCKETERRNO();
+                        socket_list_drop(socketList, i);
+                        needPrune = True;
+
+                        // a malformed or oversized frame ends the connection
+                        if (frameResult == FRAME_INVALID) {
+                            CLOSESOCKET(socketId);
+                        }
+
+                        mint closedEvents = frameResult == FRAME_INVALID ? WL_POLLERR : WL_POLLHUP;
+                        if (frameResult == FRAME_ERROR ?
+                            loop_queue(libData, taskId, socketList, EVENT_ERROR, socketId, TCP_CLIENT, err, 0, 0, NULL, 0) :
+                            loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, TCP_CLIENT, closedEvents, 0, 0, NULL, 0)) {
+                            continue;
+                        }
+
+                        dataStore = libData->ioLibraryFunctions->createDataStore();
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
+                        libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
+                        if (frameResult == FRAME_ERROR) {
+                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, err);
+                            async_raise(libData, taskId, "Error", dataStore);
+                        } else {
+                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, closedEvents);
+                            async_raise(libData, taskId, "Closed", dataStore);
+                        }
                     }
 
                     else if (socketType == TCP_CLIENT) {
-                        int recvResult = recv(socketId, buffer, bufferSize, 0);
+                        mint arrival = 0;
+                        int recvResult = socket_drain(socketList, state, socketId, &buffer, &bufferCapacity, (size_t)bufferSize,
+                            socketList->timestamps ? &arrival : NULL);
                         if (recvResult > 0) {
+                            recorder_write(socketList->recorder, RECORD_RECEIVE, socketId, TCP_CLIENT,
+                                state != NULL ? state->listener : INVALID_SOCKET, buffer, (size_t)recvResult);
+                        }
+                        if (recvResult > 0 && state != NULL && state->cached) {
+                            // queued like any other write, POLLOUT finishes what the
+                            // socket does not take now
+                            SOCKET scope = ISVALIDSOCKET(state->listener) ? state->listener : socketId;
+                            SharedBuffer response = cache_lookup(scope, buffer, (size_t)recvResult);
+                            int queued = response != NULL ? coalesce_append_shared(state, response) : -1;
+                            if (response != NULL) {
+                                shared_buffer_release(response);
+                            }
+                            if (queued >= 0) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                continue;
+                            }
+                        }
+
+                        if (recvResult > 0 && state != NULL && state->plugin != NULL) {
+                            int verdict = plugin_message(state->plugin, socketId, state->listener, buffer, (size_t)recvResult);
+                            if (verdict != PLUGIN_FORWARD) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                if (verdict == PLUGIN_CLOSE) {
+                                    socket_list_drop(socketList, i);
+                                    CLOSESOCKET(socketId);
+                                    needPrune = True;
+                                }
+                                continue;
+                            }
+                        }
+
+                        if (recvResult > 0) {
+                            latency_request(state);
+                        }
+
+                        if (recvResult > 0 &&
+                            loop_queue(libData, taskId, socketList, EVENT_RECEIVED, socketId, socketType,
+                                arrival, arrival > 0 ? timestamp_now() : 0, 0, buffer, (size_t)recvResult)) {
+                            libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                        } else if (recvResult > 0) {
                             dims = (mint)recvResult;
                             libData->numericarrayLibraryFunctions->MNumericArray_new(MNumericArray_Type_UBit8, 1, &dims, &byteArray);
 
@@ -149,14 +835,27 @@ void socketsPollLoop(mint taskId, void *taskArgs)
                             memcpy(array, buffer, recvResult);
 
                             libData->ioLibraryFunctions->DataStore_addMNumericArray(dataStore, byteArray);
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Received", dataStore);
+                            if (arrival > 0) {
+                                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, arrival);
+                                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, timestamp_now());
+                            }
+                            flow_account(socketList, state, 1, (mint)recvResult);
+                            async_raise(libData, taskId, "Received", dataStore);
+                        } else if (recvResult == 0 && peer_linger(state, socketId)) {
+                            state->eof = true;
+                            libData->ioLibraryFunctions->deleteDataStore(dataStore);
                         } else if (recvResult == 0) {
-                            pollfds[i].fd = INVALID_SOCKET;
+                            socket_list_drop(socketList, i);
                             needPrune = True;
 
+                            if (loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, TCP_CLIENT, WL_POLLHUP, 0, 0, NULL, 0)) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                continue;
+                            }
+
                             libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
                             libData->ioLibraryFunctions->DataStore_addInteger(dataStore, TCP_CLIENT);
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Closed", dataStore);
+                            async_raise(libData, taskId, "Closed", dataStore);
                         } else {
                             int err = GETSOCKETERRNO();
 
@@ -164,11 +863,16 @@ void socketsPollLoop(mint taskId, void *taskArgs)
                                 continue;
                             }
 
-                            pollfds[i].fd = INVALID_SOCKET;
+                            socket_list_drop(socketList, i);
                             needPrune = True;
 
+                            if (loop_queue(libData, taskId, socketList, EVENT_ERROR, socketId, socketType, err, 0, 0, NULL, 0)) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                continue;
+                            }
+
                             libData->ioLibraryFunctions->DataStore_addInteger(dataStore, err);
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Error", dataStore);
+                            async_raise(libData, taskId, "Error", dataStore);
                         }
                     }
 
@@ -176,8 +880,30 @@ void socketsPollLoop(mint taskId, void *taskArgs)
                         struct sockaddr_storage remoteAddr;
                         socklen_t remoteAddrLen = sizeof(remoteAddr);
 
-                        int recvFromResult = recvfrom(socketId, buffer, bufferSize, 0, (struct sockaddr*)&remoteAddr, &remoteAddrLen);
+                        mint segmentSize = 0;
+                        mint arrival = 0;
+                        int recvFromResult;
+
+                        if (state != NULL && state->gro) {
+                            // a coalesced read can be as large as one UDP payload
+                            if (bufferCapacity < DATAGRAM_GRO_BUFFER && memory_allowed(NULL, DATAGRAM_GRO_BUFFER - (mint)bufferCapacity)) {
+                                BYTE *grown = realloc(buffer, DATAGRAM_GRO_BUFFER);
+                                if (grown != NULL) {
+                                    memory_charge(NULL, DATAGRAM_GRO_BUFFER - (mint)bufferCapacity);
+                                    buffer = grown;
+                                    bufferCapacity = DATAGRAM_GRO_BUFFER;
+                                }
+                            }
+                            recvFromResult = datagram_recv(socketId, buffer, bufferCapacity, &remoteAddr, &remoteAddrLen, &segmentSize,
+                                socketList->timestamps ? &arrival : NULL);
+                        } else if (socketList->timestamps) {
+                            recvFromResult = datagram_recv(socketId, buffer, bufferSize, &remoteAddr, &remoteAddrLen, &segmentSize, &arrival);
+                        } else {
+                            recvFromResult = recvfrom(socketId, buffer, bufferSize, 0, (struct sockaddr*)&remoteAddr, &remoteAddrLen);
+                        }
                         if (recvFromResult > 0) {
+                            TRACE_RECV(socketId, recvFromResult);
+                            recorder_write(socketList->recorder, RECORD_RECEIVE, socketId, socketType, INVALID_SOCKET, buffer, (size_t)recvFromResult);
                             char host[INET6_ADDRSTRLEN];
                             unsigned short port;
 
@@ -185,35 +911,81 @@ void socketsPollLoop(mint taskId, void *taskArgs)
                                 continue;
                             }
 
-                            dims = (mint)recvResult;
+                            bool hostCreated = false;
+                            if (event_queue_active(socketList->eventQueue) &&
+                                loop_queue(libData, taskId, socketList, EVENT_RECEIVED_FROM, socketId, socketType,
+                                    address_intern(host, &hostCreated), (mint)port, segmentSize, buffer, (size_t)recvFromResult)) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                continue;
+                            }
+
+                            dims = (mint)recvFromResult;
                             libData->numericarrayLibraryFunctions->MNumericArray_new(MNumericArray_Type_UBit8, 1, &dims, &byteArray);
 
                             BYTE *array = libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
-                            memcpy(array, buffer, recvResult);
+                            memcpy(array, buffer, recvFromResult);
 
                             libData->ioLibraryFunctions->DataStore_addMNumericArray(dataStore, byteArray);
                             libData->ioLibraryFunctions->DataStore_addString(dataStore, host);
                             libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)port);
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "ReceivedFrom", dataStore);
+
+                            // 0-based start of every datagram in a GRO read, always
+                            // present when the arrival time follows
+                            if (segmentSize > 0 || arrival > 0) {
+                                MTensor offsets;
+                                mint segments = segmentSize > 0 ? (recvFromResult + segmentSize - 1) / segmentSize : 1;
+                                libData->MTensor_new(MType_Integer, 1, &segments, &offsets);
+                                mint *offsetsData = libData->MTensor_getIntegerData(offsets);
+                                for (mint k = 0; k < segments; k++) {
+                                    offsetsData[k] = k * segmentSize;
+                                }
+                                libData->ioLibraryFunctions->DataStore_addMTensor(dataStore, offsets);
+                                libData->MTensor_free(offsets);
+                            }
+
+                            if (arrival > 0) {
+                                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, arrival);
+                                libData->ioLibraryFunctions->DataStore_addInteger(dataStore, timestamp_now());
+                            }
+
+                            flow_account(socketList, state, 1, (mint)recvFromResult);
+                            async_raise(libData, taskId, "ReceivedFrom", dataStore);
                         } else if (recvFromResult == 0) {
-                            pollfds[i].fd = INVALID_SOCKET;
+                            socket_list_drop(socketList, i);
                             needPrune = True;
 
+                            if (loop_queue(libData, taskId, socketList, EVENT_CLOSED, socketId, UDP_CLIENT, WL_POLLHUP, 0, 0, NULL, 0)) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                continue;
+                            }
+
                             libData->ioLibraryFunctions->DataStore_addInteger(dataStore, (mint)socketId);
                             libData->ioLibraryFunctions->DataStore_addInteger(dataStore, UDP_CLIENT);
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Closed", dataStore);
+                            async_raise(libData, taskId, "Closed", dataStore);
                         } else {
-                            pollfds[i].fd = INVALID_SOCKET;
+                            int err = GETSOCKETERRNO();
+                            socket_list_drop(socketList, i);
                             needPrune = True;
 
-                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, GETSOCKETERRNO());
-                            libData->ioLibraryFunctions->raiseAsyncEvent(taskId, "Error", dataStore);
+                            if (loop_queue(libData, taskId, socketList, EVENT_ERROR, socketId, socketType, err, 0, 0, NULL, 0)) {
+                                libData->ioLibraryFunctions->deleteDataStore(dataStore);
+                                continue;
+                            }
+
+                            libData->ioLibraryFunctions->DataStore_addInteger(dataStore, err);
+                            async_raise(libData, taskId, "Error", dataStore);
                         }
                     }
                 }
             }
+
+            socketList->cursor = deferred >= 0 ? deferred : (mint)(start + 1);
         }
     }
+
+    memory_charge(NULL, -(mint)bufferCapacity);
+    free(buffer);
+    pool_thread_release();
 }
 
 
@@ -231,6 +1003,8 @@ DLLEXPORT int createSocketsPollLoop(WolframLibraryData libData, mint Argc, MArgu
     serverLoopArgs->timeout = timeout;
     serverLoopArgs->eventsMask = eventsMask;
 
+    socket_list_interrupter_create(socketList);
+
     mint taskId = libData->ioLibraryFunctions->createAsynchronousTaskWithThread(socketsPollLoop, (void *)serverLoopArgs);
 
     MArgument_setInteger(Res, taskId);
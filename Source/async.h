@@ -4,6 +4,26 @@
 
 #include "common.h"
 #include "list.h"
+#include "state.h"
+#include "relay.h"
+#include "handoff.h"
+#include "plugin.h"
+#include "cache.h"
+#include "coalesce.h"
+#include "pool.h"
+#include "queue.h"
+#include "frame.h"
+#include "zerocopy.h"
+#include "datagram.h"
+#include "address.h"
+#include "flow.h"
+#include "memory.h"
+#include "recorder.h"
+#include "impair.h"
+#include "timestamp.h"
+#include "latency.h"
+#include "trace.h"
+#include "rpc.h"
 
 
 typedef struct SocketsSelectArgs_st
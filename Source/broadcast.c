@@ -0,0 +1,193 @@
+#include "broadcast.h"
+
+
+// Queues one reference to the payload per connection and writes what the
+// socket takes without blocking, the owning poll loop sends the rest. A
+// member without a state is already closed and never gets one here, a
+// socket reusing its descriptor must not inherit the payload.
+BROADCAST_STATUS broadcast_send(SOCKET socketId, SharedBuffer sharedBuffer)
+{
+    if (!ISVALIDSOCKET(socketId)) {
+        return BROADCAST_FAILED;
+    }
+
+    SocketState state = socket_state_get(socketId);
+    if (state == NULL) {
+        return BROADCAST_FAILED;
+    }
+
+    if (coalesce_append_shared(state, sharedBuffer) < 0) {
+        // a broken connection keeps nothing queued and leaves the table
+        if (state->coalesce != NULL && coalesce_flush(socketId, state->coalesce) < 0) {
+            coalesce_discard(state->coalesce);
+            socket_state_detach(state);
+        }
+        socket_state_release(state);
+        return BROADCAST_FAILED;
+    }
+    recorder_send(state, sharedBuffer->data, sharedBuffer->length);
+    latency_response(state);
+
+    BROADCAST_STATUS status = coalesce_pending(state->coalesce) ? BROADCAST_QUEUED : BROADCAST_SENT;
+    socket_state_release(state);
+    return status;
+}
+
+
+// Returns the status of every socket: 1 - written, 0 - queued for the poll
+// loop, -1 - failed
+DLLEXPORT int socketBroadcast(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    MTensor socketIds = MArgument_getMTensor(Args[0]);
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[1]);
+
+    mint length = libData->MTensor_getFlattenedLength(socketIds);
+    mint *socketIdsData = libData->MTensor_getIntegerData(socketIds);
+    BYTE *data = libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    mint dataLength = libData->numericarrayLibraryFunctions->MNumericArray_getFlattenedLength(byteArray);
+
+    SharedBuffer sharedBuffer = shared_buffer_create(data, (size_t)dataLength);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+    if (sharedBuffer == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MTensor statuses;
+    libData->MTensor_new(MType_Integer, 1, &length, &statuses);
+    mint *statusesData = libData->MTensor_getIntegerData(statuses);
+
+    for (mint i = 0; i < length; i++) {
+        statusesData[i] = broadcast_send((SOCKET)socketIdsData[i], sharedBuffer);
+    }
+
+    shared_buffer_release(sharedBuffer);
+
+    MArgument_setMTensor(Res, statuses);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketGroupCreate(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    BroadcastGroup group = calloc(1, sizeof(struct BroadcastGroup_st));
+    if (group == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mint groupPtr = (mint)(uintptr_t)group;
+    MArgument_setInteger(Res, groupPtr);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketGroupAdd(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    BroadcastGroup group = (BroadcastGroup)MArgument_getInteger(Args[0]);
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[1]);
+
+    for (mint i = 0; i < group->length; i++) {
+        if (group->sockets[i] == socketId) {
+            return LIBRARY_NO_ERROR;
+        }
+    }
+
+    if (group->length == group->capacity) {
+        mint capacity = group->capacity > 0 ? 2 * group->capacity : 16;
+        SOCKET *sockets = realloc(group->sockets, sizeof(SOCKET) * capacity);
+        if (sockets == NULL) {
+            return LIBRARY_FUNCTION_ERROR;
+        }
+        group->sockets = sockets;
+        group->capacity = capacity;
+    }
+
+    group->sockets[group->length++] = socketId;
+    return LIBRARY_NO_ERROR;
+}
+
+
+static void broadcast_group_remove(BroadcastGroup group, mint index)
+{
+    group->length--;
+    group->sockets[index] = group->sockets[group->length];
+}
+
+
+DLLEXPORT int socketGroupRemove(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    BroadcastGroup group = (BroadcastGroup)MArgument_getInteger(Args[0]);
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[1]);
+
+    for (mint i = 0; i < group->length; i++) {
+        if (group->sockets[i] == socketId) {
+            broadcast_group_remove(group, i);
+            break;
+        }
+    }
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketGroupMembers(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    BroadcastGroup group = (BroadcastGroup)MArgument_getInteger(Args[0]);
+
+    MTensor members;
+    libData->MTensor_new(MType_Integer, 1, &group->length, &members);
+    mint *membersData = libData->MTensor_getIntegerData(members);
+    for (mint i = 0; i < group->length; i++) {
+        membersData[i] = (mint)group->sockets[i];
+    }
+
+    MArgument_setMTensor(Res, members);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Sends the payload to every member and returns {socketId, status} rows,
+// members that failed are dropped from the group
+DLLEXPORT int socketGroupBroadcast(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    BroadcastGroup group = (BroadcastGroup)MArgument_getInteger(Args[0]);
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[1]);
+
+    BYTE *data = libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    mint dataLength = libData->numericarrayLibraryFunctions->MNumericArray_getFlattenedLength(byteArray);
+
+    SharedBuffer sharedBuffer = shared_buffer_create(data, (size_t)dataLength);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+    if (sharedBuffer == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MTensor statuses;
+    mint dims[2] = {group->length, 2};
+    libData->MTensor_new(MType_Integer, 2, dims, &statuses);
+    mint *statusesData = libData->MTensor_getIntegerData(statuses);
+
+    for (mint i = 0; i < dims[0]; i++) {
+        statusesData[2 * i] = (mint)group->sockets[i];
+        statusesData[2 * i + 1] = broadcast_send(group->sockets[i], sharedBuffer);
+    }
+
+    shared_buffer_release(sharedBuffer);
+
+    for (mint i = group->length - 1; i >= 0; i--) {
+        if (statusesData[2 * i + 1] == BROADCAST_FAILED) {
+            broadcast_group_remove(group, i);
+        }
+    }
+
+    MArgument_setMTensor(Res, statuses);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketGroupDelete(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    BroadcastGroup group = (BroadcastGroup)MArgument_getInteger(Args[0]);
+    free(group->sockets);
+    free(group);
+    return LIBRARY_NO_ERROR;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+
+#include "common.h"
+#include "state.h"
+#include "coalesce.h"
+#include "buffer.h"
+#include "recorder.h"
+#include "latency.h"
+
+
+typedef enum {
+    BROADCAST_FAILED = -1,
+    BROADCAST_QUEUED = 0,
+    BROADCAST_SENT = 1
+} BROADCAST_STATUS;
+
+
+// Sockets that receive the same payloads, kept natively so a fan-out is one
+// library call
+typedef struct BroadcastGroup_st
+{
+    SOCKET *sockets;
+    mint length;
+    mint capacity;
+} *BroadcastGroup;
+
+
+BROADCAST_STATUS broadcast_send(SOCKET socketId, SharedBuffer sharedBuffer);
+
+
+#endif
\ No newline at end of file
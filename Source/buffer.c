@@ -9,7 +9,7 @@ DLLEXPORT int socketBufferCreate(WolframLibraryData libData, mint Argc, MArgumen
         return LIBRARY_FUNCTION_ERROR;
     }
 
-    BYTE *buffer = malloc(bufferSize * sizeof(BYTE));
+    BYTE *buffer = pool_alloc(bufferSize * sizeof(BYTE));
     if (!buffer) {
         return LIBRARY_FUNCTION_ERROR;
     }
@@ -22,6 +22,46 @@ DLLEXPORT int socketBufferCreate(WolframLibraryData libData, mint Argc, MArgumen
 DLLEXPORT int socketBufferRemove(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
 {
     BYTE *buffer = (BYTE *)MArgument_getInteger(Args[0]);
-    free(buffer);
+    pool_free(buffer);
     return LIBRARY_NO_ERROR;
+}
+
+
+SharedBuffer shared_buffer_create(const BYTE *data, size_t length)
+{
+    SharedBuffer sharedBuffer = pool_alloc(sizeof(struct SharedBuffer_st) + length);
+    if (!sharedBuffer) {
+        return NULL;
+    }
+
+    sharedBuffer->refs = 1;
+    sharedBuffer->length = length;
+    if (length > 0) {
+        memcpy(sharedBuffer->data, data, length);
+    }
+    return sharedBuffer;
+}
+
+
+SharedBuffer shared_buffer_retain(SharedBuffer sharedBuffer)
+{
+    #ifdef _WIN32
+    InterlockedIncrement64(&sharedBuffer->refs);
+    #else
+    __atomic_add_fetch(&sharedBuffer->refs, 1, __ATOMIC_RELAXED);
+    #endif
+    return sharedBuffer;
+}
+
+
+void shared_buffer_release(SharedBuffer sharedBuffer)
+{
+    #ifdef _WIN32
+    mint refs = InterlockedDecrement64(&sharedBuffer->refs);
+    #else
+    mint refs = __atomic_sub_fetch(&sharedBuffer->refs, 1, __ATOMIC_ACQ_REL);
+    #endif
+    if (refs == 0) {
+        pool_free(sharedBuffer);
+    }
 }
\ No newline at end of file
@@ -3,6 +3,25 @@
 
 
 #include "common.h"
+#include "pool.h"
+
+
+// Immutable reference counted bytes that can be handed to several owners
+typedef struct SharedBuffer_st
+{
+    mint refs;
+    size_t length;
+    BYTE data[];
+} *SharedBuffer;
+
+
+SharedBuffer shared_buffer_create(const BYTE *data, size_t length);
+
+
+SharedBuffer shared_buffer_retain(SharedBuffer sharedBuffer);
+
+
+void shared_buffer_release(SharedBuffer sharedBuffer);
 
 
 #endif
\ No newline at end of file
@@ -0,0 +1,300 @@
+#include "cache.h"
+
+
+// Process wide response cache: a hash table over the entries plus a list
+// ordered by last use for LRU eviction, all guarded by cacheMutex
+static CacheEntry cacheBuckets[CACHE_BUCKETS];
+static CacheEntry cacheNewest = NULL;
+static CacheEntry cacheOldest = NULL;
+static size_t cacheBytes = 0;
+static size_t cacheBudget = CACHE_DEFAULT_BUDGET;
+static mint cacheEntries = 0;
+static mint cacheHits = 0;
+static mint cacheMisses = 0;
+static mint cacheEvictions = 0;
+static Mutex cacheMutex = MUTEX_INITIALIZER;
+
+
+static CacheEntry *cache_find(mint key)
+{
+    CacheEntry *link = &cacheBuckets[(uint64_t)key % CACHE_BUCKETS];
+    while (*link != NULL && (*link)->key != key) {
+        link = &(*link)->chain;
+    }
+    return link;
+}
+
+
+static void cache_unlink(CacheEntry entry)
+{
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        cacheNewest = entry->older;
+    }
+
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        cacheOldest = entry->newer;
+    }
+
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+
+static void cache_push(CacheEntry entry)
+{
+    entry->newer = NULL;
+    entry->older = cacheNewest;
+
+    if (cacheNewest != NULL) {
+        cacheNewest->newer = entry;
+    } else {
+        cacheOldest = entry;
+    }
+
+    cacheNewest = entry;
+}
+
+
+static void cache_remove(CacheEntry *link)
+{
+    CacheEntry entry = *link;
+    *link = entry->chain;
+    cache_unlink(entry);
+
+    cacheBytes -= entry->response->length + entry->requestLength;
+    memory_charge(NULL, -(mint)(entry->response->length + entry->requestLength));
+    cacheEntries--;
+    shared_buffer_release(entry->response);
+    free(entry);
+}
+
+
+static void cache_evict()
+{
+    while (cacheBytes > cacheBudget && cacheOldest != NULL) {
+        cache_remove(cache_find(cacheOldest->key));
+        cacheEvictions++;
+    }
+}
+
+
+static void cache_clear()
+{
+    while (cacheOldest != NULL) {
+        cache_remove(cache_find(cacheOldest->key));
+    }
+}
+
+
+DLLEXPORT int socketCacheEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]); // server or client socket
+    mbool enabled = MArgument_getBoolean(Args[1]);
+
+    SocketState state = socket_state_acquire(socketId);
+    state->cached = enabled;
+    socket_state_release(state);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketCacheKey(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET listener = (SOCKET)MArgument_getInteger(Args[0]);        // server socket, or the client without one
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[1]); // request bytes
+    mint length = MArgument_getInteger(Args[2]);
+
+    BYTE *data = (BYTE *)libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    mint key = cache_key(listener, data, (size_t)length);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+
+    MArgument_setInteger(Res, key);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Caches the response a listener gives to the request and returns the key
+// it is kept under, a request hashing to the same key replaces the entry.
+// Listeners have their own responses, each answers only its own requests.
+DLLEXPORT int socketCachePut(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET listener = (SOCKET)MArgument_getInteger(Args[0]);          // server socket, or the client without one
+    MNumericArray requestArray = MArgument_getMNumericArray(Args[1]); // request bytes
+    mint requestLength = MArgument_getInteger(Args[2]);
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[3]);    // response bytes
+    mint length = MArgument_getInteger(Args[4]);
+    mint ttl = MArgument_getInteger(Args[5]);                         // time to live in microseconds, 0 - forever
+
+    BYTE *request = (BYTE *)libData->numericarrayLibraryFunctions->MNumericArray_getData(requestArray);
+    mint key = cache_key(listener, request, (size_t)requestLength);
+
+    if ((size_t)(length + requestLength) > cacheBudget) {
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(requestArray);
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+        MArgument_setInteger(Res, key);
+        return LIBRARY_NO_ERROR; // would evict everything else, not worth caching
+    }
+
+    BYTE *data = (BYTE *)libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    SharedBuffer response = shared_buffer_create(data, (size_t)length);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+
+    CacheEntry entry = response != NULL ? malloc(sizeof(struct CacheEntry_st) + (size_t)requestLength) : NULL;
+    if (entry == NULL) {
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(requestArray);
+        if (response != NULL) {
+            shared_buffer_release(response);
+        }
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    entry->key = key;
+    entry->listener = listener;
+    entry->response = response;
+    entry->expires = ttl > 0 ? get_monotonic_time() + ttl * 1000 : 0;
+    entry->chain = NULL;
+    entry->requestLength = (size_t)requestLength;
+    memcpy(entry->request, request, (size_t)requestLength);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(requestArray);
+
+    mutex_lock(&cacheMutex);
+
+    CacheEntry *link = cache_find(key);
+    if (*link != NULL) {
+        cache_remove(link);
+        link = cache_find(key);
+    }
+
+    *link = entry;
+    cache_push(entry);
+
+    cacheBytes += response->length + entry->requestLength;
+    memory_charge(NULL, (mint)(response->length + entry->requestLength));
+    cacheEntries++;
+    cache_evict();
+
+    mutex_unlock(&cacheMutex);
+
+    MArgument_setInteger(Res, key);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketCacheInvalidate(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint key = MArgument_getInteger(Args[0]);
+
+    mutex_lock(&cacheMutex);
+    CacheEntry *link = cache_find(key);
+    if (*link != NULL) {
+        cache_remove(link);
+    }
+    mutex_unlock(&cacheMutex);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketCacheClear(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mutex_lock(&cacheMutex);
+    cache_clear();
+    mutex_unlock(&cacheMutex);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketCacheSetBudget(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint budget = MArgument_getInteger(Args[0]); // total response bytes kept in the cache
+
+    if (budget < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mutex_lock(&cacheMutex);
+    cacheBudget = (size_t)budget;
+    cache_evict();
+    mutex_unlock(&cacheMutex);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketCacheStats(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint dims = 6;
+    MTensor stats;
+    libData->MTensor_new(MType_Integer, 1, &dims, &stats);
+    mint *statsData = libData->MTensor_getIntegerData(stats);
+
+    mutex_lock(&cacheMutex);
+    statsData[0] = cacheEntries;
+    statsData[1] = (mint)cacheBytes;
+    statsData[2] = (mint)cacheBudget;
+    statsData[3] = cacheHits;
+    statsData[4] = cacheMisses;
+    statsData[5] = cacheEvictions;
+    mutex_unlock(&cacheMutex);
+
+    MArgument_setMTensor(Res, stats);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// FNV-1a over the listener and the request bytes
+mint cache_key(SOCKET listener, const BYTE *data, size_t length)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    uint64_t scope = (uint64_t)listener;
+    for (int i = 0; i < 8; i++) {
+        hash ^= (BYTE)(scope >> (8 * i));
+        hash *= 1099511628211ULL;
+    }
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return (mint)hash;
+}
+
+
+// Returns a retained response or NULL, expired entries are dropped here and
+// a different listener or request with the same hash is a miss
+SharedBuffer cache_lookup(SOCKET listener, const BYTE *request, size_t length)
+{
+    SharedBuffer response = NULL;
+    mint key = cache_key(listener, request, length);
+
+    mutex_lock(&cacheMutex);
+
+    CacheEntry *link = cache_find(key);
+    CacheEntry entry = *link;
+
+    if (entry != NULL && entry->expires != 0 && entry->expires < get_monotonic_time()) {
+        cache_remove(link);
+        entry = NULL;
+    }
+
+    if (entry != NULL && (entry->listener != listener || entry->requestLength != length ||
+        memcmp(entry->request, request, length) != 0)) {
+        entry = NULL;
+    }
+
+    if (entry != NULL) {
+        cache_unlink(entry);
+        cache_push(entry);
+        response = shared_buffer_retain(entry->response);
+        cacheHits++;
+    } else {
+        cacheMisses++;
+    }
+
+    mutex_unlock(&cacheMutex);
+    return response;
+}
\ No newline at end of file
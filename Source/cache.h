@@ -0,0 +1,39 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+
+#include "common.h"
+#include "buffer.h"
+#include "state.h"
+#include "memory.h"
+
+
+#define CACHE_BUCKETS 4096
+#define CACHE_DEFAULT_BUDGET (64 * 1024 * 1024)
+
+
+// A cached response with the listener and request it answers, the key is
+// only a hash so a hit also compares both
+typedef struct CacheEntry_st
+{
+    mint key;
+    SOCKET listener;
+    SharedBuffer response;
+    mint expires;
+
+    struct CacheEntry_st *newer;
+    struct CacheEntry_st *older;
+    struct CacheEntry_st *chain;
+
+    size_t requestLength;
+    BYTE request[];
+} *CacheEntry;
+
+
+mint cache_key(SOCKET listener, const BYTE *data, size_t length);
+
+
+SharedBuffer cache_lookup(SOCKET listener, const BYTE *request, size_t length);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,343 @@
+#include "coalesce.h"
+
+
+DLLEXPORT int socketCoalesceEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint threshold = MArgument_getInteger(Args[1]); // 0 - disable
+
+    if (!ISVALIDSOCKET(socketId) || threshold < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    state->coalesceThreshold = threshold;
+    socket_state_release(state);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketCoalesceFlush(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+
+    SocketState state = socket_state_get(socketId);
+    int result = state != NULL && state->coalesce != NULL ? coalesce_flush(socketId, state->coalesce) : 0;
+    socket_state_release(state);
+
+    return result < 0 ? LIBRARY_FUNCTION_ERROR : LIBRARY_NO_ERROR;
+}
+
+
+// Queued data keeps going through the queue after disabling so the order holds
+bool coalesce_enabled(SocketState state)
+{
+    return state != NULL && (state->coalesceThreshold > 0 || coalesce_pending(state->coalesce) || impair_shaped(state));
+}
+
+
+static Coalesce coalesce_create(SocketState state)
+{
+    Coalesce coalesce = calloc(1, sizeof(struct Coalesce_st));
+    if (coalesce != NULL) {
+        mutex_init(&coalesce->mutex);
+        coalesce->state = state;
+    }
+    return coalesce;
+}
+
+
+static Coalesce coalesce_acquire(SocketState state)
+{
+    if (state->coalesce == NULL) {
+        mutex_lock(&globalMutex);
+        if (state->coalesce == NULL) {
+            state->coalesce = coalesce_create(state);
+        }
+        mutex_unlock(&globalMutex);
+    }
+    return state->coalesce;
+}
+
+
+// Returns the number of queued bytes, flushes in place once the threshold is
+// reached and wakes the owning loop when the queue was empty before
+static int coalesce_push(SocketState state, CoalesceChunk chunk)
+{
+    Coalesce coalesce = state->coalesce;
+    size_t length = chunk->length;
+    chunk->due = impair_shaped(state) ? impair_due(state, length) : 0;
+
+    mutex_lock(&coalesce->mutex);
+    bool wasEmpty = coalesce->head == NULL;
+    if (wasEmpty) {
+        coalesce->head = chunk;
+    } else {
+        coalesce->tail->next = chunk;
+    }
+    coalesce->tail = chunk;
+    coalesce->pending += length;
+    memory_charge(state, (mint)length);
+    bool full = state->coalesceThreshold <= 0 || coalesce->pending >= (size_t)state->coalesceThreshold;
+    mutex_unlock(&coalesce->mutex);
+
+    // without a loop to release it later an impaired write waits here
+    if (chunk->due > 0 && state->owner == NULL) {
+        impair_wait(chunk->due);
+        full = true;
+    }
+
+    if (full) {
+        if (coalesce_flush(state->socketId, coalesce) < 0) {
+            return -1;
+        }
+        // the socket took only part of it, the owning loop waits for POLLOUT
+        if (coalesce_pending(coalesce) && state->owner != NULL) {
+            socket_list_interrupt(state->owner);
+        }
+    } else if (wasEmpty && state->owner != NULL) {
+        socket_list_interrupt(state->owner);
+    }
+
+    return (int)length;
+}
+
+
+int coalesce_append(SocketState state, const BYTE *data, size_t length)
+{
+    return coalesce_append_header(state, NULL, 0, data, length);
+}
+
+
+// Queues a header and its payload as one chunk, so writes from other
+// threads cannot land between them
+int coalesce_append_header(SocketState state, const BYTE *header, size_t headerLength, const BYTE *data, size_t length)
+{
+    if (coalesce_acquire(state) == NULL || !memory_allowed(state, (mint)(headerLength + length))) {
+        return -1;
+    }
+
+    CoalesceChunk chunk = pool_alloc(sizeof(struct CoalesceChunk_st) + headerLength + length);
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    chunk->next = NULL;
+    chunk->length = headerLength + length;
+    chunk->bytes = chunk->data;
+    chunk->shared = NULL;
+    if (headerLength > 0) {
+        memcpy(chunk->data, header, headerLength);
+    }
+    memcpy(chunk->data + headerLength, data, length);
+
+    return coalesce_push(state, chunk);
+}
+
+
+// Queues a reference to the buffer instead of a copy, so one payload can
+// sit in the queues of many connections
+int coalesce_append_shared(SocketState state, SharedBuffer sharedBuffer)
+{
+    if (coalesce_acquire(state) == NULL || !memory_allowed(state, (mint)sharedBuffer->length)) {
+        return -1;
+    }
+
+    CoalesceChunk chunk = pool_alloc(sizeof(struct CoalesceChunk_st));
+    if (chunk == NULL) {
+        return -1;
+    }
+
+    chunk->next = NULL;
+    chunk->length = sharedBuffer->length;
+    chunk->bytes = sharedBuffer->data;
+    chunk->shared = shared_buffer_retain(sharedBuffer);
+
+    return coalesce_push(state, chunk);
+}
+
+
+static void coalesce_chunk_free(CoalesceChunk chunk)
+{
+    if (chunk->shared != NULL) {
+        shared_buffer_release(chunk->shared);
+    }
+    pool_free(chunk);
+}
+
+
+static void coalesce_cork(SOCKET socketId, int enabled)
+{
+    #ifdef TCP_CORK
+    setsockopt(socketId, IPPROTO_TCP, TCP_CORK, (const char*)&enabled, sizeof(enabled));
+    #endif
+}
+
+
+// Sends queued chunks with as few syscalls as possible without blocking,
+// returns 1 when nothing more can go out yet, 0 when the socket is full
+// and -1 on error
+int coalesce_flush(SOCKET socketId, Coalesce coalesce)
+{
+    int result = 1;
+
+    mutex_lock(&coalesce->mutex);
+    if (coalesce->head == NULL) {
+        mutex_unlock(&coalesce->mutex);
+        return result;
+    }
+
+    // WSASend has no per call flag, a socket outside a loop is in the blocking
+    // mode of CSocketConnect and would block with the mutex held
+    #ifdef _WIN32
+    bool unowned = coalesce->state->owner == NULL;
+    if (unowned) {
+        set_non_blocking_mode(socketId);
+    }
+    #endif
+
+    bool corked = false;
+    int sends = 0;
+    size_t segment = impair_segment(coalesce->state);
+    mint now = get_monotonic_time();
+
+    while (coalesce->head != NULL && coalesce->head->due <= now) {
+        int count = 0;
+        size_t budget = segment > 0 ? segment : SIZE_MAX;
+        size_t requested = 0;
+
+        // only a flush that takes more than one call has segments to merge
+        if (!corked && sends > 0) {
+            coalesce_cork(socketId, 1);
+            corked = true;
+        }
+        sends++;
+
+        #ifdef _WIN32
+        WSABUF buffers[COALESCE_MAX_IOV];
+        for (CoalesceChunk chunk = coalesce->head; chunk != NULL && count < COALESCE_MAX_IOV && budget > 0 && chunk->due <= now;
+            chunk = chunk->next) {
+            size_t skip = count == 0 ? coalesce->offset : 0;
+            size_t length = chunk->length - skip < budget ? chunk->length - skip : budget;
+            buffers[count].buf = (char*)chunk->bytes + skip;
+            buffers[count].len = (ULONG)length;
+            budget -= length;
+            requested += length;
+            count++;
+        }
+
+        DWORD sentBytes = 0;
+        long long sent = WSASend(socketId, buffers, count, &sentBytes, 0, NULL, NULL) == 0 ? (long long)sentBytes : -1;
+        #else
+        struct iovec buffers[COALESCE_MAX_IOV];
+        for (CoalesceChunk chunk = coalesce->head; chunk != NULL && count < COALESCE_MAX_IOV && budget > 0 && chunk->due <= now;
+            chunk = chunk->next) {
+            size_t skip = count == 0 ? coalesce->offset : 0;
+            size_t length = chunk->length - skip < budget ? chunk->length - skip : budget;
+            buffers[count].iov_base = (BYTE *)chunk->bytes + skip;
+            buffers[count].iov_len = length;
+            budget -= length;
+            requested += length;
+            count++;
+        }
+
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = buffers;
+        message.msg_iovlen = count;
+
+        long long sent = (long long)sendmsg(socketId, &message, MSG_NOSIGNAL | MSG_DONTWAIT);
+        #endif
+
+        if (sent < 0) {
+            result = is_wouldblock_err(GETSOCKETERRNO()) ? 0 : -1;
+            break;
+        }
+        TRACE_SEND(socketId, sent);
+
+        size_t remaining = (size_t)sent;
+        coalesce->pending -= remaining;
+        memory_charge(coalesce->state, -(mint)remaining);
+        while (coalesce->head != NULL && remaining >= coalesce->head->length - coalesce->offset) {
+            CoalesceChunk chunk = coalesce->head;
+            remaining -= chunk->length - coalesce->offset;
+            coalesce->offset = 0;
+            coalesce->head = chunk->next;
+            coalesce_chunk_free(chunk);
+        }
+        coalesce->offset += remaining;
+
+        if ((size_t)sent < requested) {
+            result = 0;
+            break;
+        }
+    }
+
+    if (coalesce->head == NULL) {
+        coalesce->tail = NULL;
+    }
+
+    if (corked) {
+        coalesce_cork(socketId, 0);
+    }
+
+    #ifdef _WIN32
+    if (unowned) {
+        set_blocking_mode(socketId);
+    }
+    #endif
+    mutex_unlock(&coalesce->mutex);
+
+    return result;
+}
+
+
+bool coalesce_pending(Coalesce coalesce)
+{
+    return coalesce != NULL && coalesce->head != NULL;
+}
+
+
+// When the first write held back by an impairment is released, 0 if none
+mint coalesce_due(Coalesce coalesce)
+{
+    if (!coalesce_pending(coalesce)) {
+        return 0;
+    }
+
+    mutex_lock(&coalesce->mutex);
+    mint due = coalesce->head != NULL ? coalesce->head->due : 0;
+    mutex_unlock(&coalesce->mutex);
+
+    return due > get_monotonic_time() ? due : 0;
+}
+
+
+// Drops everything queued for a connection that can no longer be written
+void coalesce_discard(Coalesce coalesce)
+{
+    mutex_lock(&coalesce->mutex);
+    while (coalesce->head != NULL) {
+        CoalesceChunk chunk = coalesce->head;
+        coalesce->head = chunk->next;
+        coalesce_chunk_free(chunk);
+    }
+    coalesce->tail = NULL;
+    coalesce->offset = 0;
+    memory_charge(coalesce->state, -(mint)coalesce->pending);
+    coalesce->pending = 0;
+    mutex_unlock(&coalesce->mutex);
+}
+
+
+void coalesce_free(Coalesce coalesce)
+{
+    while (coalesce->head != NULL) {
+        CoalesceChunk chunk = coalesce->head;
+        coalesce->head = chunk->next;
+        coalesce_chunk_free(chunk);
+    }
+
+    mutex_destroy(&coalesce->mutex);
+    free(coalesce);
+}
\ No newline at end of file
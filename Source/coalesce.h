@@ -0,0 +1,76 @@
+#ifndef COALESCE_H
+#define COALESCE_H
+
+
+#include "common.h"
+#include "state.h"
+#include "list.h"
+#include "memory.h"
+#include "pool.h"
+#include "buffer.h"
+#include "impair.h"
+#include "trace.h"
+
+
+#ifndef _WIN32
+    #include <sys/uio.h>
+#endif
+
+
+#define COALESCE_MAX_IOV 64
+
+
+// A queued write, either copied into data or holding a reference to a
+// buffer shared with other connections. An impaired socket releases it
+// at due
+typedef struct CoalesceChunk_st
+{
+    struct CoalesceChunk_st *next;
+    size_t length;
+    mint due;
+    const BYTE *bytes;
+    SharedBuffer shared;
+    BYTE data[];
+} *CoalesceChunk;
+
+
+// Writes queued for one connection, flushed together by the poll loop
+typedef struct Coalesce_st
+{
+    Mutex mutex;
+    SocketState state;
+    CoalesceChunk head;
+    CoalesceChunk tail;
+    size_t offset;
+    size_t pending;
+} *Coalesce;
+
+
+bool coalesce_enabled(SocketState state);
+
+
+int coalesce_append(SocketState state, const BYTE *data, size_t length);
+
+
+int coalesce_append_header(SocketState state, const BYTE *header, size_t headerLength, const BYTE *data, size_t length);
+
+
+int coalesce_append_shared(SocketState state, SharedBuffer sharedBuffer);
+
+
+int coalesce_flush(SOCKET socketId, Coalesce coalesce);
+
+
+bool coalesce_pending(Coalesce coalesce);
+
+
+mint coalesce_due(Coalesce coalesce);
+
+
+void coalesce_discard(Coalesce coalesce);
+
+
+void coalesce_free(Coalesce coalesce);
+
+
+#endif
\ No newline at end of file
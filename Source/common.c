@@ -1,6 +1,9 @@
 #include "common.h"
 
 
+Mutex globalMutex = MUTEX_INITIALIZER;
+
+
 void print(const char* format, ...)
 {
     #ifdef _DEBUG
@@ -65,6 +68,55 @@ void cleanup_wsa()
 }
 
 
+void mutex_lock(Mutex *mutex)
+{
+    #ifdef _WIN32
+    if (*mutex == NULL) {
+        HANDLE created = CreateMutex(NULL, FALSE, NULL);
+        if (InterlockedCompareExchangePointer(mutex, created, NULL) != NULL) {
+            CloseHandle(created);
+        }
+    }
+    WaitForSingleObject(*mutex, INFINITE);
+    #else
+    pthread_mutex_lock(mutex);
+    #endif
+}
+
+
+void mutex_unlock(Mutex *mutex)
+{
+    #ifdef _WIN32
+    ReleaseMutex(*mutex);
+    #else
+    pthread_mutex_unlock(mutex);
+    #endif
+}
+
+
+void mutex_init(Mutex *mutex)
+{
+    #ifdef _WIN32
+    *mutex = NULL;
+    #else
+    pthread_mutex_init(mutex, NULL);
+    #endif
+}
+
+
+void mutex_destroy(Mutex *mutex)
+{
+    #ifdef _WIN32
+    if (*mutex != NULL) {
+        CloseHandle(*mutex);
+        *mutex = NULL;
+    }
+    #else
+    pthread_mutex_destroy(mutex);
+    #endif
+}
+
+
 void set_blocking_mode(SOCKET socketId)
 {
     #ifdef _WIN32
@@ -141,6 +193,33 @@ bool is_valid_socket(SOCKET socketId)
 }
 
 
+// A zero timeout poll decides whether the peek can block, so the socket's
+// blocking mode is left alone. Unread data counts as connected, an orderly
+// shutdown or a pending error does not.
+bool is_connected_socket(SOCKET socketId)
+{
+    if (!is_valid_socket(socketId)) {
+        return false;
+    }
+
+    POLL_FD pollFd;
+    pollFd.fd = socketId;
+    pollFd.events = POLLIN_FLAG;
+    pollFd.revents = 0;
+
+    int ready = POLL_FUNCTION(&pollFd, 1, 0);
+    if (ready == 0) {
+        return true;
+    }
+    if (ready < 0 || (pollFd.revents & (POLLERR_FLAG | POLLNVAL)) != 0) {
+        return false;
+    }
+
+    char dummy;
+    return recv(socketId, &dummy, 1, MSG_PEEK) > 0;
+}
+
+
 bool is_wouldblock_err(int err)
 {
     #ifdef _WIN32
@@ -151,6 +230,288 @@ bool is_wouldblock_err(int err)
 }
 
 
+// Returns the new value
+mint atomic_add(mint *target, mint value)
+{
+    #ifdef _WIN32
+    return InterlockedExchangeAdd64(target, value) + value;
+    #else
+    return __atomic_add_fetch(target, value, __ATOMIC_ACQ_REL);
+    #endif
+}
+
+
+mint atomic_get(mint *target)
+{
+    #ifdef _WIN32
+    return InterlockedCompareExchange64(target, 0, 0);
+    #else
+    return __atomic_load_n(target, __ATOMIC_ACQUIRE);
+    #endif
+}
+
+
+void atomic_set(mint *target, mint value)
+{
+    #ifdef _WIN32
+    InterlockedExchange64(target, value);
+    #else
+    __atomic_store_n(target, value, __ATOMIC_RELEASE);
+    #endif
+}
+
+
+// Returns the previous value
+mint atomic_swap(mint *target, mint value)
+{
+    #ifdef _WIN32
+    return InterlockedExchange64(target, value);
+    #else
+    return __atomic_exchange_n(target, value, __ATOMIC_ACQ_REL);
+    #endif
+}
+
+
+void wakeup_init(Wakeup *wakeup)
+{
+    wakeup->generation = 0;
+    wakeup->waiters = 0;
+
+    #ifdef _WIN32
+    InitializeSRWLock(&wakeup->lock);
+    InitializeConditionVariable(&wakeup->cond);
+    #else
+    pthread_mutex_init(&wakeup->lock, NULL);
+    pthread_condattr_t attributes;
+    pthread_condattr_init(&attributes);
+    #ifndef __APPLE__
+    pthread_condattr_setclock(&attributes, CLOCK_MONOTONIC);
+    #endif
+    pthread_cond_init(&wakeup->cond, &attributes);
+    pthread_condattr_destroy(&attributes);
+    #endif
+}
+
+
+void wakeup_destroy(Wakeup *wakeup)
+{
+    #ifndef _WIN32
+    pthread_cond_destroy(&wakeup->cond);
+    pthread_mutex_destroy(&wakeup->lock);
+    #endif
+}
+
+
+mint wakeup_generation(Wakeup *wakeup)
+{
+    return atomic_get(&wakeup->generation);
+}
+
+
+// Cheap while nobody sleeps, the lock is only taken to wake a waiter. Both
+// counters change with read-modify-writes, so either the waiter sees the new
+// generation or the notifier sees the waiter.
+void wakeup_notify(Wakeup *wakeup)
+{
+    atomic_add(&wakeup->generation, 1);
+    if (atomic_add(&wakeup->waiters, 0) == 0) {
+        return;
+    }
+
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&wakeup->lock);
+    WakeAllConditionVariable(&wakeup->cond);
+    ReleaseSRWLockExclusive(&wakeup->lock);
+    #else
+    pthread_mutex_lock(&wakeup->lock);
+    pthread_cond_broadcast(&wakeup->cond);
+    pthread_mutex_unlock(&wakeup->lock);
+    #endif
+}
+
+
+// Sleeps until the generation moves past the one read before checking the
+// condition, or timeout_us passes, -1 waits forever
+void wakeup_wait(Wakeup *wakeup, mint generation, mint timeout_us)
+{
+    mint deadline = get_monotonic_time() + timeout_us * 1000;
+
+    #ifdef _WIN32
+    AcquireSRWLockExclusive(&wakeup->lock);
+    #else
+    pthread_mutex_lock(&wakeup->lock);
+    #endif
+    atomic_add(&wakeup->waiters, 1);
+
+    while (atomic_get(&wakeup->generation) == generation) {
+        mint remaining = deadline - get_monotonic_time();
+        if (timeout_us >= 0 && remaining <= 0) {
+            break;
+        }
+
+        #ifdef _WIN32
+        DWORD wait = timeout_us < 0 ? INFINITE : (DWORD)((remaining + 999999) / 1000000);
+        SleepConditionVariableSRW(&wakeup->cond, &wakeup->lock, wait, 0);
+        #else
+        if (timeout_us < 0) {
+            pthread_cond_wait(&wakeup->cond, &wakeup->lock);
+            continue;
+        }
+
+        struct timespec ts;
+        #ifdef __APPLE__
+        ts.tv_sec = (time_t)(remaining / 1000000000);
+        ts.tv_nsec = (long)(remaining % 1000000000);
+        pthread_cond_timedwait_relative_np(&wakeup->cond, &wakeup->lock, &ts);
+        #else
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        mint nanoseconds = (mint)ts.tv_nsec + remaining;
+        ts.tv_sec += (time_t)(nanoseconds / 1000000000);
+        ts.tv_nsec = (long)(nanoseconds % 1000000000);
+        pthread_cond_timedwait(&wakeup->cond, &wakeup->lock, &ts);
+        #endif
+        #endif
+    }
+
+    atomic_add(&wakeup->waiters, -1);
+    #ifdef _WIN32
+    ReleaseSRWLockExclusive(&wakeup->lock);
+    #else
+    pthread_mutex_unlock(&wakeup->lock);
+    #endif
+}
+
+
+int send_all(SOCKET socketId, const BYTE *data, size_t length)
+{
+    size_t sent = 0;
+
+    while (sent < length) {
+        int result = send(socketId, (const char *)data + sent, (int)(length - sent), MSG_NOSIGNAL);
+        if (result < 0 && is_wouldblock_err(GETSOCKETERRNO())) {
+            POLL_FD pollfd;
+            pollfd.fd = socketId;
+            pollfd.events = POLLOUT_FLAG;
+            pollfd.revents = 0;
+            sockets_poll(&pollfd, 1, -1);
+            continue;
+        }
+        if (result <= 0) {
+            return SOCKET_ERROR;
+        }
+        sent += (size_t)result;
+    }
+
+    return (int)sent;
+}
+
+
+// Like send_all for a header followed by a payload, both go out in one
+// gather write so the payload is never copied next to the header
+int send_all_header(SOCKET socketId, const BYTE *header, size_t headerLength, const BYTE *data, size_t length)
+{
+    size_t total = headerLength + length;
+    size_t sent = 0;
+
+    while (sent < total) {
+        size_t dataOffset = sent > headerLength ? sent - headerLength : 0;
+        int result;
+
+        #ifdef _WIN32
+        WSABUF buffers[2];
+        DWORD count = 0;
+        DWORD sentBytes = 0;
+        if (sent < headerLength) {
+            buffers[count].buf = (char *)header + sent;
+            buffers[count].len = (ULONG)(headerLength - sent);
+            count++;
+        }
+        buffers[count].buf = (char *)data + dataOffset;
+        buffers[count].len = (ULONG)(length - dataOffset);
+        count++;
+        result = WSASend(socketId, buffers, count, &sentBytes, 0, NULL, NULL) == 0 ? (int)sentBytes : SOCKET_ERROR;
+        #else
+        struct iovec buffers[2];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        if (sent < headerLength) {
+            buffers[message.msg_iovlen].iov_base = (void *)(header + sent);
+            buffers[message.msg_iovlen].iov_len = headerLength - sent;
+            message.msg_iovlen++;
+        }
+        buffers[message.msg_iovlen].iov_base = (void *)(data + dataOffset);
+        buffers[message.msg_iovlen].iov_len = length - dataOffset;
+        message.msg_iovlen++;
+        message.msg_iov = buffers;
+        result = (int)sendmsg(socketId, &message, MSG_NOSIGNAL);
+        #endif
+
+        if (result < 0 && is_wouldblock_err(GETSOCKETERRNO())) {
+            POLL_FD pollfd;
+            pollfd.fd = socketId;
+            pollfd.events = POLLOUT_FLAG;
+            pollfd.revents = 0;
+            sockets_poll(&pollfd, 1, -1);
+            continue;
+        }
+        if (result <= 0) {
+            return SOCKET_ERROR;
+        }
+        sent += (size_t)result;
+    }
+
+    return (int)sent;
+}
+
+
+// Accepted sockets start non-blocking and close on exec
+SOCKET accept_nonblocking(SOCKET socketId, struct sockaddr_storage *address, socklen_t *addressLength)
+{
+    #ifdef __linux__
+    return accept4(socketId, (struct sockaddr *)address, addressLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    #else
+    SOCKET acceptedSocketId = accept(socketId, (struct sockaddr *)address, addressLength);
+    if (ISVALIDSOCKET(acceptedSocketId)) {
+        set_non_blocking_mode(acceptedSocketId);
+    }
+    return acceptedSocketId;
+    #endif
+}
+
+
+// Receives only what is already queued, even on a blocking socket
+int recv_nonblocking(SOCKET socketId, BYTE *buffer, size_t length)
+{
+    #ifdef _WIN32
+    u_long available = 0;
+    if (ioctlsocket(socketId, FIONREAD, &available) == 0 && available == 0) {
+        WSASetLastError(WSAEWOULDBLOCK);
+        return SOCKET_ERROR;
+    }
+    return recv(socketId, (char *)buffer, (int)length, 0);
+    #else
+    return (int)recv(socketId, buffer, length, MSG_DONTWAIT);
+    #endif
+}
+
+
+// Monotonic clock in nanoseconds, only meaningful as a difference
+mint get_monotonic_time()
+{
+    #ifdef _WIN32
+    LARGE_INTEGER counter;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (mint)((double)counter.QuadPart * 1e9 / (double)frequency.QuadPart);
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (mint)ts.tv_sec * 1000000000 + (mint)ts.tv_nsec;
+    #endif
+}
+
+
 struct timeval new_tv(long long usec)
 {
     struct timeval tv = {
@@ -218,20 +579,28 @@ void copy_tensor_to_socket_array(WolframLibraryData libData, MTensor tensor, SOC
 }
 
 
+// Converts a timeout in microseconds to the milliseconds poll and epoll take,
+// rounding short positive timeouts up to 1 ms and keeping -1 as infinite
+int poll_timeout_ms(mint timeout_us)
+{
+    if (timeout_us < 0) {
+        return -1;
+    }
+
+    int timeout_ms = (int)(timeout_us / 1000);
+    if (timeout_us > 0 && timeout_ms == 0) {
+        timeout_ms = 1;  // 1 is min for poll
+    }
+    return timeout_ms;
+}
+
+
 // Wrapper for poll/WSAPoll to handle timeout conversion and platform differences
 // timeout_us: -1 for infinite, 0 for non-blocking, >0 for timeout in microseconds
 // returns: number of fds with events, 0 for timeout, -1 for error
 int sockets_poll(POLL_FD *fds, mint length, mint timeout_us)
 {
-    int timeout_ms;
-    if (timeout_us == -1) {
-        timeout_ms = -1;
-    } else {
-        timeout_ms = (int)(timeout_us / 1000);
-        if (timeout_us > 0 && timeout_ms == 0) {
-            timeout_ms = 1;  // 1 is min for poll
-        }
-    }
+    int timeout_ms = poll_timeout_ms(timeout_us);
 
     #ifdef _WIN32
         int result = WSAPoll(fds, (int)length, timeout_ms);
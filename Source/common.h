@@ -5,6 +5,11 @@
 #undef UNICODE
 
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+    #define _GNU_SOURCE
+#endif
+
+
 #define _DEBUG 1
 #define FD_SETSIZE 4096
 #define SECOND 1000000
@@ -40,10 +45,16 @@
     #define POLL_FD WSAPOLLFD
     #define POLL_FUNCTION WSAPoll
     #define POLLIN_FLAG POLLRDNORM
+    #define POLLOUT_FLAG POLLWRNORM
     #define POLLERR_FLAG POLLERR
+    #define SHUT_WR SD_SEND
+    #define THREAD_LOCAL __declspec(thread)
+    #define OPENLIBRARY(path) ((void *)LoadLibraryA(path))
+    #define LIBRARYSYMBOL(handle, name) ((void *)GetProcAddress((HMODULE)(handle), (name)))
 #else
     #include <sys/types.h>
     #include <sys/socket.h>
+    #include <sys/un.h>
     #include <netinet/in.h>
     #include <arpa/inet.h>
     #include <netdb.h>
@@ -53,6 +64,7 @@
     #include <wchar.h>
     #include <netinet/tcp.h>
     #include <sys/select.h>
+    #include <sys/uio.h>
     #include <time.h>
     #include <sys/time.h>
     #include <pthread.h>
@@ -76,7 +88,16 @@
     #define POLL_FD struct pollfd
     #define POLL_FUNCTION poll
     #define POLLIN_FLAG POLLIN
+    #define POLLOUT_FLAG POLLOUT
     #define POLLERR_FLAG POLLERR
+    #define OPENLIBRARY(path) dlopen((path), RTLD_NOW | RTLD_LOCAL)
+    #define LIBRARYSYMBOL(handle, name) dlsym((handle), (name))
+    #define THREAD_LOCAL __thread
+#endif
+
+
+#ifndef MSG_NOSIGNAL
+    #define MSG_NOSIGNAL 0
 #endif
 
 
@@ -105,6 +126,22 @@
 #include "WolframImageLibrary.h"
 
 
+// Lets a thread sleep until another one reports progress: read the
+// generation, check the condition, then wait for the generation to move
+typedef struct Wakeup_st
+{
+    #ifdef _WIN32
+    SRWLOCK lock;
+    CONDITION_VARIABLE cond;
+    #else
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    #endif
+    mint generation;
+    mint waiters;
+} Wakeup;
+
+
 void print(const char* format, ...);
 
 
@@ -117,6 +154,18 @@ void init_wsa();
 void cleanup_wsa();
 
 
+void mutex_lock(Mutex *mutex);
+
+
+void mutex_unlock(Mutex *mutex);
+
+
+void mutex_init(Mutex *mutex);
+
+
+void mutex_destroy(Mutex *mutex);
+
+
 void set_blocking_mode(SOCKET socketId);
 
 
@@ -129,9 +178,54 @@ bool is_non_blocking_mode(SOCKET socketId);
 bool is_valid_socket(SOCKET socketId);
 
 
+bool is_connected_socket(SOCKET socketId);
+
+
 bool is_wouldblock_err(int err);
 
 
+mint atomic_add(mint *target, mint value);
+
+
+mint atomic_get(mint *target);
+
+
+void atomic_set(mint *target, mint value);
+
+
+mint atomic_swap(mint *target, mint value);
+
+
+void wakeup_init(Wakeup *wakeup);
+
+
+void wakeup_destroy(Wakeup *wakeup);
+
+
+mint wakeup_generation(Wakeup *wakeup);
+
+
+void wakeup_notify(Wakeup *wakeup);
+
+
+void wakeup_wait(Wakeup *wakeup, mint generation, mint timeout_us);
+
+
+int send_all(SOCKET socketId, const BYTE *data, size_t length);
+
+
+int send_all_header(SOCKET socketId, const BYTE *header, size_t headerLength, const BYTE *data, size_t length);
+
+
+SOCKET accept_nonblocking(SOCKET socketId, struct sockaddr_storage *address, socklen_t *addressLength);
+
+
+int recv_nonblocking(SOCKET socketId, BYTE *buffer, size_t length);
+
+
+mint get_monotonic_time();
+
+
 struct timeval new_tv(long long usec);
 
 
@@ -147,6 +241,9 @@ SOCKET fill_fd_set_from_array(fd_set *set, SOCKET *sockets, size_t length, SOCKE
 void copy_tensor_to_socket_array(WolframLibraryData libData, MTensor tensor, SOCKET *result, size_t length);
 
 
+int poll_timeout_ms(mint timeout_us);
+
+
 int sockets_poll(POLL_FD *fds, mint length, mint timeout_us);
 
 
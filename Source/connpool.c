@@ -0,0 +1,381 @@
+#include "connpool.h"
+
+
+// Hosts are kept for the life of the library, connections move between a
+// host's idle list and the lease list, all guarded by poolMutex
+static PoolHost poolHosts = NULL;
+static PoolLease poolLeases = NULL;
+static mint poolMaxIdle = CONNPOOL_MAX_IDLE_DEFAULT;
+static mint poolMaxPerHost = CONNPOOL_MAX_PER_HOST_DEFAULT;
+static mint poolIdleTimeout = CONNPOOL_IDLE_TIMEOUT_DEFAULT;
+static mint poolHits = 0;
+static mint poolMisses = 0;
+static mint poolEvictions = 0;
+static Mutex poolMutex = MUTEX_INITIALIZER;
+
+
+static PoolHost connpool_host(const char *host, mint port, int protocol)
+{
+    PoolHost poolHost = poolHosts;
+    while (poolHost != NULL &&
+        (poolHost->port != port || poolHost->protocol != protocol || strcmp(poolHost->host, host) != 0)) {
+        poolHost = poolHost->next;
+    }
+
+    if (poolHost == NULL) {
+        poolHost = calloc(1, sizeof(struct PoolHost_st));
+        snprintf(poolHost->host, sizeof(poolHost->host), "%s", host);
+        poolHost->port = port;
+        poolHost->protocol = protocol;
+        poolHost->next = poolHosts;
+        poolHosts = poolHost;
+    }
+    return poolHost;
+}
+
+
+// A connection with RPC calls in flight keeps its replies in the socket
+// state, closing it would lose them
+static bool connpool_pinned(SOCKET socketId)
+{
+    bool pinned = false;
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    if (state != NULL && state->rpc != NULL) {
+        mutex_lock(&state->rpc->mutex);
+        pinned = state->rpc->pending > 0;
+        mutex_unlock(&state->rpc->mutex);
+    }
+    mutex_unlock(&globalMutex);
+
+    return pinned;
+}
+
+
+static void connpool_close(SOCKET socketId)
+{
+    SocketState state = socket_state_get(socketId);
+    zerocopy_close(state, socketId, 0);
+    socket_state_release(state);
+
+    socket_state_remove(socketId);
+    CLOSESOCKET(socketId);
+}
+
+
+// Closes idle connections older than the idle timeout, or all of them
+static void connpool_evict(bool all)
+{
+    mint now = get_monotonic_time();
+
+    for (PoolHost poolHost = poolHosts; poolHost != NULL; poolHost = poolHost->next) {
+        PoolConnection *link = &poolHost->idle;
+        while (*link != NULL) {
+            PoolConnection connection = *link;
+            if (!all && (now - connection->idleSince < poolIdleTimeout || connpool_pinned(connection->socketId))) {
+                link = &connection->next;
+                continue;
+            }
+
+            *link = connection->next;
+            poolHost->idleCount--;
+            poolEvictions++;
+            connpool_close(connection->socketId);
+            free(connection);
+        }
+    }
+}
+
+
+static void connpool_lease(SOCKET socketId, PoolHost poolHost)
+{
+    PoolLease lease = malloc(sizeof(struct PoolLease_st));
+    lease->socketId = socketId;
+    lease->host = poolHost;
+    lease->next = poolLeases;
+    poolLeases = lease;
+}
+
+
+// Removes the lease of a checked out connection and gives its host
+static PoolHost connpool_unlease(SOCKET socketId)
+{
+    PoolLease *link = &poolLeases;
+    while (*link != NULL && (*link)->socketId != socketId) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return NULL;
+    }
+
+    PoolLease lease = *link;
+    PoolHost poolHost = lease->host;
+    *link = lease->next;
+    poolHost->inUse--;
+    free(lease);
+    return poolHost;
+}
+
+
+// Called without poolMutex, name lookups can take long
+static bool connpool_resolve(PoolHost poolHost, struct sockaddr_storage *resolved, socklen_t *resolvedLength)
+{
+    struct addrinfo hints;
+    struct addrinfo *address = NULL;
+    char port[16];
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = poolHost->protocol;
+    snprintf(port, sizeof(port), "%lld", (long long)poolHost->port);
+
+    if (getaddrinfo(poolHost->host, port, &hints, &address) != 0 || address == NULL) {
+        return false;
+    }
+
+    memcpy(resolved, address->ai_addr, address->ai_addrlen);
+    *resolvedLength = (socklen_t)address->ai_addrlen;
+    freeaddrinfo(address);
+    return true;
+}
+
+
+// Connects without blocking past the timeout in microseconds and leaves the
+// socket in blocking mode, the default of CSocketConnect
+static SOCKET connpool_connect(PoolHost poolHost, struct sockaddr_storage *address, socklen_t addressLength, mint timeout)
+{
+    SOCKET socketId = socket(address->ss_family, poolHost->protocol, 0);
+    if (!ISVALIDSOCKET(socketId)) {
+        return INVALID_SOCKET;
+    }
+
+    set_non_blocking_mode(socketId);
+    if (connect(socketId, (struct sockaddr *)address, addressLength) == SOCKET_ERROR) {
+        int err = GETSOCKETERRNO();
+        #ifdef _WIN32
+        bool inProgress = err == WSAEWOULDBLOCK;
+        #else
+        bool inProgress = err == EINPROGRESS;
+        #endif
+
+        POLL_FD pollFd;
+        pollFd.fd = socketId;
+        pollFd.events = POLLOUT_FLAG;
+        pollFd.revents = 0;
+
+        int error = 0;
+        socklen_t length = sizeof(error);
+        if (!inProgress ||
+            POLL_FUNCTION(&pollFd, 1, poll_timeout_ms(timeout)) <= 0 ||
+            getsockopt(socketId, SOL_SOCKET, SO_ERROR, (char *)&error, &length) != 0 || error != 0) {
+            CLOSESOCKET(socketId);
+            return INVALID_SOCKET;
+        }
+    }
+    set_blocking_mode(socketId);
+
+    return socketId;
+}
+
+
+// Gives a connection to host:port, an idle one that is still connected when
+// there is one and a new one otherwise. protocol is the socket type, stream
+// or datagram. Fails when maxPerHost connections to the host are out.
+DLLEXPORT int socketConnPoolCheckout(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    char *host = MArgument_getUTF8String(Args[0]);
+    mint port = MArgument_getInteger(Args[1]);
+    int protocol = (int)MArgument_getInteger(Args[2]);
+    mint timeout = MArgument_getInteger(Args[3]); // connect timeout in microseconds, -1 - no timeout
+
+    if (strlen(host) >= CONNPOOL_HOST_MAX) {
+        libData->UTF8String_disown(host);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mutex_lock(&poolMutex);
+    PoolHost poolHost = connpool_host(host, port, protocol);
+    libData->UTF8String_disown(host);
+    connpool_evict(false);
+
+    // the most recently used connection is the least likely to be stale
+    while (poolHost->idle != NULL) {
+        PoolConnection connection = poolHost->idle;
+        SOCKET socketId = connection->socketId;
+        poolHost->idle = connection->next;
+        poolHost->idleCount--;
+        free(connection);
+
+        if (!is_connected_socket(socketId)) {
+            poolEvictions++;
+            connpool_close(socketId);
+            continue;
+        }
+
+        poolHost->inUse++;
+        poolHits++;
+        connpool_lease(socketId, poolHost);
+        mutex_unlock(&poolMutex);
+
+        MArgument_setInteger(Res, socketId);
+        return LIBRARY_NO_ERROR;
+    }
+
+    if (poolMaxPerHost > 0 && poolHost->inUse >= poolMaxPerHost) {
+        mutex_unlock(&poolMutex);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    poolHost->inUse++;
+    poolMisses++;
+    struct sockaddr_storage address = poolHost->address;
+    socklen_t addressLength = poolHost->addressLength;
+    mutex_unlock(&poolMutex);
+
+    bool resolved = addressLength > 0;
+    if (!resolved && !connpool_resolve(poolHost, &address, &addressLength)) {
+        mutex_lock(&poolMutex);
+        poolHost->inUse--;
+        mutex_unlock(&poolMutex);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SOCKET socketId = connpool_connect(poolHost, &address, addressLength, timeout);
+
+    mutex_lock(&poolMutex);
+    if (!resolved && ISVALIDSOCKET(socketId)) {
+        poolHost->address = address;
+        poolHost->addressLength = addressLength;
+    }
+    if (!ISVALIDSOCKET(socketId)) {
+        // resolve again next time, the host may have moved
+        poolHost->addressLength = 0;
+        poolHost->inUse--;
+        mutex_unlock(&poolMutex);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    connpool_lease(socketId, poolHost);
+    mutex_unlock(&poolMutex);
+
+    MArgument_setInteger(Res, socketId);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Returns a checked out connection. With reuse it stays open for the next
+// checkout unless it is broken or the host has maxIdle idle connections,
+// otherwise it is closed. Gives False for a socket the pool did not hand out.
+DLLEXPORT int socketConnPoolCheckin(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mbool reuse = MArgument_getBoolean(Args[1]);
+
+    mutex_lock(&poolMutex);
+    PoolHost poolHost = connpool_unlease(socketId);
+    bool leased = poolHost != NULL;
+
+    if (leased) {
+        bool pinned = connpool_pinned(socketId);
+        if ((reuse || pinned) && (poolHost->idleCount < poolMaxIdle || pinned) && is_connected_socket(socketId)) {
+            PoolConnection connection = malloc(sizeof(struct PoolConnection_st));
+            connection->socketId = socketId;
+            connection->idleSince = get_monotonic_time();
+            connection->next = poolHost->idle;
+            poolHost->idle = connection;
+            poolHost->idleCount++;
+        } else {
+            connpool_close(socketId);
+        }
+        connpool_evict(false);
+    }
+    mutex_unlock(&poolMutex);
+
+    MArgument_setBoolean(Res, leased);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketConnPoolSetLimits(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint maxIdle = MArgument_getInteger(Args[0]);     // idle connections kept per host
+    mint maxPerHost = MArgument_getInteger(Args[1]);  // checked out connections per host, 0 - no limit
+    mint idleTimeout = MArgument_getInteger(Args[2]); // microseconds an idle connection is kept
+
+    if (maxIdle < 0 || maxPerHost < 0 || idleTimeout < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mutex_lock(&poolMutex);
+    poolMaxIdle = maxIdle;
+    poolMaxPerHost = maxPerHost;
+    poolIdleTimeout = idleTimeout * 1000;
+    connpool_evict(false);
+    mutex_unlock(&poolMutex);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Closes every idle connection, checked out ones are not touched
+DLLEXPORT int socketConnPoolClear(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mutex_lock(&poolMutex);
+    connpool_evict(true);
+    mutex_unlock(&poolMutex);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+// {hosts, idle, checkedOut, hits, misses, evictions}
+DLLEXPORT int socketConnPoolStats(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint dims = 6;
+    MTensor stats;
+    libData->MTensor_new(MType_Integer, 1, &dims, &stats);
+    mint *statsData = libData->MTensor_getIntegerData(stats);
+    memset(statsData, 0, sizeof(mint) * dims);
+
+    mutex_lock(&poolMutex);
+    for (PoolHost poolHost = poolHosts; poolHost != NULL; poolHost = poolHost->next) {
+        statsData[0]++;
+        statsData[1] += poolHost->idleCount;
+        statsData[2] += poolHost->inUse;
+    }
+    statsData[3] = poolHits;
+    statsData[4] = poolMisses;
+    statsData[5] = poolEvictions;
+    mutex_unlock(&poolMutex);
+
+    MArgument_setMTensor(Res, stats);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Called by socketClose, a connection closed while checked out no longer
+// counts against its host and one closed while idle leaves the pool, so
+// an eviction cannot close its descriptor again once it is reused
+void connpool_forget(SOCKET socketId)
+{
+    mutex_lock(&poolMutex);
+    if (poolLeases != NULL) {
+        connpool_unlease(socketId);
+    }
+
+    for (PoolHost poolHost = poolHosts; poolHost != NULL; poolHost = poolHost->next) {
+        PoolConnection *link = &poolHost->idle;
+        while (*link != NULL) {
+            PoolConnection connection = *link;
+            if (connection->socketId != socketId) {
+                link = &connection->next;
+                continue;
+            }
+
+            *link = connection->next;
+            poolHost->idleCount--;
+            free(connection);
+        }
+    }
+    mutex_unlock(&poolMutex);
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#ifndef CONNPOOL_H
+#define CONNPOOL_H
+
+
+#include "common.h"
+#include "state.h"
+#include "rpc.h"
+#include "zerocopy.h"
+
+
+#define CONNPOOL_HOST_MAX 256
+#define CONNPOOL_MAX_IDLE_DEFAULT 8
+#define CONNPOOL_MAX_PER_HOST_DEFAULT 64
+#define CONNPOOL_IDLE_TIMEOUT_DEFAULT (60 * (mint)1000000000)
+
+
+// An idle connection waiting for the next checkout
+typedef struct PoolConnection_st
+{
+    SOCKET socketId;
+    mint idleSince;
+    struct PoolConnection_st *next;
+} *PoolConnection;
+
+
+// Outbound connections to one (host, port, protocol), the address is
+// resolved once and kept until a connect to it fails
+typedef struct PoolHost_st
+{
+    char host[CONNPOOL_HOST_MAX];
+    mint port;
+    int protocol;
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    PoolConnection idle;
+    mint idleCount;
+    mint inUse;
+    struct PoolHost_st *next;
+} *PoolHost;
+
+
+// A checked out connection and the host it goes back to
+typedef struct PoolLease_st
+{
+    SOCKET socketId;
+    PoolHost host;
+    struct PoolLease_st *next;
+} *PoolLease;
+
+
+void connpool_forget(SOCKET socketId);
+
+
+#endif
\ No newline at end of file
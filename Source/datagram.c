@@ -0,0 +1,172 @@
+#include "datagram.h"
+
+
+// Sends length bytes as datagrams of segmentSize bytes, the last one may be
+// shorter. With UDP_SEGMENT the kernel splits up to 64 of them per call,
+// otherwise every datagram is its own sendto. Returns the bytes sent
+DLLEXPORT int socketSendToSegmented(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+
+    char *host = MArgument_getUTF8String(Args[1]);
+    unsigned short port = (unsigned short)MArgument_getInteger(Args[2]);
+
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[3]);
+    BYTE *data = (BYTE *)libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    mint length = MArgument_getInteger(Args[4]);
+    mint segmentSize = MArgument_getInteger(Args[5]);
+
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+
+    if (segmentSize <= 0 || segmentSize > DATAGRAM_MAX || !socket_address_from_host(host, port, &address, &addressLength)) {
+        libData->UTF8String_disown(host);
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mint sent = 0;
+    bool offload = false;
+
+    #ifdef DATAGRAM_OFFLOAD
+    offload = segmentSize < length;
+    mint batch = DATAGRAM_MAX / segmentSize < DATAGRAM_SEGMENTS_MAX ? DATAGRAM_MAX / segmentSize : DATAGRAM_SEGMENTS_MAX;
+    #endif
+
+    while (sent < length) {
+        int result;
+
+        #ifdef DATAGRAM_OFFLOAD
+        if (offload) {
+            mint chunk = length - sent < batch * segmentSize ? length - sent : batch * segmentSize;
+
+            char control[CMSG_SPACE(sizeof(uint16_t))];
+            memset(control, 0, sizeof(control));
+            struct iovec iov = {data + sent, (size_t)chunk};
+            struct msghdr message;
+            memset(&message, 0, sizeof(message));
+            message.msg_name = &address;
+            message.msg_namelen = addressLength;
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+
+            struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+            *(uint16_t *)CMSG_DATA(cmsg) = (uint16_t)segmentSize;
+
+            result = (int)sendmsg(socketId, &message, MSG_NOSIGNAL);
+            if (result < 0 && !is_wouldblock_err(GETSOCKETERRNO())) {
+                // no GSO on this kernel or device, send one datagram per call
+                offload = false;
+                continue;
+            }
+        } else
+        #endif
+        {
+            mint chunk = length - sent < segmentSize ? length - sent : segmentSize;
+            result = sendto(socketId, (const char *)data + sent, (int)chunk, 0, (const struct sockaddr *)&address, addressLength);
+        }
+
+        if (result < 0 && is_wouldblock_err(GETSOCKETERRNO())) {
+            POLL_FD pollfd;
+            pollfd.fd = socketId;
+            pollfd.events = POLLOUT_FLAG;
+            pollfd.revents = 0;
+            sockets_poll(&pollfd, 1, -1);
+            continue;
+        }
+        if (result < 0) {
+            break;
+        }
+        sent += result;
+    }
+
+    libData->UTF8String_disown(host);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+
+    if (sent < length) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setInteger(Res, sent);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// With UDP_GRO the poll loop may get several datagrams of one flow as one
+// buffer and reports where each starts
+DLLEXPORT int socketUdpGroEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mbool enable = MArgument_getBoolean(Args[1]);
+
+    #ifdef DATAGRAM_OFFLOAD
+    int value = enable ? 1 : 0;
+    if (setsockopt(socketId, SOL_UDP, UDP_GRO, &value, sizeof(value)) != 0) {
+        enable = False;
+    }
+    #else
+    enable = False;
+    #endif
+
+    SocketState state = socket_state_acquire(socketId);
+    state->gro = enable;
+    socket_state_release(state);
+    MArgument_setBoolean(Res, enable);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// recvfrom that also returns the GRO segment size, 0 when the buffer holds
+// a single datagram, and the arrival time when arrival is not NULL
+int datagram_recv(SOCKET socketId, BYTE *buffer, size_t capacity,
+    struct sockaddr_storage *address, socklen_t *addressLength, mint *segmentSize, mint *arrival)
+{
+    *segmentSize = 0;
+
+    #ifdef DATAGRAM_OFFLOAD
+    char control[CMSG_SPACE(sizeof(int)) + CMSG_SPACE(sizeof(struct timespec))];
+    struct iovec iov = {buffer, capacity};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_name = address;
+    message.msg_namelen = *addressLength;
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    int result = (int)recvmsg(socketId, &message, 0);
+    if (result <= 0) {
+        return result;
+    }
+    *addressLength = message.msg_namelen;
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            if (size > 0 && size < result) {
+                *segmentSize = size;
+            }
+        }
+    }
+    if (arrival != NULL) {
+        *arrival = timestamp_read(&message);
+        if (*arrival == 0) {
+            *arrival = timestamp_now();
+        }
+    }
+    return result;
+    #else
+    int result = recvfrom(socketId, (char *)buffer, (int)capacity, 0, (struct sockaddr *)address, addressLength);
+    if (arrival != NULL) {
+        *arrival = timestamp_now();
+    }
+    return result;
+    #endif
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#ifndef DATAGRAM_H
+#define DATAGRAM_H
+
+
+#include "common.h"
+#include "state.h"
+#include "timestamp.h"
+
+
+#ifdef __linux__
+    #include <netinet/udp.h>
+    #ifndef SOL_UDP
+        #define SOL_UDP 17
+    #endif
+    #ifndef UDP_SEGMENT
+        #define UDP_SEGMENT 103
+    #endif
+    #ifndef UDP_GRO
+        #define UDP_GRO 104
+    #endif
+    #define DATAGRAM_OFFLOAD 1
+#endif
+
+
+// Largest UDP payload and the most segments the kernel takes in one send
+#define DATAGRAM_MAX 65507
+#define DATAGRAM_SEGMENTS_MAX 64
+#define DATAGRAM_GRO_BUFFER 65536
+
+
+int datagram_recv(SOCKET socketId, BYTE *buffer, size_t capacity,
+    struct sockaddr_storage *address, socklen_t *addressLength, mint *segmentSize, mint *arrival);
+
+
+#endif
\ No newline at end of file
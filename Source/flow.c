@@ -0,0 +1,111 @@
+#include "flow.h"
+
+
+static void flow_update(SocketState state, mint events, mint bytes)
+{
+    state->outstandingEvents += events;
+    state->outstandingBytes += bytes;
+    memory_update(state, bytes);
+    if (state->owner != NULL) {
+        state->owner->outstandingEvents += events;
+        state->owner->outstandingBytes += bytes;
+    }
+}
+
+
+// Called from Wolfram Language once an event of the socket was handled
+DLLEXPORT int socketEventAck(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint bytes = MArgument_getInteger(Args[1]);
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    SocketList owner = state != NULL ? state->owner : NULL;
+    if (state != NULL) {
+        // events raised before flow control was enabled were never counted
+        mint events = state->outstandingEvents > 0 ? 1 : 0;
+        bytes = bytes < state->outstandingBytes ? bytes : state->outstandingBytes;
+        flow_update(state, -events, -bytes);
+    }
+    bool wake = owner != NULL && (owner->pausedCount > 0 || state->memoryLimited);
+    mutex_unlock(&globalMutex);
+
+    if (wake) {
+        socket_list_interrupt(owner);
+    }
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketFlowStats(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+
+    MTensor stats;
+    mint length = 5;
+    libData->MTensor_new(MType_Integer, 1, &length, &stats);
+    mint *statsData = libData->MTensor_getIntegerData(stats);
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    statsData[0] = state != NULL ? state->outstandingEvents : 0;
+    statsData[1] = state != NULL ? state->outstandingBytes : 0;
+    statsData[2] = state != NULL && state->paused;
+    statsData[3] = state != NULL && state->owner != NULL ? state->owner->outstandingEvents : 0;
+    statsData[4] = state != NULL && state->owner != NULL ? state->owner->outstandingBytes : 0;
+    mutex_unlock(&globalMutex);
+
+    MArgument_setMTensor(Res, stats);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Counts events raised for a socket and not yet acknowledged, per socket
+// and per owning loop. They are only counted while a watermark or a memory
+// limit needs them, a loop whose events nobody acknowledges never pays.
+void flow_account(SocketList socketList, SocketState state, mint events, mint bytes)
+{
+    if (state == NULL || (socketList->highWatermark == 0 && socketList->loopHighWatermark == 0 && !memory_limited())) {
+        return;
+    }
+
+    mutex_lock(&globalMutex);
+    flow_update(state, events, bytes);
+    mutex_unlock(&globalMutex);
+}
+
+
+// Decides whether the loop should stop reading the socket: above the high
+// watermark of the connection or of the loop it pauses, and it resumes only
+// once both are back under their low watermarks
+bool flow_paused(SocketList socketList, SocketState state)
+{
+    if (state == NULL || (socketList->highWatermark == 0 && socketList->loopHighWatermark == 0)) {
+        return false;
+    }
+
+    mint highWatermark = socketList->highWatermark;
+    mint lowWatermark = socketList->lowWatermark > 0 ? socketList->lowWatermark : highWatermark / 2;
+    mint loopHighWatermark = socketList->loopHighWatermark;
+    mint loopLowWatermark = socketList->loopLowWatermark > 0 ? socketList->loopLowWatermark : loopHighWatermark / 2;
+
+    mutex_lock(&globalMutex);
+    bool paused = state->paused;
+    if (!paused) {
+        paused = (highWatermark > 0 && state->outstandingBytes >= highWatermark) ||
+            (loopHighWatermark > 0 && socketList->outstandingBytes >= loopHighWatermark);
+    } else {
+        paused = (highWatermark > 0 && state->outstandingBytes > lowWatermark) ||
+            (loopHighWatermark > 0 && socketList->outstandingBytes > loopLowWatermark);
+    }
+
+    if (paused != state->paused) {
+        state->paused = paused;
+        socketList->pausedCount += paused ? 1 : -1;
+    }
+    mutex_unlock(&globalMutex);
+
+    return paused;
+}
\ No newline at end of file
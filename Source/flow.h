@@ -0,0 +1,17 @@
+#ifndef FLOW_H
+#define FLOW_H
+
+
+#include "common.h"
+#include "state.h"
+#include "list.h"
+#include "memory.h"
+
+
+void flow_account(SocketList socketList, SocketState state, mint events, mint bytes);
+
+
+bool flow_paused(SocketList socketList, SocketState state);
+
+
+#endif
\ No newline at end of file
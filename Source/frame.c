@@ -0,0 +1,251 @@
+#include "frame.h"
+
+
+DLLEXPORT int socketFramesEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mbool enable = MArgument_getBoolean(Args[1]);
+
+    if (!ISVALIDSOCKET(socketId)) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    state->framed = enable;
+    socket_state_release(state);
+    return LIBRARY_NO_ERROR;
+}
+
+
+static bool frame_host_big_endian()
+{
+    const uint16_t one = 1;
+    return *(const BYTE *)&one == 0;
+}
+
+
+// Element size, or the component size for complex types, 0 when unknown
+static size_t frame_element_size(numericarray_data_t type, size_t *swapSize)
+{
+    size_t size;
+    switch (type)
+    {
+    case MNumericArray_Type_Bit8:
+    case MNumericArray_Type_UBit8:
+        size = 1;
+        break;
+    case MNumericArray_Type_Bit16:
+    case MNumericArray_Type_UBit16:
+        size = 2;
+        break;
+    case MNumericArray_Type_Bit32:
+    case MNumericArray_Type_UBit32:
+    case MNumericArray_Type_Real32:
+        size = 4;
+        break;
+    case MNumericArray_Type_Bit64:
+    case MNumericArray_Type_UBit64:
+    case MNumericArray_Type_Real64:
+    case MNumericArray_Type_Complex_Real32:
+        size = 8;
+        break;
+    case MNumericArray_Type_Complex_Real64:
+        size = 16;
+        break;
+    default:
+        return 0;
+    }
+
+    *swapSize = type == MNumericArray_Type_Complex_Real32 || type == MNumericArray_Type_Complex_Real64 ? size / 2 : size;
+    return size;
+}
+
+
+static void frame_swap(BYTE *data, size_t length, size_t swapSize)
+{
+    for (size_t i = 0; i + swapSize <= length; i += swapSize) {
+        for (size_t j = 0; j < swapSize / 2; j++) {
+            BYTE byte = data[i + j];
+            data[i + j] = data[i + swapSize - 1 - j];
+            data[i + swapSize - 1 - j] = byte;
+        }
+    }
+}
+
+
+// Writes the header of a frame carrying the array in host byte order and
+// returns its length, the rank must already be checked
+size_t frame_header(WolframLibraryData libData, MNumericArray array, BYTE *header)
+{
+    numericarray_data_t type = libData->numericarrayLibraryFunctions->MNumericArray_getType(array);
+    mint rank = libData->numericarrayLibraryFunctions->MNumericArray_getRank(array);
+    const mint *dims = libData->numericarrayLibraryFunctions->MNumericArray_getDimensions(array);
+
+    header[0] = (BYTE)type;
+    header[1] = (BYTE)rank;
+    header[2] = frame_host_big_endian() ? FRAME_BIG_ENDIAN : 0;
+    header[3] = 0;
+    for (mint i = 0; i < rank; i++) {
+        uint64_t dim = (uint64_t)dims[i];
+        for (int j = 0; j < 8; j++) {
+            header[FRAME_PREFIX_SIZE + 8 * i + j] = (BYTE)(dim >> (8 * j));
+        }
+    }
+    return FRAME_PREFIX_SIZE + 8 * (size_t)rank;
+}
+
+
+// Sends a numeric array as one frame in host byte order, the header says
+// which so the receiver can swap
+DLLEXPORT int socketSendFrame(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    MNumericArray numericArray = MArgument_getMNumericArray(Args[1]); // NumericArray of any type
+
+    numericarray_data_t type = libData->numericarrayLibraryFunctions->MNumericArray_getType(numericArray);
+    mint rank = libData->numericarrayLibraryFunctions->MNumericArray_getRank(numericArray);
+    mint count = libData->numericarrayLibraryFunctions->MNumericArray_getFlattenedLength(numericArray);
+    BYTE *data = libData->numericarrayLibraryFunctions->MNumericArray_getData(numericArray);
+
+    size_t swapSize;
+    size_t elementSize = frame_element_size(type, &swapSize);
+    if (elementSize == 0 || rank < 1 || rank > FRAME_RANK_MAX) {
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(numericArray);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    BYTE header[FRAME_HEADER_MAX];
+    size_t headerLength = frame_header(libData, numericArray, header);
+    size_t length = elementSize * (size_t)count;
+
+    SocketState state = socket_state_get(socketId);
+    int sentLength = coalesce_enabled(state) ?
+        coalesce_append_header(state, header, headerLength, data, length) :
+        send_all_header(socketId, header, headerLength, data, length);
+
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(numericArray);
+
+    if (sentLength > 0) {
+        latency_response(state);
+    }
+    socket_state_release(state);
+
+    if (sentLength <= 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setInteger(Res, sentLength);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Parses a complete header and allocates the array the elements are read
+// into, charging it to the connection until the frame is handed over
+static FRAME_RESULT frame_start(WolframLibraryData libData, SocketState state, Frame frame)
+{
+    numericarray_data_t type = (numericarray_data_t)frame->header[0];
+    mint rank = frame->header[1];
+    mint dims[FRAME_RANK_MAX];
+    size_t elementSize = frame_element_size(type, &frame->swapSize);
+    size_t count = 1;
+
+    for (mint i = 0; i < rank; i++) {
+        uint64_t dim = 0;
+        for (int j = 0; j < 8; j++) {
+            dim |= (uint64_t)frame->header[FRAME_PREFIX_SIZE + 8 * i + j] << (8 * j);
+        }
+        if (dim > (uint64_t)INT32_MAX || (dim > 0 && count > SIZE_MAX / elementSize / dim)) {
+            return FRAME_INVALID;
+        }
+        dims[i] = (mint)dim;
+        count *= (size_t)dim;
+    }
+
+    frame->length = count * elementSize;
+    if (!memory_allowed(state, (mint)frame->length) ||
+        libData->numericarrayLibraryFunctions->MNumericArray_new(type, rank, dims, &frame->array) != LIBRARY_NO_ERROR) {
+        return FRAME_INVALID;
+    }
+
+    memory_charge(state, (mint)frame->length);
+    frame->data = libData->numericarrayLibraryFunctions->MNumericArray_getData(frame->array);
+    frame->filled = 0;
+    if ((frame->header[2] & FRAME_BIG_ENDIAN) == (frame_host_big_endian() ? FRAME_BIG_ENDIAN : 0)) {
+        frame->swapSize = 1;
+    }
+    return FRAME_PARTIAL;
+}
+
+
+// Reads the next part of a frame, returns FRAME_COMPLETE with the array and
+// its size in bytes, FRAME_PARTIAL when the socket would block first, and
+// FRAME_CLOSED, FRAME_ERROR or FRAME_INVALID when the connection is done
+FRAME_RESULT frame_recv(WolframLibraryData libData, SocketState state, SOCKET socketId, MNumericArray *array, mint *bytes)
+{
+    if (state->frame == NULL) {
+        state->frame = calloc(1, sizeof(struct Frame_st));
+        if (state->frame == NULL) {
+            return FRAME_INVALID;
+        }
+        state->frame->libData = libData;
+    }
+
+    Frame frame = state->frame;
+    int result;
+
+    while (frame->array == NULL) {
+        size_t needed = FRAME_PREFIX_SIZE;
+
+        if (frame->headerFilled >= FRAME_PREFIX_SIZE) {
+            size_t swapSize;
+            if (frame->header[1] < 1 || frame->header[1] > FRAME_RANK_MAX ||
+                frame_element_size((numericarray_data_t)frame->header[0], &swapSize) == 0) {
+                return FRAME_INVALID;
+            }
+
+            needed = FRAME_PREFIX_SIZE + 8 * (size_t)frame->header[1];
+            if (frame->headerFilled == needed) {
+                FRAME_RESULT started = frame_start(libData, state, frame);
+                if (started != FRAME_PARTIAL) {
+                    return started;
+                }
+                break;
+            }
+        }
+
+        result = recv_nonblocking(socketId, frame->header + frame->headerFilled, needed - frame->headerFilled);
+        if (result <= 0) {
+            return result == 0 ? FRAME_CLOSED : is_wouldblock_err(GETSOCKETERRNO()) ? FRAME_PARTIAL : FRAME_ERROR;
+        }
+        frame->headerFilled += (size_t)result;
+    }
+
+    while (frame->filled < frame->length) {
+        result = recv_nonblocking(socketId, frame->data + frame->filled, frame->length - frame->filled);
+        if (result <= 0) {
+            return result == 0 ? FRAME_CLOSED : is_wouldblock_err(GETSOCKETERRNO()) ? FRAME_PARTIAL : FRAME_ERROR;
+        }
+        frame->filled += (size_t)result;
+    }
+
+    if (frame->swapSize > 1) {
+        frame_swap(frame->data, frame->length, frame->swapSize);
+    }
+
+    memory_charge(state, -(mint)frame->length);
+    *array = frame->array;
+    *bytes = (mint)frame->length;
+
+    frame->array = NULL;
+    frame->headerFilled = 0;
+    return FRAME_COMPLETE;
+}
+
+
+void frame_free(Frame frame)
+{
+    if (frame->array != NULL) {
+        frame->libData->numericarrayLibraryFunctions->MNumericArray_free(frame->array);
+    }
+    free(frame);
+}
\ No newline at end of file
@@ -0,0 +1,53 @@
+#ifndef FRAME_H
+#define FRAME_H
+
+
+#include "common.h"
+#include "state.h"
+#include "coalesce.h"
+#include "memory.h"
+#include "pool.h"
+#include "latency.h"
+
+
+// Frame header: type (MNumericArray type code), rank, flags, reserved, then
+// rank dimensions as 64-bit little-endian integers, then the raw elements
+#define FRAME_PREFIX_SIZE 4
+#define FRAME_RANK_MAX 8
+#define FRAME_HEADER_MAX (FRAME_PREFIX_SIZE + 8 * FRAME_RANK_MAX)
+#define FRAME_BIG_ENDIAN 1
+
+
+typedef enum {
+    FRAME_INVALID = -2,
+    FRAME_ERROR = -1,
+    FRAME_CLOSED = 0,
+    FRAME_COMPLETE = 1,
+    FRAME_PARTIAL = 2
+} FRAME_RESULT;
+
+
+// A frame being received, the elements go straight into the array
+typedef struct Frame_st
+{
+    WolframLibraryData libData;
+    BYTE header[FRAME_HEADER_MAX];
+    size_t headerFilled;
+    MNumericArray array;
+    BYTE *data;
+    size_t length;
+    size_t filled;
+    size_t swapSize;
+} *Frame;
+
+
+size_t frame_header(WolframLibraryData libData, MNumericArray array, BYTE *header);
+
+
+FRAME_RESULT frame_recv(WolframLibraryData libData, SocketState state, SOCKET socketId, MNumericArray *array, mint *bytes);
+
+
+void frame_free(Frame frame);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "handoff.h"
+
+
+DLLEXPORT int socketUnixBind(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    char *path = MArgument_getUTF8String(Args[1]);
+
+    #ifdef _WIN32
+    libData->UTF8String_disown(path);
+    return LIBRARY_FUNCTION_ERROR;
+    #else
+    struct sockaddr_un address;
+    ZeroMemory(&address, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    libData->UTF8String_disown(path);
+
+    unlink(address.sun_path);
+
+    if (bind(socketId, (struct sockaddr *)&address, sizeof(address)) == SOCKET_ERROR) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    return LIBRARY_NO_ERROR;
+    #endif
+}
+
+
+DLLEXPORT int socketUnixConnect(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    char *path = MArgument_getUTF8String(Args[1]);
+
+    #ifdef _WIN32
+    libData->UTF8String_disown(path);
+    return LIBRARY_FUNCTION_ERROR;
+    #else
+    struct sockaddr_un address;
+    ZeroMemory(&address, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+    libData->UTF8String_disown(path);
+
+    if (connect(socketId, (struct sockaddr *)&address, sizeof(address)) == SOCKET_ERROR) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    return LIBRARY_NO_ERROR;
+    #endif
+}
+
+
+DLLEXPORT int socketSendDescriptor(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET channel = (SOCKET)MArgument_getInteger(Args[0]);  // unix socket connected to the other process
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[1]); // socket to hand off
+
+    if (!handoff_send(channel, socketId)) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketRecvDescriptor(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET channel = (SOCKET)MArgument_getInteger(Args[0]);
+
+    SOCKET sockets[HANDOFF_MAX_DESCRIPTORS];
+    int socketsLength = 0;
+    int releases = 0;
+
+    while (socketsLength == 0) {
+        if (handoff_recv(channel, sockets, &socketsLength, &releases) <= 0) {
+            return LIBRARY_FUNCTION_ERROR;
+        }
+    }
+
+    for (int i = 1; i < socketsLength; i++) {
+        CLOSESOCKET(sockets[i]);
+    }
+
+    SOCKET receivedSocketId = sockets[0];
+    SocketState state = socket_state_acquire(receivedSocketId);
+    state->handoffChannel = channel;
+    socket_state_release(state);
+
+    MArgument_setInteger(Res, receivedSocketId);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketDispatcherCreate(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    MTensor channels = MArgument_getMTensor(Args[0]); // unix sockets connected to the workers
+    mint length = MArgument_getInteger(Args[1]);      // number of workers
+    mint mode = MArgument_getInteger(Args[2]);        // 0 - round robin, 1 - least loaded
+
+    if (length <= 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    Dispatcher dispatcher = malloc(sizeof(struct Dispatcher_st));
+    dispatcher->channels = malloc(sizeof(SOCKET) * length);
+    dispatcher->loads = calloc(length, sizeof(mint));
+    dispatcher->length = length;
+    dispatcher->next = 0;
+    dispatcher->mode = mode == 1 ? DISPATCH_LEAST_LOADED : DISPATCH_ROUND_ROBIN;
+    dispatcher->attached = false;
+
+    copy_tensor_to_socket_array(libData, channels, dispatcher->channels, (size_t)length);
+
+    mint dispatcherPtr = (mint)(uintptr_t)dispatcher;
+    MArgument_setInteger(Res, dispatcherPtr);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketDispatcherAttach(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);                      // listening socket
+    Dispatcher dispatcher = (Dispatcher)(uintptr_t)MArgument_getInteger(Args[1]); // dispatcher pointer
+
+    SocketState state = socket_state_acquire(socketId);
+    state->dispatcher = dispatcher;
+
+    if (state->owner != NULL) {
+        socket_list_interrupt(state->owner);
+    }
+    socket_state_release(state);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketDispatcherLoads(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    Dispatcher dispatcher = (Dispatcher)(uintptr_t)MArgument_getInteger(Args[0]);
+
+    MTensor loads;
+    libData->MTensor_new(MType_Integer, 1, &dispatcher->length, &loads);
+    mint *loadsData = libData->MTensor_getIntegerData(loads);
+
+    for (mint i = 0; i < dispatcher->length; i++) {
+        loadsData[i] = dispatcher->loads[i];
+    }
+
+    MArgument_setMTensor(Res, loads);
+    return LIBRARY_NO_ERROR;
+}
+
+
+bool handoff_send(SOCKET channel, SOCKET socketId)
+{
+    #ifdef _WIN32
+    return false;
+    #else
+    char tag = HANDOFF_DESCRIPTOR;
+    struct iovec iov = { .iov_base = &tag, .iov_len = 1 };
+    union {
+        char buffer[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message;
+
+    ZeroMemory(&message, sizeof(message));
+    ZeroMemory(&control, sizeof(control));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &socketId, sizeof(int));
+
+    // a worker that stops reading fails the handoff instead of stalling the
+    // accepting loop, the next worker gets the socket
+    return sendmsg(channel, &message, MSG_NOSIGNAL | MSG_DONTWAIT) == 1;
+    #endif
+}
+
+
+// Reads descriptors and release notices from a handoff channel,
+// returns the number of bytes read, 0 when the channel is closed
+int handoff_recv(SOCKET channel, SOCKET *sockets, int *socketsLength, int *releases)
+{
+    *socketsLength = 0;
+    *releases = 0;
+
+    #ifdef _WIN32
+    return SOCKET_ERROR;
+    #else
+    char tags[HANDOFF_MAX_DESCRIPTORS];
+    struct iovec iov = { .iov_base = tags, .iov_len = sizeof(tags) };
+    union {
+        char buffer[CMSG_SPACE(sizeof(int) * HANDOFF_MAX_DESCRIPTORS)];
+        struct cmsghdr align;
+    } control;
+    struct msghdr message;
+
+    ZeroMemory(&message, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control.buffer;
+    message.msg_controllen = sizeof(control.buffer);
+
+    int result = (int)recvmsg(channel, &message, MSG_CMSG_CLOEXEC);
+    if (result <= 0) {
+        return result;
+    }
+
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+            int count = (int)((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+            for (int i = 0; i < count && *socketsLength < HANDOFF_MAX_DESCRIPTORS; i++) {
+                int descriptor;
+                memcpy(&descriptor, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+                sockets[(*socketsLength)++] = descriptor;
+            }
+        }
+    }
+
+    for (int i = 0; i < result; i++) {
+        if (tags[i] == HANDOFF_RELEASE) {
+            (*releases)++;
+        }
+    }
+
+    return result;
+    #endif
+}
+
+
+// Tells the dispatching process that a handed off connection is closed,
+// a notice that does not fit into a full channel is dropped and the
+// dispatcher counts the connection a little longer
+void handoff_release(SOCKET channel)
+{
+    char tag = HANDOFF_RELEASE;
+    #ifdef _WIN32
+    send(channel, &tag, 1, 0);
+    #else
+    send(channel, &tag, 1, MSG_NOSIGNAL | MSG_DONTWAIT);
+    #endif
+}
+
+
+// Adds the worker channels to the list so that release notices are read,
+// must be called from the thread that runs the poll loop over the list
+bool dispatcher_attach(SocketList socketList, Dispatcher dispatcher)
+{
+    if (dispatcher->attached) {
+        return false;
+    }
+
+    for (mint i = 0; i < dispatcher->length; i++) {
+        SOCKET channel = dispatcher->channels[i];
+        if (socket_list_find(socketList, channel) < 0) {
+            socket_list_add(socketList, channel, HANDOFF_CHANNEL);
+        }
+        SocketState state = socket_state_acquire(channel);
+        state->dispatcher = dispatcher;
+        socket_state_release(state);
+    }
+
+    dispatcher->attached = true;
+    return true;
+}
+
+
+// Picks a worker and passes the accepted socket to it, the next worker
+// is tried when a channel fails, returns false if nobody took the socket
+bool dispatcher_handoff(Dispatcher dispatcher, SOCKET socketId)
+{
+    mint start = dispatcher->next;
+
+    if (dispatcher->mode == DISPATCH_LEAST_LOADED) {
+        for (mint i = 1; i < dispatcher->length; i++) {
+            mint j = (dispatcher->next + i) % dispatcher->length;
+            if (dispatcher->loads[j] < dispatcher->loads[start]) {
+                start = j;
+            }
+        }
+    }
+
+    for (mint i = 0; i < dispatcher->length; i++) {
+        mint j = (start + i) % dispatcher->length;
+        if (handoff_send(dispatcher->channels[j], socketId)) {
+            dispatcher->loads[j]++;
+            dispatcher->next = (j + 1) % dispatcher->length;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void dispatcher_release(Dispatcher dispatcher, SOCKET channel, int releases)
+{
+    for (mint i = 0; i < dispatcher->length; i++) {
+        if (dispatcher->channels[i] == channel) {
+            dispatcher->loads[i] -= releases;
+            if (dispatcher->loads[i] < 0) {
+                dispatcher->loads[i] = 0;
+            }
+            return;
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#ifndef HANDOFF_H
+#define HANDOFF_H
+
+
+#include "common.h"
+#include "list.h"
+#include "state.h"
+
+
+#define HANDOFF_DESCRIPTOR 'D'
+#define HANDOFF_RELEASE 'R'
+#define HANDOFF_MAX_DESCRIPTORS 64
+
+
+typedef enum {
+    DISPATCH_ROUND_ROBIN,
+    DISPATCH_LEAST_LOADED
+} DISPATCH_MODE;
+
+
+typedef struct Dispatcher_st
+{
+    SOCKET *channels;
+    mint *loads;
+    mint length;
+    mint next;
+    DISPATCH_MODE mode;
+    bool attached;
+} *Dispatcher;
+
+
+bool handoff_send(SOCKET channel, SOCKET socketId);
+
+
+int handoff_recv(SOCKET channel, SOCKET *sockets, int *socketsLength, int *releases);
+
+
+void handoff_release(SOCKET channel);
+
+
+bool dispatcher_attach(SocketList socketList, Dispatcher dispatcher);
+
+
+bool dispatcher_handoff(Dispatcher dispatcher, SOCKET socketId);
+
+
+void dispatcher_release(Dispatcher dispatcher, SOCKET channel, int releases);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,199 @@
+#include "impair.h"
+
+
+static double impair_random(Impair impair)
+{
+    impair->seed ^= impair->seed << 13;
+    impair->seed ^= impair->seed >> 7;
+    impair->seed ^= impair->seed << 17;
+    return (double)(impair->seed >> 11) / (double)(1ULL << 53);
+}
+
+
+static Impair impair_create(SOCKET socketId)
+{
+    Impair impair = calloc(1, sizeof(struct Impair_st));
+    if (impair != NULL) {
+        mutex_init(&impair->mutex);
+        impair->seed = ((uint64_t)socketId << 32) ^ (uint64_t)get_monotonic_time() ^ 0x9E3779B97F4A7C15ULL;
+    }
+    return impair;
+}
+
+
+static void impair_configure(Impair impair, mint delay, mint jitter, mint bandwidth, mint segment, double drop, double reorder)
+{
+    mutex_lock(&impair->mutex);
+    impair->delay = delay;
+    impair->jitter = jitter;
+    impair->bandwidth = bandwidth;
+    impair->segment = segment;
+    impair->drop = drop;
+    impair->reorder = reorder;
+    mutex_unlock(&impair->mutex);
+}
+
+
+// Whether writes of the socket go through its queue to be released later
+bool impair_shaped(SocketState state)
+{
+    Impair impair = state != NULL ? state->impair : NULL;
+    return impair != NULL && (impair->delay > 0 || impair->jitter > 0 || impair->bandwidth > 0 || impair->segment > 0);
+}
+
+
+size_t impair_segment(SocketState state)
+{
+    return state != NULL && state->impair != NULL ? (size_t)state->impair->segment : 0;
+}
+
+
+// When length more bytes written now reach the peer, in monotonic ns. The
+// bytes wait for the link to finish the previous write, take their
+// serialization time and then the delay, never overtaking earlier bytes
+mint impair_due(SocketState state, size_t length)
+{
+    Impair impair = state != NULL ? state->impair : NULL;
+    if (impair == NULL) {
+        return 0;
+    }
+
+    mutex_lock(&impair->mutex);
+    mint now = get_monotonic_time();
+    mint departure = impair->linkFree > now ? impair->linkFree : now;
+    if (impair->bandwidth > 0) {
+        departure += (mint)((double)length * 1e9 / (double)impair->bandwidth);
+    }
+    impair->linkFree = departure;
+
+    mint delay = impair->delay;
+    if (impair->jitter > 0) {
+        delay += (mint)((2.0 * impair_random(impair) - 1.0) * (double)impair->jitter);
+    }
+    mint due = departure + (delay > 0 ? delay * 1000 : 0);
+    if (due < impair->lastDue) {
+        due = impair->lastDue;
+    }
+    impair->lastDue = due;
+    mutex_unlock(&impair->mutex);
+
+    return due;
+}
+
+
+void impair_wait(mint due)
+{
+    mint now;
+    while ((now = get_monotonic_time()) < due) {
+        mint wait = (due - now) / 1000;
+        #ifdef _WIN32
+        SLEEP((DWORD)(wait / 1000 > 0 ? wait / 1000 : 1));
+        #else
+        SLEEP((useconds_t)(wait > 0 ? wait : 1));
+        #endif
+    }
+}
+
+
+// Sends a datagram, or drops it, or holds it back to go out after the
+// next one. Dropped and held datagrams count as sent
+int impair_sendto(SocketState state, SOCKET socketId, const BYTE *data, size_t length,
+    const struct sockaddr *address, socklen_t addressLength)
+{
+    Impair impair = state != NULL ? state->impair : NULL;
+    if (impair == NULL || (impair->drop <= 0 && impair->reorder <= 0 && impair->held == NULL)) {
+        return (int)sendto(socketId, (const char *)data, length, 0, address, addressLength);
+    }
+
+    mutex_lock(&impair->mutex);
+    if (impair->drop > 0 && impair_random(impair) < impair->drop) {
+        mutex_unlock(&impair->mutex);
+        return (int)length;
+    }
+
+    if (impair->held == NULL && impair->reorder > 0 && impair_random(impair) < impair->reorder) {
+        impair->held = malloc(length > 0 ? length : 1);
+        if (impair->held != NULL) {
+            memcpy(impair->held, data, length);
+            impair->heldLength = length;
+            memcpy(&impair->heldAddress, address, addressLength);
+            impair->heldAddressLength = addressLength;
+            mutex_unlock(&impair->mutex);
+            return (int)length;
+        }
+    }
+
+    int result = (int)sendto(socketId, (const char *)data, length, 0, address, addressLength);
+    if (impair->held != NULL) {
+        sendto(socketId, (const char *)impair->held, impair->heldLength, 0,
+            (const struct sockaddr *)&impair->heldAddress, impair->heldAddressLength);
+        free(impair->held);
+        impair->held = NULL;
+    }
+    mutex_unlock(&impair->mutex);
+
+    return result;
+}
+
+
+// Accepted connections get the listener's settings with a fresh link
+void impair_inherit(SocketState state, SocketState parent)
+{
+    Impair source = parent != NULL ? parent->impair : NULL;
+    if (source == NULL) {
+        return;
+    }
+
+    if (state->impair == NULL) {
+        state->impair = impair_create(state->socketId);
+    }
+    if (state->impair != NULL) {
+        impair_configure(state->impair, source->delay, source->jitter, source->bandwidth, source->segment,
+            source->drop, source->reorder);
+    }
+}
+
+
+void impair_free(Impair impair)
+{
+    free(impair->held);
+    mutex_destroy(&impair->mutex);
+    free(impair);
+}
+
+
+// Delay and jitter in microseconds, bandwidth in bytes per second, segment
+// in bytes and drop and reorder as probabilities, zeros turn it all off
+DLLEXPORT int socketImpair(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint delay = MArgument_getInteger(Args[1]);
+    mint jitter = MArgument_getInteger(Args[2]);
+    mint bandwidth = MArgument_getInteger(Args[3]);
+    mint segment = MArgument_getInteger(Args[4]);
+    double drop = MArgument_getReal(Args[5]);
+    double reorder = MArgument_getReal(Args[6]);
+
+    if (!ISVALIDSOCKET(socketId) || delay < 0 || jitter < 0 || bandwidth < 0 || segment < 0 ||
+        drop < 0 || drop > 1 || reorder < 0 || reorder > 1) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    if (state->impair == NULL) {
+        mutex_lock(&globalMutex);
+        if (state->impair == NULL) {
+            state->impair = impair_create(socketId);
+        }
+        mutex_unlock(&globalMutex);
+
+        if (state->impair == NULL) {
+            socket_state_release(state);
+            return LIBRARY_FUNCTION_ERROR;
+        }
+    }
+
+    impair_configure(state->impair, delay, jitter, bandwidth, segment, drop, reorder);
+    socket_state_release(state);
+    return LIBRARY_NO_ERROR;
+}
\ No newline at end of file
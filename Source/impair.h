@@ -0,0 +1,54 @@
+#ifndef IMPAIR_H
+#define IMPAIR_H
+
+
+#include "common.h"
+#include "state.h"
+
+
+// Simulated link conditions of one socket. Delay, jitter and bandwidth
+// shape what the socket sends through its write queue, segment caps every
+// read and write, drop and reorder apply to sent datagrams
+typedef struct Impair_st
+{
+    Mutex mutex;
+    mint delay;
+    mint jitter;
+    mint bandwidth;
+    mint segment;
+    double drop;
+    double reorder;
+
+    uint64_t seed;
+    mint linkFree;
+    mint lastDue;
+    BYTE *held;
+    size_t heldLength;
+    struct sockaddr_storage heldAddress;
+    socklen_t heldAddressLength;
+} *Impair;
+
+
+bool impair_shaped(SocketState state);
+
+
+size_t impair_segment(SocketState state);
+
+
+mint impair_due(SocketState state, size_t length);
+
+
+void impair_wait(mint due);
+
+
+int impair_sendto(SocketState state, SOCKET socketId, const BYTE *data, size_t length,
+    const struct sockaddr *address, socklen_t addressLength);
+
+
+void impair_inherit(SocketState state, SocketState parent);
+
+
+void impair_free(Impair impair);
+
+
+#endif
\ No newline at end of file
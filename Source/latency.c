@@ -0,0 +1,211 @@
+#include "latency.h"
+
+
+static Latency latency_create()
+{
+    Latency latency = calloc(1, sizeof(struct Latency_st));
+    if (latency != NULL) {
+        mutex_init(&latency->mutex);
+        latency->refs = 1;
+    }
+    return latency;
+}
+
+
+static Latency latency_retain(Latency latency)
+{
+    atomic_add(&latency->refs, 1);
+    return latency;
+}
+
+
+static void latency_release(Latency latency)
+{
+    if (atomic_add(&latency->refs, -1) == 0) {
+        mutex_destroy(&latency->mutex);
+        free(latency);
+    }
+}
+
+
+static int latency_bucket(mint value)
+{
+    if (value < LATENCY_SUB_BUCKETS) {
+        return value > 0 ? (int)value : 0;
+    }
+
+    int top = 0;
+    for (mint rest = value; rest > 1; rest >>= 1) {
+        top++;
+    }
+    int shift = top - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB_BUCKETS + (int)((value >> shift) & (LATENCY_SUB_BUCKETS - 1));
+}
+
+
+// Largest value that falls in the bucket
+static mint latency_bucket_value(int bucket)
+{
+    if (bucket < LATENCY_SUB_BUCKETS) {
+        return bucket;
+    }
+
+    int shift = bucket / LATENCY_SUB_BUCKETS - 1;
+    mint sub = bucket % LATENCY_SUB_BUCKETS;
+    return ((LATENCY_SUB_BUCKETS + sub) << shift) + ((mint)1 << shift) - 1;
+}
+
+
+static mint latency_percentile(Latency latency, double fraction)
+{
+    mint rank = (mint)((double)latency->count * fraction + 0.5);
+    rank = rank < 1 ? 1 : rank;
+
+    mint seen = 0;
+    for (int i = 0; i < LATENCY_BUCKETS; i++) {
+        seen += latency->buckets[i];
+        if (seen >= rank) {
+            mint value = latency_bucket_value(i);
+            return value < latency->max ? value : latency->max;
+        }
+    }
+    return latency->max;
+}
+
+
+// A message was handed to the kernel, the first one of a request starts
+// its clock
+void latency_request(SocketState state)
+{
+    if (state == NULL || state->latency == NULL || atomic_get(&state->requestStart) != 0) {
+        return;
+    }
+
+    atomic_set(&state->requestStart, get_monotonic_time());
+    atomic_add(&state->latency->inFlight, 1);
+}
+
+
+// The first send after a request answers it
+void latency_response(SocketState state)
+{
+    if (state == NULL || state->latency == NULL) {
+        return;
+    }
+
+    mint start = atomic_swap(&state->requestStart, 0);
+    if (start == 0) {
+        return;
+    }
+
+    Latency latency = state->latency;
+    mint sample = get_monotonic_time() - start;
+    atomic_add(&latency->inFlight, -1);
+
+    mutex_lock(&latency->mutex);
+    latency->buckets[latency_bucket(sample)]++;
+    latency->count++;
+    latency->sum += sample;
+    if (sample > latency->max) {
+        latency->max = sample;
+    }
+    mutex_unlock(&latency->mutex);
+}
+
+
+void latency_inherit(SocketState state, SocketState listenerState)
+{
+    if (listenerState != NULL && listenerState->latency != NULL) {
+        state->latency = latency_retain(listenerState->latency);
+        state->requestStart = 0;
+    }
+}
+
+
+// Called when the state goes away, an unanswered request stops counting
+void latency_detach(SocketState state)
+{
+    if (state->latency == NULL) {
+        return;
+    }
+
+    if (atomic_swap(&state->requestStart, 0) != 0) {
+        atomic_add(&state->latency->inFlight, -1);
+    }
+    latency_release(state->latency);
+    state->latency = NULL;
+}
+
+
+DLLEXPORT int socketLatencyEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mbool enable = MArgument_getBoolean(Args[1]);
+
+    if (!ISVALIDSOCKET(socketId)) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    mutex_lock(&globalMutex);
+    Latency latency = state->latency;
+    if (enable && latency == NULL) {
+        state->latency = latency_create();
+    } else if (!enable) {
+        state->latency = NULL;
+    }
+    mutex_unlock(&globalMutex);
+    socket_state_release(state);
+
+    // connections accepted before keep their own reference
+    if (!enable && latency != NULL) {
+        latency_release(latency);
+    }
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Returns {count, inFlight, mean, p50, p90, p99, p999, max} in nanoseconds
+// for the connections of a listener and optionally starts over
+DLLEXPORT int socketLatencyStats(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mbool reset = MArgument_getBoolean(Args[1]);
+
+    MTensor stats;
+    mint dims = 8;
+    libData->MTensor_new(MType_Integer, 1, &dims, &stats);
+    mint *statsData = libData->MTensor_getIntegerData(stats);
+    memset(statsData, 0, sizeof(mint) * dims);
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    Latency latency = state != NULL && state->latency != NULL ? latency_retain(state->latency) : NULL;
+    mutex_unlock(&globalMutex);
+
+    if (latency != NULL) {
+        mutex_lock(&latency->mutex);
+        statsData[0] = latency->count;
+        statsData[1] = atomic_get(&latency->inFlight);
+        if (latency->count > 0) {
+            statsData[2] = latency->sum / latency->count;
+            statsData[3] = latency_percentile(latency, 0.5);
+            statsData[4] = latency_percentile(latency, 0.9);
+            statsData[5] = latency_percentile(latency, 0.99);
+            statsData[6] = latency_percentile(latency, 0.999);
+            statsData[7] = latency->max;
+        }
+        if (reset) {
+            memset(latency->buckets, 0, sizeof(latency->buckets));
+            latency->count = 0;
+            latency->sum = 0;
+            latency->max = 0;
+        }
+        mutex_unlock(&latency->mutex);
+        latency_release(latency);
+    }
+
+    MArgument_setMTensor(Res, stats);
+    return LIBRARY_NO_ERROR;
+}
\ No newline at end of file
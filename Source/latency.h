@@ -0,0 +1,42 @@
+#ifndef LATENCY_H
+#define LATENCY_H
+
+
+#include "common.h"
+#include "state.h"
+
+
+// Log-linear buckets, 16 per power of two, so any sample is off by at most
+// 1/16 of its value
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS (64 * LATENCY_SUB_BUCKETS)
+
+
+// Time from a message becoming deliverable to the next send on the same
+// connection, kept per listener and shared by its connections
+typedef struct Latency_st
+{
+    Mutex mutex;
+    mint refs;
+    mint inFlight;
+    mint count;
+    mint sum;
+    mint max;
+    mint buckets[LATENCY_BUCKETS];
+} *Latency;
+
+
+void latency_request(SocketState state);
+
+
+void latency_response(SocketState state);
+
+
+void latency_inherit(SocketState state, SocketState listenerState);
+
+
+void latency_detach(SocketState state);
+
+
+#endif
\ No newline at end of file
@@ -1,4 +1,8 @@
 #include "list.h"
+#include "plugin.h"
+#include "queue.h"
+#include "recorder.h"
+#include "timestamp.h"
 
 
 DLLEXPORT int socketListCreate(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
@@ -29,6 +33,66 @@ DLLEXPORT int socketListAdd(WolframLibraryData libData, mint Argc, MArgument *Ar
 }
 
 
+DLLEXPORT int socketListSetOption(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SocketList socketList = (SocketList)MArgument_getInteger(Args[0]);
+    LIST_OPTION option = (LIST_OPTION)MArgument_getInteger(Args[1]);
+    mint value = MArgument_getInteger(Args[2]);
+
+    if (value < 0 || (value == 0 && option < LIST_OPTION_HIGH_WATERMARK)) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    switch (option)
+    {
+    case LIST_OPTION_RECV_LIMIT:
+        socketList->recvLimit = value;
+        break;
+    case LIST_OPTION_DRAIN_BUDGET:
+        socketList->drainBudget = value;
+        break;
+    case LIST_OPTION_LISTENER_BUDGET:
+        socketList->listenerBudget = value;
+        break;
+    case LIST_OPTION_CLIENT_BUDGET:
+        socketList->clientBudget = value;
+        break;
+    case LIST_OPTION_HIGH_WATERMARK:
+        socketList->highWatermark = value;
+        break;
+    case LIST_OPTION_LOW_WATERMARK:
+        socketList->lowWatermark = value;
+        break;
+    case LIST_OPTION_LOOP_HIGH_WATERMARK:
+        socketList->loopHighWatermark = value;
+        break;
+    case LIST_OPTION_LOOP_LOW_WATERMARK:
+        socketList->loopLowWatermark = value;
+        break;
+    case LIST_OPTION_EVENT_QUEUE:
+        // the queue is kept once created, so events left in it stay drainable
+        if (socketList->eventQueue == NULL && value > 0) {
+            socketList->eventQueue = event_queue_create(value > EVENT_QUEUE_ARENA_MIN ? value : EVENT_QUEUE_ARENA_MIN);
+        } else if (socketList->eventQueue != NULL) {
+            atomic_set(&socketList->eventQueue->enabled, value > 0);
+        }
+        break;
+    case LIST_OPTION_TIMESTAMPS:
+        for (mint i = 0; i < socketList->length; i++) {
+            if (socketList->sockettypes[i] != INTERUPTER && ISVALIDSOCKET(socketList->pollfds[i].fd)) {
+                timestamp_enable(socketList->pollfds[i].fd, value > 0);
+            }
+        }
+        socketList->timestamps = value > 0;
+        break;
+    default:
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    return LIBRARY_NO_ERROR;
+}
+
+
 DLLEXPORT int socketListGetAll(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
 {
     SocketList socketList = (SocketList)MArgument_getInteger(Args[0]);
@@ -76,19 +140,45 @@ SocketList socket_list_create(mint *sockets, mint *types, size_t length)
     }
 
     POLL_FD *pollfds = malloc(sizeof(POLL_FD) * capacity);
+    SocketState *states = malloc(sizeof(SocketState) * capacity);
     struct addrinfo **addrinfos = malloc(sizeof(struct addrinfo*) * capacity);
     SOCKET_TYPE *sockettypes = malloc(sizeof(SOCKET_TYPE) * capacity);
 
+    SocketList socketList = malloc(sizeof(struct SocketList_st));
+
     for (size_t i = 0; i < length; i++) {
         pollfds[i].fd = (SOCKET)sockets[i];
         sockettypes[i] = (SOCKET_TYPE)types[i];
         addrinfos[i] = NULL;
+        states[i] = socket_state_acquire((SOCKET)sockets[i]);
+        states[i]->owner = socketList;
+
+        if (sockettypes[i] == TCP_SERVER) {
+            set_non_blocking_mode((SOCKET)sockets[i]);
+        }
     }
 
-    SocketList socketList = malloc(sizeof(struct SocketList_st));
     socketList->pollfds = pollfds;
+    socketList->states = states;
     socketList->addrinfos = addrinfos;
     socketList->sockettypes = sockettypes;
+    socketList->interrupter[0] = INVALID_SOCKET;
+    socketList->interrupter[1] = INVALID_SOCKET;
+    socketList->recvLimit = RECV_LIMIT_DEFAULT;
+    socketList->drainBudget = DRAIN_BUDGET_DEFAULT;
+    socketList->listenerBudget = LISTENER_BUDGET_DEFAULT;
+    socketList->clientBudget = CLIENT_BUDGET_DEFAULT;
+    socketList->cursor = 0;
+    socketList->highWatermark = 0;
+    socketList->lowWatermark = 0;
+    socketList->loopHighWatermark = 0;
+    socketList->loopLowWatermark = 0;
+    socketList->outstandingEvents = 0;
+    socketList->outstandingBytes = 0;
+    socketList->pausedCount = 0;
+    socketList->eventQueue = NULL;
+    socketList->recorder = NULL;
+    socketList->timestamps = false;
     socketList->length = length;
     socketList->capacity = capacity;
 
@@ -96,19 +186,74 @@ SocketList socket_list_create(mint *sockets, mint *types, size_t length)
 }
 
 
-void socket_list_add(SocketList socketList, SOCKET socketId, SOCKET_TYPE socketType)
+// The list keeps a reference to the state of every socket it holds until
+// the entry is pruned, returns that state, NULL for the interrupter
+SocketState socket_list_add(SocketList socketList, SOCKET socketId, SOCKET_TYPE socketType)
 {
     if (socketList->length == socketList->capacity) {
         socketList->capacity *= 2;
         socketList->pollfds = realloc(socketList->pollfds, sizeof(POLL_FD) * socketList->capacity);
+        socketList->states = realloc(socketList->states, sizeof(SocketState) * socketList->capacity);
         socketList->addrinfos = realloc(socketList->addrinfos, sizeof(struct addrinfo*) * socketList->capacity);
         socketList->sockettypes = realloc(socketList->sockettypes, sizeof(SOCKET_TYPE) * socketList->capacity);
     }
 
+    SocketState state = NULL;
+    if (socketType != INTERUPTER) {
+        state = socket_state_acquire(socketId);
+        state->owner = socketList;
+    }
+
     socketList->pollfds[socketList->length].fd = socketId;
+    socketList->states[socketList->length] = state;
     socketList->addrinfos[socketList->length] = NULL;
     socketList->sockettypes[socketList->length] = socketType;
     socketList->length++;
+
+    if (socketType != INTERUPTER && socketList->timestamps) {
+        timestamp_enable(socketId, true);
+    }
+
+    if (socketType == TCP_SERVER) {
+        set_non_blocking_mode(socketId);
+    }
+
+    return state;
+}
+
+
+mint socket_list_find(SocketList socketList, SOCKET socketId)
+{
+    for (mint i = 0; i < socketList->length; i++) {
+        if (socketList->pollfds[i].fd == socketId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+void socket_list_drop(SocketList socketList, mint index)
+{
+    if (index < 0) {
+        return;
+    }
+
+    SOCKET socketId = socketList->pollfds[index].fd;
+    socketList->pollfds[index].fd = INVALID_SOCKET;
+
+    // the list's reference keeps the state alive until the entry is pruned,
+    // the loop may still use it for the rest of the iteration
+    SocketState state = socketList->states[index];
+    if (state != NULL && state->plugin != NULL && socketList->sockettypes[index] == TCP_CLIENT) {
+        plugin_close(state->plugin, socketId, state->listener);
+    }
+    recorder_write(socketList->recorder, RECORD_CLOSE, socketId, socketList->sockettypes[index],
+        state != NULL ? state->listener : INVALID_SOCKET, NULL, 0);
+
+    if (state != NULL) {
+        socket_state_detach(state);
+    }
 }
 
 
@@ -116,9 +261,12 @@ void socket_list_prune(SocketList socketList)
 {
     mint j = 0;
     for (mint i = 0; i < socketList->length; i++) {
-        if (socketList->pollfds[i].fd != INVALID_SOCKET) {
+        if (socketList->pollfds[i].fd == INVALID_SOCKET) {
+            socket_state_release(socketList->states[i]);
+        } else {
             if (i != j) {
                 socketList->pollfds[j] = socketList->pollfds[i];
+                socketList->states[j] = socketList->states[i];
                 socketList->addrinfos[j] = socketList->addrinfos[i];
                 socketList->sockettypes[j] = socketList->sockettypes[i];
             }
@@ -129,10 +277,100 @@ void socket_list_prune(SocketList socketList)
 }
 
 
+// Self-pipe registered in the list as INTERUPTER so that other threads
+// can wake the poll loop before its timeout expires
+void socket_list_interrupter_create(SocketList socketList)
+{
+    if (ISVALIDSOCKET(socketList->interrupter[0])) {
+        return;
+    }
+
+    #ifdef _WIN32
+    SOCKET interrupter = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    struct sockaddr_in address;
+    int addressLength = sizeof(address);
+
+    ZeroMemory(&address, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = 0;
+
+    bind(interrupter, (struct sockaddr *)&address, addressLength);
+    getsockname(interrupter, (struct sockaddr *)&address, &addressLength);
+    connect(interrupter, (struct sockaddr *)&address, addressLength);
+
+    socketList->interrupter[0] = interrupter;
+    socketList->interrupter[1] = interrupter;
+    #else
+    int pipefds[2];
+    if (pipe(pipefds) != 0) {
+        return;
+    }
+
+    socketList->interrupter[0] = pipefds[0];
+    socketList->interrupter[1] = pipefds[1];
+    set_non_blocking_mode(pipefds[1]);
+    #endif
+
+    set_non_blocking_mode(socketList->interrupter[0]);
+    socket_list_add(socketList, socketList->interrupter[0], INTERUPTER);
+}
+
+
+void socket_list_interrupt(SocketList socketList)
+{
+    char signal = 1;
+
+    if (!ISVALIDSOCKET(socketList->interrupter[1])) {
+        return;
+    }
+
+    #ifdef _WIN32
+    send(socketList->interrupter[1], &signal, 1, 0);
+    #else
+    write(socketList->interrupter[1], &signal, 1);
+    #endif
+}
+
+
+void socket_list_interrupter_drain(SocketList socketList)
+{
+    char signals[64];
+
+    #ifdef _WIN32
+    while (recv(socketList->interrupter[0], signals, sizeof(signals), 0) > 0);
+    #else
+    while (read(socketList->interrupter[0], signals, sizeof(signals)) > 0);
+    #endif
+}
+
+
 void socket_list_free(SocketList socketList)
 {
+    for (mint i = 0; i < socketList->length; i++) {
+        SocketState state = socketList->states[i];
+        if (state != NULL) {
+            mutex_lock(&globalMutex);
+            if (state->owner == socketList) {
+                state->owner = NULL;
+            }
+            mutex_unlock(&globalMutex);
+            socket_state_release(state);
+        }
+    }
+
+    if (ISVALIDSOCKET(socketList->interrupter[0])) {
+        CLOSESOCKET(socketList->interrupter[0]);
+        #ifndef _WIN32
+        CLOSESOCKET(socketList->interrupter[1]);
+        #endif
+    }
+
     free(socketList->pollfds);
+    free(socketList->states);
     free(socketList->addrinfos);
     free(socketList->sockettypes);
+    event_queue_free(socketList->eventQueue);
+    recorder_free(socketList->recorder);
     free(socketList);
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 
 #include "common.h"
+#include "state.h"
 
 
 typedef enum {
@@ -10,15 +11,53 @@ typedef enum {
     TCP_SERVER,
     UDP_SERVER,
     TCP_CLIENT,
-    UDP_CLIENT
+    UDP_CLIENT,
+    HANDOFF_CHANNEL
 } SOCKET_TYPE;
 
 
+#define RECV_LIMIT_DEFAULT (1024 * 1024)
+#define DRAIN_BUDGET_DEFAULT (1024 * 1024)
+#define LISTENER_BUDGET_DEFAULT 64
+#define CLIENT_BUDGET_DEFAULT 256
+
+
+typedef enum {
+    LIST_OPTION_RECV_LIMIT,
+    LIST_OPTION_DRAIN_BUDGET,
+    LIST_OPTION_LISTENER_BUDGET,
+    LIST_OPTION_CLIENT_BUDGET,
+    LIST_OPTION_HIGH_WATERMARK,
+    LIST_OPTION_LOW_WATERMARK,
+    LIST_OPTION_LOOP_HIGH_WATERMARK,
+    LIST_OPTION_LOOP_LOW_WATERMARK,
+    LIST_OPTION_EVENT_QUEUE,
+    LIST_OPTION_TIMESTAMPS
+} LIST_OPTION;
+
+
 typedef struct SocketList_st
 {
     POLL_FD *pollfds;
+    SocketState *states;
     struct addrinfo **addrinfos;
     SOCKET_TYPE *sockettypes;
+    SOCKET interrupter[2];
+    mint recvLimit;
+    mint drainBudget;
+    mint listenerBudget;
+    mint clientBudget;
+    mint cursor;
+    mint highWatermark;
+    mint lowWatermark;
+    mint loopHighWatermark;
+    mint loopLowWatermark;
+    mint outstandingEvents;
+    mint outstandingBytes;
+    mint pausedCount;
+    struct EventQueue_st *eventQueue;
+    struct Recorder_st *recorder;
+    bool timestamps;
 
     mint capacity;
     mint length;
@@ -28,12 +67,27 @@ typedef struct SocketList_st
 SocketList socket_list_create(mint *sockets, mint *types, size_t length);
 
 
-void socket_list_add(SocketList socketList, SOCKET socketId, SOCKET_TYPE socketType);
+SocketState socket_list_add(SocketList socketList, SOCKET socketId, SOCKET_TYPE socketType);
+
+
+mint socket_list_find(SocketList socketList, SOCKET socketId);
+
+
+void socket_list_drop(SocketList socketList, mint index);
 
 
 void socket_list_prune(SocketList socketList);
 
 
+void socket_list_interrupter_create(SocketList socketList);
+
+
+void socket_list_interrupt(SocketList socketList);
+
+
+void socket_list_interrupter_drain(SocketList socketList);
+
+
 void socket_list_free(SocketList socketList);
 
 
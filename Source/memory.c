@@ -0,0 +1,110 @@
+#include "memory.h"
+
+
+// Bytes held by the library on behalf of connections and loops: send
+// queues, pushback buffers, receive buffers, unhandled events and the
+// response cache, guarded by globalMutex
+static mint memoryUsed = 0;
+static mint memoryLimit = 0;
+static mint connectionMemoryLimit = 0;
+static bool memoryShedding = false;
+
+
+DLLEXPORT int socketMemorySetLimits(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    mint limit = MArgument_getInteger(Args[0]);           // 0 - no limit
+    mint connectionLimit = MArgument_getInteger(Args[1]); // 0 - no limit
+    mbool shed = MArgument_getBoolean(Args[2]);           // close instead of pausing
+
+    if (limit < 0 || connectionLimit < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mutex_lock(&globalMutex);
+    memoryLimit = limit;
+    connectionMemoryLimit = connectionLimit;
+    memoryShedding = shed;
+    mutex_unlock(&globalMutex);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketMemoryUsage(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+
+    MTensor usage;
+    mint length = 4;
+    libData->MTensor_new(MType_Integer, 1, &length, &usage);
+    mint *usageData = libData->MTensor_getIntegerData(usage);
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    usageData[0] = memoryUsed;
+    usageData[1] = memoryLimit;
+    usageData[2] = state != NULL ? state->memory : 0;
+    usageData[3] = connectionMemoryLimit;
+    mutex_unlock(&globalMutex);
+
+    MArgument_setMTensor(Res, usage);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// The caller holds globalMutex, state is NULL for memory of no connection
+void memory_update(SocketState state, mint bytes)
+{
+    memoryUsed += bytes;
+    if (state != NULL) {
+        state->memory += bytes;
+    }
+}
+
+
+void memory_charge(SocketState state, mint bytes)
+{
+    mutex_lock(&globalMutex);
+    memory_update(state, bytes);
+    mutex_unlock(&globalMutex);
+}
+
+
+// Whether bytes more can be held without crossing a limit
+bool memory_allowed(SocketState state, mint bytes)
+{
+    mutex_lock(&globalMutex);
+    bool allowed = (memoryLimit == 0 || memoryUsed + bytes <= memoryLimit) &&
+        (connectionMemoryLimit == 0 || state == NULL || state->memory + bytes <= connectionMemoryLimit);
+    mutex_unlock(&globalMutex);
+    return allowed;
+}
+
+
+MEMORY_STATUS memory_check(SocketState state)
+{
+    MEMORY_STATUS status = MEMORY_OK;
+
+    mutex_lock(&globalMutex);
+    if (connectionMemoryLimit > 0 && state != NULL && state->memory > connectionMemoryLimit) {
+        status = MEMORY_CONNECTION_LIMIT;
+    } else if (memoryLimit > 0 && memoryUsed > memoryLimit) {
+        status = MEMORY_GLOBAL_LIMIT;
+    }
+    mutex_unlock(&globalMutex);
+
+    return status;
+}
+
+
+bool memory_shed()
+{
+    return memoryShedding;
+}
+
+
+// Whether any limit is set, unhandled events only count towards one then
+bool memory_limited()
+{
+    return memoryLimit > 0 || connectionMemoryLimit > 0;
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef MEMORY_H
+#define MEMORY_H
+
+
+#include "common.h"
+#include "state.h"
+
+
+typedef enum {
+    MEMORY_OK,
+    MEMORY_CONNECTION_LIMIT,
+    MEMORY_GLOBAL_LIMIT
+} MEMORY_STATUS;
+
+
+void memory_update(SocketState state, mint bytes);
+
+
+void memory_charge(SocketState state, mint bytes);
+
+
+bool memory_allowed(SocketState state, mint bytes);
+
+
+MEMORY_STATUS memory_check(SocketState state);
+
+
+bool memory_shed();
+
+
+bool memory_limited();
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "plugin.h"
+
+
+DLLEXPORT int socketPluginLoad(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    char *path = MArgument_getUTF8String(Args[0]); // path to the shared library
+
+    void *handle = OPENLIBRARY(path);
+    libData->UTF8String_disown(path);
+
+    if (handle == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    Plugin plugin = malloc(sizeof(struct Plugin_st));
+    plugin->handle = handle;
+    plugin->onAccept = (PluginAcceptCallback)LIBRARYSYMBOL(handle, "csockets_on_accept");
+    plugin->onMessage = (PluginMessageCallback)LIBRARYSYMBOL(handle, "csockets_on_message");
+    plugin->onClose = (PluginCloseCallback)LIBRARYSYMBOL(handle, "csockets_on_close");
+
+    mint pluginPtr = (mint)(uintptr_t)plugin;
+    MArgument_setInteger(Res, pluginPtr);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPluginAttach(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);           // listening or client socket
+    Plugin plugin = (Plugin)(uintptr_t)MArgument_getInteger(Args[1]); // plugin pointer, 0 to detach
+
+    SocketState state = socket_state_acquire(socketId);
+    state->plugin = plugin;
+    socket_state_release(state);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Replies go through the write queue so they keep their place behind queued
+// bytes and a slow reader cannot stall the loop
+static int plugin_send(SOCKET socketId, const BYTE *data, size_t length)
+{
+    SocketState state = socket_state_get(socketId);
+    int result = state != NULL ? coalesce_append(state, data, length) : SOCKET_ERROR;
+    socket_state_release(state);
+    return result;
+}
+
+
+int plugin_accept(Plugin plugin, SOCKET socketId, SOCKET listenSocketId)
+{
+    if (plugin->onAccept == NULL) {
+        return PLUGIN_FORWARD;
+    }
+
+    struct PluginContext_st context = { socketId, listenSocketId, plugin_send };
+    return plugin->onAccept(&context);
+}
+
+
+int plugin_message(Plugin plugin, SOCKET socketId, SOCKET listenSocketId, const BYTE *data, size_t length)
+{
+    if (plugin->onMessage == NULL) {
+        return PLUGIN_FORWARD;
+    }
+
+    struct PluginContext_st context = { socketId, listenSocketId, plugin_send };
+    return plugin->onMessage(&context, data, length);
+}
+
+
+void plugin_close(Plugin plugin, SOCKET socketId, SOCKET listenSocketId)
+{
+    if (plugin->onClose == NULL) {
+        return;
+    }
+
+    struct PluginContext_st context = { socketId, listenSocketId, plugin_send };
+    plugin->onClose(&context);
+}
\ No newline at end of file
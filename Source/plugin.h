@@ -0,0 +1,64 @@
+#ifndef PLUGIN_H
+#define PLUGIN_H
+
+
+#include "common.h"
+#include "state.h"
+#include "coalesce.h"
+
+
+/*
+Native handler plugins are shared libraries that export any of
+
+    int csockets_on_accept(PluginContext context);
+    int csockets_on_message(PluginContext context, const BYTE *data, size_t length);
+    void csockets_on_close(PluginContext context);
+
+The poll loop calls them on its own thread. on_accept and on_message return
+one of the PLUGIN_* verdicts below, a plugin answers by calling context->send,
+which never blocks: what the socket does not take is queued behind earlier
+writes and flushed by the loop.
+*/
+
+
+#define PLUGIN_FORWARD 0 // raise the event to Wolfram Language as usual
+#define PLUGIN_HANDLED 1 // the plugin consumed the event
+#define PLUGIN_CLOSE 2   // the plugin consumed the event, close the connection
+
+
+typedef struct PluginContext_st
+{
+    SOCKET socketId;
+    SOCKET listenSocketId;
+    int (*send)(SOCKET socketId, const BYTE *data, size_t length);
+} *PluginContext;
+
+
+typedef int (*PluginAcceptCallback)(PluginContext context);
+
+
+typedef int (*PluginMessageCallback)(PluginContext context, const BYTE *data, size_t length);
+
+
+typedef void (*PluginCloseCallback)(PluginContext context);
+
+
+typedef struct Plugin_st
+{
+    void *handle;
+    PluginAcceptCallback onAccept;
+    PluginMessageCallback onMessage;
+    PluginCloseCallback onClose;
+} *Plugin;
+
+
+int plugin_accept(Plugin plugin, SOCKET socketId, SOCKET listenSocketId);
+
+
+int plugin_message(Plugin plugin, SOCKET socketId, SOCKET listenSocketId, const BYTE *data, size_t length);
+
+
+void plugin_close(Plugin plugin, SOCKET socketId, SOCKET listenSocketId);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,311 @@
+#include "pollset.h"
+
+
+DLLEXPORT int socketPollSetCreate(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = poll_set_create();
+    if (pollSet == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mint pollSetPtr = (mint)(uintptr_t)pollSet;
+    MArgument_setInteger(Res, pollSetPtr);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPollSetAdd(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = (PollSet)MArgument_getInteger(Args[0]);
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[1]);
+    mint eventsMask = MArgument_getInteger(Args[2]);
+
+    if (poll_set_control(pollSet, socketId, eventsMask, POLLSET_ADD) != 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPollSetModify(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = (PollSet)MArgument_getInteger(Args[0]);
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[1]);
+    mint eventsMask = MArgument_getInteger(Args[2]);
+
+    if (poll_set_control(pollSet, socketId, eventsMask, POLLSET_MODIFY) != 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPollSetRemove(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = (PollSet)MArgument_getInteger(Args[0]);
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[1]);
+
+    if (poll_set_control(pollSet, socketId, 0, POLLSET_REMOVE) != 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Returns {socketId, events} rows for the ready sockets only, at most
+// maxEvents of them, timeout in microseconds with -1 to wait forever
+DLLEXPORT int socketPollSetWait(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = (PollSet)MArgument_getInteger(Args[0]);
+    mint maxEvents = MArgument_getInteger(Args[1]);
+    mint timeout = MArgument_getInteger(Args[2]);
+
+    if (maxEvents <= 0 || maxEvents > POLLSET_WAIT_MAX) {
+        maxEvents = POLLSET_WAIT_MAX;
+    }
+
+    mint *ready = pool_alloc(sizeof(mint) * 2 * maxEvents);
+    mint count = poll_set_wait(pollSet, ready, maxEvents, timeout);
+    if (count < 0) {
+        pool_free(ready);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MTensor readyTensor;
+    mint dims[2] = {count, 2};
+    libData->MTensor_new(MType_Integer, 2, dims, &readyTensor);
+    if (count > 0) {
+        memcpy(libData->MTensor_getIntegerData(readyTensor), ready, sizeof(mint) * 2 * count);
+    }
+    pool_free(ready);
+
+    MArgument_setMTensor(Res, readyTensor);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPollSetLength(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = (PollSet)MArgument_getInteger(Args[0]);
+    MArgument_setInteger(Res, pollSet->length);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketPollSetDelete(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    PollSet pollSet = (PollSet)MArgument_getInteger(Args[0]);
+    poll_set_free(pollSet);
+    return LIBRARY_NO_ERROR;
+}
+
+
+PollSet poll_set_create()
+{
+    PollSet pollSet = calloc(1, sizeof(struct PollSet_st));
+    if (pollSet == NULL) {
+        return NULL;
+    }
+
+    #ifdef __linux__
+    pollSet->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (pollSet->epollFd < 0) {
+        free(pollSet);
+        return NULL;
+    }
+    #endif
+
+    return pollSet;
+}
+
+
+void poll_set_free(PollSet pollSet)
+{
+    #ifdef __linux__
+    close(pollSet->epollFd);
+    free(pollSet->members);
+    #else
+    free(pollSet->pollfds);
+    #endif
+    free(pollSet);
+}
+
+
+#ifdef __linux__
+
+
+static bool poll_set_member(PollSet pollSet, SOCKET socketId)
+{
+    return socketId >= 0 && socketId < pollSet->membersCapacity && pollSet->members[socketId];
+}
+
+
+static bool poll_set_track(PollSet pollSet, SOCKET socketId, bool member)
+{
+    if (socketId >= pollSet->membersCapacity) {
+        mint capacity = pollSet->membersCapacity > 0 ? pollSet->membersCapacity : 64;
+        while (capacity <= socketId) {
+            capacity *= 2;
+        }
+        bool *members = realloc(pollSet->members, sizeof(bool) * capacity);
+        if (members == NULL) {
+            return false;
+        }
+        memset(members + pollSet->membersCapacity, 0, sizeof(bool) * (capacity - pollSet->membersCapacity));
+        pollSet->members = members;
+        pollSet->membersCapacity = capacity;
+    }
+
+    bool wasMember = pollSet->members[socketId];
+    pollSet->members[socketId] = member;
+    if (member != wasMember) {
+        pollSet->length += member ? 1 : -1;
+    }
+    return true;
+}
+
+
+// Level triggered so a socket stays ready until it is read, like poll
+int poll_set_control(PollSet pollSet, SOCKET socketId, mint eventsMask, int operation)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = (uint32_t)convert_wl_to_native_events(eventsMask);
+    event.data.fd = socketId;
+
+    int result;
+    switch (operation)
+    {
+    case POLLSET_ADD:
+        if (socketId < 0) {
+            return -1;
+        }
+        result = epoll_ctl(pollSet->epollFd, EPOLL_CTL_ADD, socketId, &event);
+        if (result == 0 && !poll_set_track(pollSet, socketId, true)) {
+            epoll_ctl(pollSet->epollFd, EPOLL_CTL_DEL, socketId, &event);
+            return -1;
+        }
+        return result;
+    case POLLSET_MODIFY:
+        result = epoll_ctl(pollSet->epollFd, EPOLL_CTL_MOD, socketId, &event);
+        break;
+    case POLLSET_REMOVE:
+        result = epoll_ctl(pollSet->epollFd, EPOLL_CTL_DEL, socketId, &event);
+        if (!poll_set_member(pollSet, socketId)) {
+            return result;
+        }
+        // a closed socket has already left the set, its descriptor may even
+        // belong to a newer socket by now
+        if (result == 0 || errno == EBADF || errno == ENOENT) {
+            poll_set_track(pollSet, socketId, false);
+            return 0;
+        }
+        return result;
+    default:
+        return -1;
+    }
+
+    return result;
+}
+
+
+mint poll_set_wait(PollSet pollSet, mint *ready, mint maxEvents, mint timeout)
+{
+    struct epoll_event *events = pool_alloc(sizeof(struct epoll_event) * maxEvents);
+    int result;
+
+    do {
+        result = epoll_wait(pollSet->epollFd, events, (int)maxEvents, poll_timeout_ms(timeout));
+    } while (result < 0 && errno == EINTR && timeout < 0);
+
+    if (result < 0 && errno == EINTR) {
+        result = 0;
+    }
+
+    for (int i = 0; i < result; i++) {
+        ready[2 * i] = (mint)events[i].data.fd;
+        ready[2 * i + 1] = convert_native_to_wl_events((int)events[i].events);
+    }
+
+    pool_free(events);
+    return result;
+}
+
+
+#else
+
+
+static mint poll_set_find(PollSet pollSet, SOCKET socketId)
+{
+    for (mint i = 0; i < pollSet->length; i++) {
+        if (pollSet->pollfds[i].fd == socketId) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+int poll_set_control(PollSet pollSet, SOCKET socketId, mint eventsMask, int operation)
+{
+    mint index = poll_set_find(pollSet, socketId);
+
+    switch (operation)
+    {
+    case POLLSET_ADD:
+        if (index >= 0) {
+            return -1;
+        }
+        if (pollSet->length == pollSet->capacity) {
+            mint capacity = pollSet->capacity > 0 ? 2 * pollSet->capacity : 16;
+            POLL_FD *pollfds = realloc(pollSet->pollfds, sizeof(POLL_FD) * capacity);
+            if (pollfds == NULL) {
+                return -1;
+            }
+            pollSet->pollfds = pollfds;
+            pollSet->capacity = capacity;
+        }
+        pollSet->pollfds[pollSet->length].fd = socketId;
+        pollSet->pollfds[pollSet->length].events = convert_wl_to_native_events(eventsMask);
+        pollSet->pollfds[pollSet->length].revents = 0;
+        pollSet->length++;
+        return 0;
+    case POLLSET_MODIFY:
+        if (index < 0) {
+            return -1;
+        }
+        pollSet->pollfds[index].events = convert_wl_to_native_events(eventsMask);
+        return 0;
+    case POLLSET_REMOVE:
+        if (index < 0) {
+            return -1;
+        }
+        pollSet->length--;
+        pollSet->pollfds[index] = pollSet->pollfds[pollSet->length];
+        return 0;
+    default:
+        return -1;
+    }
+}
+
+
+mint poll_set_wait(PollSet pollSet, mint *ready, mint maxEvents, mint timeout)
+{
+    int result = sockets_poll(pollSet->pollfds, pollSet->length, timeout);
+    if (result < 0) {
+        return -1;
+    }
+
+    mint count = 0;
+    for (mint i = 0; i < pollSet->length && count < maxEvents && count < result; i++) {
+        if (pollSet->pollfds[i].revents != 0) {
+            ready[2 * count] = (mint)pollSet->pollfds[i].fd;
+            ready[2 * count + 1] = convert_native_to_wl_events(pollSet->pollfds[i].revents);
+            count++;
+        }
+    }
+    return count;
+}
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,51 @@
+#ifndef POLLSET_H
+#define POLLSET_H
+
+
+#include "common.h"
+#include "pool.h"
+
+
+#ifdef __linux__
+    #include <sys/epoll.h>
+#endif
+
+
+#define POLLSET_WAIT_MAX 1024
+
+
+#define POLLSET_ADD 1
+#define POLLSET_MODIFY 2
+#define POLLSET_REMOVE 3
+
+
+// Interest set kept between readiness checks, an epoll instance on Linux
+// and a poll array elsewhere. epoll drops a socket silently when it is
+// closed, so members records by descriptor what the set holds.
+typedef struct PollSet_st
+{
+    #ifdef __linux__
+    int epollFd;
+    bool *members;
+    mint membersCapacity;
+    #else
+    POLL_FD *pollfds;
+    mint capacity;
+    #endif
+    mint length;
+} *PollSet;
+
+
+PollSet poll_set_create();
+
+
+void poll_set_free(PollSet pollSet);
+
+
+int poll_set_control(PollSet pollSet, SOCKET socketId, mint eventsMask, int operation);
+
+
+mint poll_set_wait(PollSet pollSet, mint *ready, mint maxEvents, mint timeout);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,188 @@
+#include "pool.h"
+
+
+// Power of two size classes from 64 bytes to 1 MB with a free list per
+// class and thread, larger blocks go straight to malloc
+static THREAD_LOCAL PoolBlock poolFree[POOL_CLASSES];
+static THREAD_LOCAL mint poolCached[POOL_CLASSES];
+
+// Counters are per thread so allocating never touches a shared cache line,
+// threads that release their pool fold theirs into poolRetired
+static THREAD_LOCAL PoolStats poolStats = NULL;
+static PoolStats poolThreads = NULL;
+static struct PoolStats_st poolRetired;
+static Mutex poolMutex = MUTEX_INITIALIZER;
+
+
+DLLEXPORT int socketPoolStats(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    MTensor stats;
+    mint length = 5;
+    libData->MTensor_new(MType_Integer, 1, &length, &stats);
+    mint *statsData = libData->MTensor_getIntegerData(stats);
+
+    mutex_lock(&poolMutex);
+    statsData[0] = poolRetired.allocations;
+    statsData[1] = poolRetired.hits;
+    statsData[2] = poolRetired.large;
+    statsData[3] = poolRetired.frees;
+    statsData[4] = poolRetired.cachedBytes;
+    for (PoolStats threadStats = poolThreads; threadStats != NULL; threadStats = threadStats->next) {
+        statsData[0] += atomic_get(&threadStats->allocations);
+        statsData[1] += atomic_get(&threadStats->hits);
+        statsData[2] += atomic_get(&threadStats->large);
+        statsData[3] += atomic_get(&threadStats->frees);
+        statsData[4] += atomic_get(&threadStats->cachedBytes);
+    }
+    mutex_unlock(&poolMutex);
+
+    MArgument_setMTensor(Res, stats);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// The counters of the calling thread, registered on first use, NULL when
+// they could not be allocated and nothing is counted
+static PoolStats pool_stats()
+{
+    if (poolStats == NULL) {
+        PoolStats threadStats = calloc(1, sizeof(struct PoolStats_st));
+        if (threadStats == NULL) {
+            return NULL;
+        }
+
+        mutex_lock(&poolMutex);
+        threadStats->next = poolThreads;
+        poolThreads = threadStats;
+        mutex_unlock(&poolMutex);
+        poolStats = threadStats;
+    }
+    return poolStats;
+}
+
+
+// Only the owning thread writes, a plain store is enough for the reader
+static void pool_count(mint *counter, mint value)
+{
+    atomic_set(counter, *counter + value);
+}
+
+
+static mint pool_size_class(size_t size)
+{
+    mint sizeClass = 0;
+    while (sizeClass < POOL_CLASSES && ((size_t)1 << (sizeClass + POOL_MIN_SHIFT)) < size) {
+        sizeClass++;
+    }
+    return sizeClass < POOL_CLASSES ? sizeClass : POOL_LARGE;
+}
+
+
+void *pool_alloc(size_t size)
+{
+    mint sizeClass = pool_size_class(size);
+    PoolStats threadStats = pool_stats();
+    PoolBlock block;
+
+    if (threadStats != NULL) {
+        pool_count(&threadStats->allocations, 1);
+    }
+
+    if (sizeClass == POOL_LARGE) {
+        if (threadStats != NULL) {
+            pool_count(&threadStats->large, 1);
+        }
+        block = malloc(sizeof(struct PoolBlock_st) + size);
+    } else if (poolFree[sizeClass] != NULL) {
+        if (threadStats != NULL) {
+            pool_count(&threadStats->hits, 1);
+            pool_count(&threadStats->cachedBytes, -((mint)1 << (sizeClass + POOL_MIN_SHIFT)));
+        }
+        block = poolFree[sizeClass];
+        poolFree[sizeClass] = block->next;
+        poolCached[sizeClass]--;
+    } else {
+        block = malloc(sizeof(struct PoolBlock_st) + ((size_t)1 << (sizeClass + POOL_MIN_SHIFT)));
+    }
+
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->next = NULL;
+    block->sizeClass = sizeClass;
+    return block + 1;
+}
+
+
+void *pool_calloc(size_t size)
+{
+    void *data = pool_alloc(size);
+    if (data != NULL) {
+        memset(data, 0, size);
+    }
+    return data;
+}
+
+
+// Blocks go to the free list of the thread that frees them, each list
+// keeps at most POOL_CACHE_BYTES
+void pool_free(void *data)
+{
+    if (data == NULL) {
+        return;
+    }
+
+    PoolBlock block = (PoolBlock)data - 1;
+    mint sizeClass = block->sizeClass;
+    PoolStats threadStats = pool_stats();
+
+    if (threadStats != NULL) {
+        pool_count(&threadStats->frees, 1);
+    }
+
+    if (sizeClass == POOL_LARGE || poolCached[sizeClass] << (sizeClass + POOL_MIN_SHIFT) >= POOL_CACHE_BYTES) {
+        free(block);
+        return;
+    }
+
+    block->next = poolFree[sizeClass];
+    poolFree[sizeClass] = block;
+    poolCached[sizeClass]++;
+    if (threadStats != NULL) {
+        pool_count(&threadStats->cachedBytes, (mint)1 << (sizeClass + POOL_MIN_SHIFT));
+    }
+}
+
+
+// Returns the blocks cached by the calling thread, for threads that exit
+void pool_thread_release()
+{
+    for (mint sizeClass = 0; sizeClass < POOL_CLASSES; sizeClass++) {
+        while (poolFree[sizeClass] != NULL) {
+            PoolBlock block = poolFree[sizeClass];
+            poolFree[sizeClass] = block->next;
+            free(block);
+        }
+        poolCached[sizeClass] = 0;
+    }
+
+    if (poolStats == NULL) {
+        return;
+    }
+
+    mutex_lock(&poolMutex);
+    PoolStats *link = &poolThreads;
+    while (*link != poolStats) {
+        link = &(*link)->next;
+    }
+    *link = poolStats->next;
+    poolRetired.allocations += poolStats->allocations;
+    poolRetired.hits += poolStats->hits;
+    poolRetired.large += poolStats->large;
+    poolRetired.frees += poolStats->frees;
+    mutex_unlock(&poolMutex);
+
+    free(poolStats);
+    poolStats = NULL;
+}
\ No newline at end of file
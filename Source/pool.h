@@ -0,0 +1,47 @@
+#ifndef POOL_H
+#define POOL_H
+
+
+#include "common.h"
+
+
+#define POOL_MIN_SHIFT 6
+#define POOL_MAX_SHIFT 20
+#define POOL_CLASSES (POOL_MAX_SHIFT - POOL_MIN_SHIFT + 1)
+#define POOL_CACHE_BYTES (1024 * 1024)
+#define POOL_LARGE -1
+
+
+// Header in front of every pooled block, the data follows it
+typedef struct PoolBlock_st
+{
+    struct PoolBlock_st *next;
+    mint sizeClass;
+} *PoolBlock;
+
+
+// Counters of one thread, only written by it and summed by socketPoolStats
+typedef struct PoolStats_st
+{
+    struct PoolStats_st *next;
+    mint allocations;
+    mint hits;
+    mint large;
+    mint frees;
+    mint cachedBytes;
+} *PoolStats;
+
+
+void *pool_alloc(size_t size);
+
+
+void *pool_calloc(size_t size);
+
+
+void pool_free(void *data);
+
+
+void pool_thread_release();
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include "queue.h"
+
+
+// Drains the queue of a socket list in queued mode and returns {events, payloads}: an n x 8 tensor of {kind, socketId,
+// socketType, value1, value2, value3, offset, length} rows and one byte
+// array holding the payloads, offsets are 0-based into it. Waits up to
+// timeout microseconds for the first event, -1 waits forever
+DLLEXPORT int socketEventsDrain(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SocketList socketList = (SocketList)MArgument_getInteger(Args[0]);
+    mint max = MArgument_getInteger(Args[1]);
+    mint timeout = MArgument_getInteger(Args[2]);
+
+    EventQueue queue = socketList->eventQueue;
+    if (queue == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mint deadline = get_monotonic_time() + timeout * 1000;
+    mint head = atomic_get(&queue->head);
+    while (head == queue->tail) {
+        mint remaining = (deadline - get_monotonic_time()) / 1000;
+        if (timeout >= 0 && remaining <= 0) {
+            break;
+        }
+
+        mint generation = wakeup_generation(&queue->wakeup);
+        head = atomic_get(&queue->head);
+        if (head == queue->tail) {
+            wakeup_wait(&queue->wakeup, generation, timeout < 0 ? -1 : remaining);
+            head = atomic_get(&queue->head);
+        }
+    }
+
+    mint count = head - queue->tail;
+    if (max > 0 && count > max) {
+        count = max;
+    }
+
+    MTensor events;
+    mint dims[2] = {count, EVENT_QUEUE_COLUMNS};
+    libData->MTensor_new(MType_Integer, 2, dims, &events);
+    mint *eventsData = libData->MTensor_getIntegerData(events);
+
+    mint arenaStart = queue->arenaTail;
+    mint arenaEnd = arenaStart;
+    for (mint i = 0; i < count; i++) {
+        EventRecord record = &queue->records[(queue->tail + i) % EVENT_QUEUE_RECORDS];
+        memcpy(eventsData + i * EVENT_QUEUE_COLUMNS, record, sizeof(struct EventRecord_st));
+        eventsData[i * EVENT_QUEUE_COLUMNS + 6] = record->offset - arenaStart;
+        arenaEnd = record->offset + record->length;
+    }
+
+    MNumericArray payloads;
+    mint payloadLength = arenaEnd - arenaStart;
+    libData->numericarrayLibraryFunctions->MNumericArray_new(MNumericArray_Type_UBit8, 1, &payloadLength, &payloads);
+    BYTE *payloadData = libData->numericarrayLibraryFunctions->MNumericArray_getData(payloads);
+
+    mint start = arenaStart % queue->arenaCapacity;
+    mint first = payloadLength < queue->arenaCapacity - start ? payloadLength : queue->arenaCapacity - start;
+    if (payloadLength > 0) {
+        memcpy(payloadData, queue->arena + start, first);
+        memcpy(payloadData + first, queue->arena, payloadLength - first);
+    }
+
+    atomic_set(&queue->arenaTail, arenaEnd);
+    atomic_set(&queue->tail, queue->tail + count);
+    if (count > 0) {
+        wakeup_notify(&queue->wakeup);
+    }
+
+    DataStore dataStore = libData->ioLibraryFunctions->createDataStore();
+    libData->ioLibraryFunctions->DataStore_addMTensor(dataStore, events);
+    libData->ioLibraryFunctions->DataStore_addMNumericArray(dataStore, payloads);
+
+    MArgument_setDataStore(Res, dataStore);
+    return LIBRARY_NO_ERROR;
+}
+
+
+EventQueue event_queue_create(mint arenaCapacity)
+{
+    EventQueue queue = calloc(1, sizeof(struct EventQueue_st));
+    queue->records = malloc(sizeof(struct EventRecord_st) * EVENT_QUEUE_RECORDS);
+    queue->arena = malloc(arenaCapacity);
+    queue->arenaCapacity = arenaCapacity;
+    queue->enabled = 1;
+    wakeup_init(&queue->wakeup);
+
+    memory_charge(NULL, (mint)(sizeof(struct EventRecord_st) * EVENT_QUEUE_RECORDS) + arenaCapacity);
+    return queue;
+}
+
+
+void event_queue_free(EventQueue queue)
+{
+    if (queue == NULL) {
+        return;
+    }
+
+    memory_charge(NULL, -(mint)(sizeof(struct EventRecord_st) * EVENT_QUEUE_RECORDS) - queue->arenaCapacity);
+    wakeup_destroy(&queue->wakeup);
+    free(queue->records);
+    free(queue->arena);
+    free(queue);
+}
+
+
+bool event_queue_active(EventQueue queue)
+{
+    return queue != NULL && atomic_get(&queue->enabled);
+}
+
+
+// Called by the producer only, returns false while the consumer has not
+// made room for the record and its payload
+bool event_queue_push(EventQueue queue, EventRecord record, const BYTE *payload)
+{
+    mint tail = atomic_get(&queue->tail);
+    mint arenaTail = atomic_get(&queue->arenaTail);
+
+    if (queue->head - tail >= EVENT_QUEUE_RECORDS ||
+        queue->arenaHead + record->length - arenaTail > queue->arenaCapacity) {
+        return false;
+    }
+
+    mint start = queue->arenaHead % queue->arenaCapacity;
+    mint first = record->length < queue->arenaCapacity - start ? record->length : queue->arenaCapacity - start;
+    if (record->length > 0) {
+        memcpy(queue->arena + start, payload, first);
+        memcpy(queue->arena, payload + first, record->length - first);
+    }
+
+    record->offset = queue->arenaHead;
+    queue->records[queue->head % EVENT_QUEUE_RECORDS] = *record;
+    queue->arenaHead += record->length;
+
+    atomic_set(&queue->head, queue->head + 1);
+    wakeup_notify(&queue->wakeup);
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef QUEUE_H
+#define QUEUE_H
+
+
+#include "common.h"
+#include "memory.h"
+#include "list.h"
+
+
+#define EVENT_QUEUE_RECORDS 16384
+#define EVENT_QUEUE_COLUMNS 8
+#define EVENT_QUEUE_ARENA_MIN (64 * 1024)
+#define EVENT_QUEUE_ALIVE_CHECK 100000 // us a full queue waits before checking the task again
+
+
+// Every event the poll loop raises, in queued mode AcceptedBatch is queued
+// as one Accepted per connection
+typedef enum {
+    EVENT_RECEIVED = 1,
+    EVENT_RECEIVED_FROM,
+    EVENT_ACCEPTED,
+    EVENT_CLOSED,
+    EVENT_ERROR,
+    EVENT_MEMORY_LIMIT,
+    EVENT_RECEIVED_FRAME,
+    EVENT_REQUEST,
+    EVENT_REPLY,
+    EVENT_RELAY_OPENED,
+    EVENT_RELAY_CLOSED,
+    EVENT_SEND_COMPLETE
+} EVENT_KIND;
+
+
+// One event as the consumer sees it, a row of the drained tensor
+typedef struct EventRecord_st
+{
+    mint kind;
+    mint socketId;
+    mint socketType;
+    mint values[3];
+    mint offset;
+    mint length;
+} *EventRecord;
+
+
+// Single producer single consumer ring of event records with the payloads
+// in a byte ring, the poll loop pushes and socketEventsDrain pops. Head
+// and tail count records and bytes since creation and are only written by
+// their own side. Either side waiting on the other sleeps on the wakeup.
+typedef struct EventQueue_st
+{
+    Wakeup wakeup;
+    struct EventRecord_st *records;
+    BYTE *arena;
+    mint arenaCapacity;
+    mint head;
+    mint tail;
+    mint arenaHead;
+    mint arenaTail;
+    mint enabled;
+} *EventQueue;
+
+
+EventQueue event_queue_create(mint arenaCapacity);
+
+
+void event_queue_free(EventQueue queue);
+
+
+bool event_queue_push(EventQueue queue, EventRecord record, const BYTE *payload);
+
+
+bool event_queue_active(EventQueue queue);
+
+
+#endif
\ No newline at end of file
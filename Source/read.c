@@ -0,0 +1,282 @@
+#include "read.h"
+
+
+typedef enum {
+    READ_EXACT,
+    READ_UNTIL,
+    READ_TO_EOF
+} READ_MODE;
+
+
+static bool read_buffer_reserve(ReadBuffer *readBuffer, size_t extra)
+{
+    if (readBuffer->capacity - readBuffer->length >= extra) {
+        return true;
+    }
+
+    size_t capacity = readBuffer->capacity > 0 ? readBuffer->capacity : READ_CHUNK_SIZE;
+    while (capacity - readBuffer->length < extra) {
+        capacity *= 2;
+    }
+
+    BYTE *data = realloc(readBuffer->data, capacity);
+    if (data == NULL) {
+        return false;
+    }
+
+    readBuffer->data = data;
+    readBuffer->capacity = capacity;
+    return true;
+}
+
+
+// Starts from the bytes left over by the previous read on this socket
+static ReadBuffer read_buffer_from_pushback(SocketState state)
+{
+    ReadBuffer readBuffer = {state->pushback, state->pushbackLength, state->pushbackLength};
+    memory_charge(state, -(mint)state->pushbackLength);
+    state->pushback = NULL;
+    state->pushbackLength = 0;
+    return readBuffer;
+}
+
+
+// Keeps the bytes after offset for the next read and frees the rest
+static void read_buffer_to_pushback(SocketState state, ReadBuffer *readBuffer, size_t offset)
+{
+    size_t rest = readBuffer->length - offset;
+    if (rest == 0) {
+        free(readBuffer->data);
+        return;
+    }
+
+    if (offset > 0) {
+        memmove(readBuffer->data, readBuffer->data + offset, rest);
+    }
+
+    state->pushback = readBuffer->data;
+    state->pushbackLength = rest;
+    memory_charge(state, (mint)rest);
+}
+
+
+size_t socket_pushback_take(SocketState state, BYTE *buffer, size_t bufferSize)
+{
+    if (state == NULL || state->pushbackLength == 0) {
+        return 0;
+    }
+
+    ReadBuffer readBuffer = read_buffer_from_pushback(state);
+    size_t length = readBuffer.length < bufferSize ? readBuffer.length : bufferSize;
+    memcpy(buffer, readBuffer.data, length);
+    read_buffer_to_pushback(state, &readBuffer, length);
+    return length;
+}
+
+
+static mint read_find(const BYTE *data, size_t length, const BYTE *delimiter, size_t delimiterLength, size_t from)
+{
+    for (size_t i = from; i + delimiterLength <= length; i++) {
+        if (data[i] == delimiter[0] && memcmp(data + i, delimiter, delimiterLength) == 0) {
+            return (mint)i;
+        }
+    }
+    return -1;
+}
+
+
+// Reads from a socket until the mode is satisfied, returns the number of
+// bytes to hand out or -1 with the error message name in errorName
+static mint socket_read(SOCKET socketId, ReadBuffer *readBuffer, READ_MODE mode, size_t limit,
+    const BYTE *delimiter, size_t delimiterLength, mint timeout, const char **errorName)
+{
+    mint deadline = timeout < 0 ? -1 : get_monotonic_time() + timeout * 1000;
+    size_t scanned = 0;
+
+    while (true) {
+        if (mode == READ_EXACT && readBuffer->length >= limit) {
+            return (mint)limit;
+        }
+
+        if (mode == READ_UNTIL) {
+            mint found = read_find(readBuffer->data, readBuffer->length, delimiter, delimiterLength, scanned);
+            if (found >= 0 && (size_t)found + delimiterLength <= limit) {
+                return found + (mint)delimiterLength;
+            }
+            if (found >= 0 || readBuffer->length >= limit) {
+                *errorName = "socketreadlimit";
+                return -1;
+            }
+            scanned = readBuffer->length >= delimiterLength ? readBuffer->length - delimiterLength + 1 : 0;
+        }
+
+        // one byte past the limit tells a body of exactly limit bytes from a
+        // longer one, which fails like READ_UNTIL instead of being cut off
+        if (mode == READ_TO_EOF && readBuffer->length > limit) {
+            *errorName = "socketreadlimit";
+            return -1;
+        }
+
+        mint wait = -1;
+        if (deadline >= 0) {
+            wait = (deadline - get_monotonic_time()) / 1000;
+            if (wait <= 0) {
+                *errorName = "socketreadtimeout";
+                return -1;
+            }
+        }
+
+        POLL_FD pollfd;
+        pollfd.fd = socketId;
+        pollfd.events = POLLIN_FLAG;
+        pollfd.revents = 0;
+
+        int ready = sockets_poll(&pollfd, 1, wait);
+        if (ready < 0) {
+            *errorName = "socketreaderror";
+            return -1;
+        }
+        if (ready == 0) {
+            continue;
+        }
+
+        size_t chunk = mode == READ_EXACT && limit - readBuffer->length > READ_CHUNK_SIZE ? limit - readBuffer->length : READ_CHUNK_SIZE;
+        if (mode == READ_TO_EOF && limit + 1 - readBuffer->length < chunk) {
+            chunk = limit + 1 - readBuffer->length;
+        }
+
+        if (!read_buffer_reserve(readBuffer, chunk)) {
+            *errorName = "socketreadmemory";
+            return -1;
+        }
+
+        int received = recv(socketId, (char*)readBuffer->data + readBuffer->length, (int)chunk, 0);
+        if (received > 0) {
+            readBuffer->length += (size_t)received;
+            continue;
+        }
+
+        if (received == 0) {
+            if (mode == READ_TO_EOF) {
+                return (mint)readBuffer->length;
+            }
+            *errorName = "socketreadeof";
+            return -1;
+        }
+
+        if (!is_wouldblock_err(GETSOCKETERRNO())) {
+            *errorName = "socketreaderror";
+            return -1;
+        }
+    }
+}
+
+
+// Hands out the first length bytes as a ByteArray and keeps the rest, on
+// failure everything read stays in the pushback buffer for the next call
+static MNumericArray socket_read_result(WolframLibraryData libData, SocketState state, ReadBuffer *readBuffer,
+    mint length, const char *errorName)
+{
+    if (length < 0) {
+        read_buffer_to_pushback(state, readBuffer, 0);
+        libData->Message(errorName);
+        return NULL;
+    }
+
+    MNumericArray byteArray;
+    libData->numericarrayLibraryFunctions->MNumericArray_new(MNumericArray_Type_UBit8, 1, &length, &byteArray);
+
+    if (length > 0) {
+        BYTE *array = libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+        memcpy(array, readBuffer->data, (size_t)length);
+    }
+
+    read_buffer_to_pushback(state, readBuffer, (size_t)length);
+    return byteArray;
+}
+
+
+DLLEXPORT int socketReadExact(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint length = MArgument_getInteger(Args[1]);
+    mint timeout = MArgument_getInteger(Args[2]); // timeout in microseconds, -1 - no limit
+
+    if (!ISVALIDSOCKET(socketId) || length < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    ReadBuffer readBuffer = read_buffer_from_pushback(state);
+    const char *errorName = NULL;
+
+    mint result = socket_read(socketId, &readBuffer, READ_EXACT, (size_t)length, NULL, 0, timeout, &errorName);
+
+    MNumericArray byteArray = socket_read_result(libData, state, &readBuffer, result, errorName);
+    socket_state_release(state);
+    if (byteArray == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setMNumericArray(Res, byteArray);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketReadUntil(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    MNumericArray delimiterArray = MArgument_getMNumericArray(Args[1]);
+    BYTE *delimiter = (BYTE*)libData->numericarrayLibraryFunctions->MNumericArray_getData(delimiterArray);
+    mint delimiterLength = MArgument_getInteger(Args[2]);
+    mint limit = MArgument_getInteger(Args[3]);
+    mint timeout = MArgument_getInteger(Args[4]); // timeout in microseconds, -1 - no limit
+
+    if (!ISVALIDSOCKET(socketId) || delimiterLength <= 0 || limit < delimiterLength) {
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(delimiterArray);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    ReadBuffer readBuffer = read_buffer_from_pushback(state);
+    const char *errorName = NULL;
+
+    mint result = socket_read(socketId, &readBuffer, READ_UNTIL, (size_t)limit, delimiter, (size_t)delimiterLength, timeout, &errorName);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(delimiterArray);
+
+    MNumericArray byteArray = socket_read_result(libData, state, &readBuffer, result, errorName);
+    socket_state_release(state);
+    if (byteArray == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setMNumericArray(Res, byteArray);
+    return LIBRARY_NO_ERROR;
+}
+
+
+DLLEXPORT int socketReadToEOF(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint limit = MArgument_getInteger(Args[1]);
+    mint timeout = MArgument_getInteger(Args[2]); // timeout in microseconds, -1 - no limit
+
+    if (!ISVALIDSOCKET(socketId) || limit < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    ReadBuffer readBuffer = read_buffer_from_pushback(state);
+    const char *errorName = NULL;
+
+    mint result = socket_read(socketId, &readBuffer, READ_TO_EOF, (size_t)limit, NULL, 0, timeout, &errorName);
+
+    MNumericArray byteArray = socket_read_result(libData, state, &readBuffer, result, errorName);
+    socket_state_release(state);
+    if (byteArray == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setMNumericArray(Res, byteArray);
+    return LIBRARY_NO_ERROR;
+}
\ No newline at end of file
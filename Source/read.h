@@ -0,0 +1,24 @@
+#ifndef READ_H
+#define READ_H
+
+
+#include "common.h"
+#include "state.h"
+#include "memory.h"
+
+
+#define READ_CHUNK_SIZE 65536
+
+
+typedef struct ReadBuffer_st
+{
+    BYTE *data;
+    size_t length;
+    size_t capacity;
+} ReadBuffer;
+
+
+size_t socket_pushback_take(SocketState state, BYTE *buffer, size_t bufferSize);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,392 @@
+#include "recorder.h"
+
+
+static bool recorder_open(Recorder recorder, const char *path)
+{
+    #ifdef _WIN32
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL) {
+        return false;
+    }
+    fwrite(RECORDER_MAGIC, 1, RECORDER_MAGIC_LENGTH, recorder->file);
+    #else
+    recorder->fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (recorder->fd < 0) {
+        return false;
+    }
+
+    recorder->map = NULL;
+    recorder->mapped = 0;
+    if (ftruncate(recorder->fd, RECORDER_CHUNK) == 0) {
+        recorder->map = mmap(NULL, RECORDER_CHUNK, PROT_READ | PROT_WRITE, MAP_SHARED, recorder->fd, 0);
+    }
+    if (recorder->map == NULL || recorder->map == MAP_FAILED) {
+        close(recorder->fd);
+        return false;
+    }
+    recorder->mapped = RECORDER_CHUNK;
+    memcpy(recorder->map, RECORDER_MAGIC, RECORDER_MAGIC_LENGTH);
+    #endif
+
+    recorder->offset = RECORDER_MAGIC_LENGTH;
+    recorder->records = 0;
+    recorder->start = get_monotonic_time();
+    recorder->open = true;
+    return true;
+}
+
+
+// Unmaps and cuts the file back to what was written
+static void recorder_close(Recorder recorder)
+{
+    if (!recorder->open) {
+        return;
+    }
+
+    #ifdef _WIN32
+    fclose(recorder->file);
+    #else
+    munmap(recorder->map, recorder->mapped);
+    if (ftruncate(recorder->fd, (off_t)recorder->offset) != 0) {
+        print("recorder: truncate failed");
+    }
+    close(recorder->fd);
+    #endif
+
+    recorder->open = false;
+}
+
+
+#ifndef _WIN32
+// Makes room for length more bytes, remapping the file a chunk at a time
+static bool recorder_reserve(Recorder recorder, size_t length)
+{
+    if (recorder->offset + length <= recorder->mapped) {
+        return true;
+    }
+
+    size_t mapped = recorder->mapped;
+    while (mapped < recorder->offset + length) {
+        mapped += RECORDER_CHUNK;
+    }
+
+    if (ftruncate(recorder->fd, (off_t)mapped) != 0) {
+        return false;
+    }
+
+    #ifdef __linux__
+    BYTE *map = mremap(recorder->map, recorder->mapped, mapped, MREMAP_MAYMOVE);
+    #else
+    munmap(recorder->map, recorder->mapped);
+    BYTE *map = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, recorder->fd, 0);
+    #endif
+    if (map == MAP_FAILED) {
+        recorder->map = NULL;
+        recorder->mapped = 0;
+        return false;
+    }
+
+    recorder->map = map;
+    recorder->mapped = mapped;
+    return true;
+}
+#endif
+
+
+void recorder_write(Recorder recorder, RECORD_KIND kind, SOCKET socketId, SOCKET_TYPE socketType,
+    SOCKET peer, const BYTE *data, size_t length)
+{
+    if (recorder == NULL || !recorder->open) {
+        return;
+    }
+
+    mutex_lock(&recorder->mutex);
+    if (!recorder->open) {
+        mutex_unlock(&recorder->mutex);
+        return;
+    }
+
+    struct RecordHeader_st header;
+    header.time = (uint64_t)(get_monotonic_time() - recorder->start);
+    header.socketId = (int64_t)socketId;
+    header.peer = (int64_t)peer;
+    header.length = (uint32_t)length;
+    header.kind = (uint16_t)kind;
+    header.socketType = (uint16_t)socketType;
+
+    #ifdef _WIN32
+    fwrite(&header, sizeof(header), 1, recorder->file);
+    if (length > 0) {
+        fwrite(data, 1, length, recorder->file);
+    }
+    recorder->offset += sizeof(header) + length;
+    recorder->records++;
+    #else
+    if (recorder_reserve(recorder, sizeof(header) + length)) {
+        memcpy(recorder->map + recorder->offset, &header, sizeof(header));
+        if (length > 0) {
+            memcpy(recorder->map + recorder->offset + sizeof(header), data, length);
+        }
+        recorder->offset += sizeof(header) + length;
+        recorder->records++;
+    } else {
+        // a full disk ends the recording rather than the connection
+        recorder_close(recorder);
+    }
+    #endif
+
+    mutex_unlock(&recorder->mutex);
+}
+
+
+// Records a write made from the kernel side in the log of the owning loop
+void recorder_send(SocketState state, const BYTE *data, size_t length)
+{
+    if (state != NULL && state->owner != NULL) {
+        recorder_write(state->owner->recorder, RECORD_SEND, state->socketId, TCP_CLIENT, state->listener, data, length);
+    }
+}
+
+
+void recorder_free(Recorder recorder)
+{
+    if (recorder == NULL) {
+        return;
+    }
+
+    recorder_close(recorder);
+    mutex_destroy(&recorder->mutex);
+    free(recorder);
+}
+
+
+DLLEXPORT int socketRecorderStart(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SocketList socketList = (SocketList)MArgument_getInteger(Args[0]);
+    char *path = MArgument_getUTF8String(Args[1]);
+
+    Recorder recorder = socketList->recorder;
+    if (recorder == NULL) {
+        recorder = calloc(1, sizeof(struct Recorder_st));
+        if (recorder == NULL) {
+            libData->UTF8String_disown(path);
+            return LIBRARY_FUNCTION_ERROR;
+        }
+        mutex_init(&recorder->mutex);
+    }
+
+    mutex_lock(&recorder->mutex);
+    recorder_close(recorder);
+    bool opened = recorder_open(recorder, path);
+    mutex_unlock(&recorder->mutex);
+    libData->UTF8String_disown(path);
+
+    socketList->recorder = recorder;
+
+    MArgument_setBoolean(Res, opened);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Ends the recording and returns {records, bytes}
+DLLEXPORT int socketRecorderStop(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SocketList socketList = (SocketList)MArgument_getInteger(Args[0]);
+    Recorder recorder = socketList->recorder;
+
+    MTensor result;
+    mint dims = 2;
+    libData->MTensor_new(MType_Integer, 1, &dims, &result);
+    mint *resultData = libData->MTensor_getIntegerData(result);
+    resultData[0] = 0;
+    resultData[1] = 0;
+
+    if (recorder != NULL) {
+        mutex_lock(&recorder->mutex);
+        resultData[0] = recorder->records;
+        resultData[1] = (mint)recorder->offset;
+        recorder_close(recorder);
+        mutex_unlock(&recorder->mutex);
+    }
+
+    MArgument_setMTensor(Res, result);
+    return LIBRARY_NO_ERROR;
+}
+
+
+static BYTE *replay_load(const char *path, size_t *length)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    BYTE *data = size >= RECORDER_MAGIC_LENGTH ? malloc((size_t)size) : NULL;
+    if (data != NULL && fread(data, 1, (size_t)size, file) != (size_t)size) {
+        free(data);
+        data = NULL;
+    }
+    fclose(file);
+
+    if (data != NULL && memcmp(data, RECORDER_MAGIC, RECORDER_MAGIC_LENGTH) != 0) {
+        free(data);
+        data = NULL;
+    }
+
+    *length = (size_t)size;
+    return data;
+}
+
+
+// Reads and drops whatever the server has sent so far
+static mint replay_discard(SOCKET socketId)
+{
+    BYTE buffer[16384];
+    mint received = 0;
+    int result;
+    while ((result = recv_nonblocking(socketId, buffer, sizeof(buffer))) > 0) {
+        received += result;
+    }
+    return received;
+}
+
+
+// Replays the client side of a log against host:port, one connection per
+// recorded accept. speed scales the recorded gaps, 0 sends as fast as
+// possible. Returns {connections, bytesSent, bytesReceived, bytesRecorded,
+// elapsed ns} where bytesRecorded is what the server sent while recording
+DLLEXPORT int socketReplay(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    char *path = MArgument_getUTF8String(Args[0]);
+    char *host = MArgument_getUTF8String(Args[1]);
+    unsigned short port = (unsigned short)MArgument_getInteger(Args[2]);
+    double speed = MArgument_getReal(Args[3]);
+
+    struct sockaddr_storage address;
+    socklen_t addressLength;
+    size_t length = 0;
+    BYTE *log = socket_address_from_host(host, port, &address, &addressLength) ? replay_load(path, &length) : NULL;
+    libData->UTF8String_disown(path);
+    libData->UTF8String_disown(host);
+    if (log == NULL) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    // recorded descriptors are small and reused, so a table indexed by
+    // them maps each to its live connection
+    int64_t maxSocketId = 0;
+    struct RecordHeader_st header;
+    size_t offset = RECORDER_MAGIC_LENGTH;
+    while (offset + sizeof(header) <= length) {
+        memcpy(&header, log + offset, sizeof(header));
+        if (header.socketId > maxSocketId) {
+            maxSocketId = header.socketId;
+        }
+        offset += sizeof(header) + header.length;
+    }
+
+    SOCKET *live = maxSocketId < (1 << 24) ? malloc(sizeof(SOCKET) * (size_t)(maxSocketId + 1)) : NULL;
+    if (live == NULL) {
+        free(log);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    for (int64_t i = 0; i <= maxSocketId; i++) {
+        live[i] = INVALID_SOCKET;
+    }
+
+    mint connections = 0;
+    mint bytesSent = 0;
+    mint bytesReceived = 0;
+    mint bytesRecorded = 0;
+    mint start = get_monotonic_time();
+
+    offset = RECORDER_MAGIC_LENGTH;
+    while (offset + sizeof(header) <= length) {
+        memcpy(&header, log + offset, sizeof(header));
+        const BYTE *payload = log + offset + sizeof(header);
+        offset += sizeof(header) + header.length;
+        if (offset > length || header.socketId < 0 || header.socketType != TCP_CLIENT) {
+            continue;
+        }
+
+        if (speed > 0) {
+            mint deadline = start + (mint)((double)header.time / speed);
+            mint now;
+            while ((now = get_monotonic_time()) < deadline) {
+                mint wait = (deadline - now) / 1000;
+                #ifdef _WIN32
+                SLEEP((DWORD)(wait / 1000 > 0 ? wait / 1000 : 1));
+                #else
+                SLEEP((useconds_t)(wait > 0 ? wait : 1));
+                #endif
+            }
+        }
+
+        SOCKET *socketId = &live[header.socketId];
+        switch (header.kind) {
+            case RECORD_ACCEPT:
+                if (ISVALIDSOCKET(*socketId)) {
+                    CLOSESOCKET(*socketId);
+                }
+                *socketId = socket(address.ss_family, SOCK_STREAM, IPPROTO_TCP);
+                if (ISVALIDSOCKET(*socketId) && connect(*socketId, (struct sockaddr *)&address, addressLength) != 0) {
+                    CLOSESOCKET(*socketId);
+                    *socketId = INVALID_SOCKET;
+                }
+                if (ISVALIDSOCKET(*socketId)) {
+                    int nodelay = 1;
+                    setsockopt(*socketId, IPPROTO_TCP, TCP_NODELAY, (const char *)&nodelay, sizeof(nodelay));
+                    connections++;
+                }
+                break;
+
+            case RECORD_RECEIVE:
+                if (ISVALIDSOCKET(*socketId)) {
+                    bytesReceived += replay_discard(*socketId);
+                    if (send_all(*socketId, payload, header.length) > 0) {
+                        bytesSent += header.length;
+                    }
+                }
+                break;
+
+            case RECORD_SEND:
+                bytesRecorded += header.length;
+                break;
+
+            case RECORD_CLOSE:
+                if (ISVALIDSOCKET(*socketId)) {
+                    bytesReceived += replay_discard(*socketId);
+                    CLOSESOCKET(*socketId);
+                    *socketId = INVALID_SOCKET;
+                }
+                break;
+        }
+    }
+
+    for (int64_t i = 0; i <= maxSocketId; i++) {
+        if (ISVALIDSOCKET(live[i])) {
+            bytesReceived += replay_discard(live[i]);
+            CLOSESOCKET(live[i]);
+        }
+    }
+
+    free(live);
+    free(log);
+
+    MTensor result;
+    mint dims = 5;
+    libData->MTensor_new(MType_Integer, 1, &dims, &result);
+    mint *resultData = libData->MTensor_getIntegerData(result);
+    resultData[0] = connections;
+    resultData[1] = bytesSent;
+    resultData[2] = bytesReceived;
+    resultData[3] = bytesRecorded;
+    resultData[4] = get_monotonic_time() - start;
+
+    MArgument_setMTensor(Res, result);
+    return LIBRARY_NO_ERROR;
+}
\ No newline at end of file
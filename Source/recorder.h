@@ -0,0 +1,73 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+
+#include "common.h"
+#include "state.h"
+#include "list.h"
+
+
+#ifndef _WIN32
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+
+#define RECORDER_MAGIC "CSREC01"
+#define RECORDER_MAGIC_LENGTH 8
+#define RECORDER_CHUNK (16 * 1024 * 1024)
+
+
+typedef enum {
+    RECORD_ACCEPT = 1,
+    RECORD_RECEIVE,
+    RECORD_CLOSE,
+    RECORD_SEND
+} RECORD_KIND;
+
+
+// Fixed part of every log record, the payload follows it unaligned. Time
+// is nanoseconds since the recording started, peer is the listener of an
+// accepted connection
+typedef struct RecordHeader_st
+{
+    uint64_t time;
+    int64_t socketId;
+    int64_t peer;
+    uint32_t length;
+    uint16_t kind;
+    uint16_t socketType;
+} *RecordHeader;
+
+
+// Append-only traffic log of one socket list. On POSIX the file is mapped
+// and grown in chunks so a record is a copy into memory, elsewhere it is a
+// buffered file
+typedef struct Recorder_st
+{
+    Mutex mutex;
+    bool open;
+    mint start;
+    mint records;
+    #ifdef _WIN32
+    FILE *file;
+    #else
+    int fd;
+    BYTE *map;
+    size_t mapped;
+    #endif
+    size_t offset;
+} *Recorder;
+
+
+void recorder_write(Recorder recorder, RECORD_KIND kind, SOCKET socketId, SOCKET_TYPE socketType,
+    SOCKET peer, const BYTE *data, size_t length);
+
+
+void recorder_send(SocketState state, const BYTE *data, size_t length);
+
+
+void recorder_free(Recorder recorder);
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,315 @@
+#include "relay.h"
+
+
+#define RELAY_OK 0
+#define RELAY_ERROR -1
+
+
+DLLEXPORT int socketRelay(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET source = (SOCKET)MArgument_getInteger(Args[0]); // socket already polled by a loop
+    SOCKET target = (SOCKET)MArgument_getInteger(Args[1]); // socket to forward data to and from
+
+    if (!ISVALIDSOCKET(source) || !ISVALIDSOCKET(target) || source == target) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState sourceState = socket_state_acquire(source);
+    SocketState targetState = socket_state_acquire(target);
+    SocketList owner = sourceState->owner != NULL ? sourceState->owner : targetState->owner;
+
+    if (owner == NULL || sourceState->relay != NULL || targetState->relay != NULL) {
+        socket_state_release(sourceState);
+        socket_state_release(targetState);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    set_non_blocking_mode(source);
+    set_non_blocking_mode(target);
+
+    Relay relay = relay_create(source, target);
+    if (relay == NULL) {
+        socket_state_release(sourceState);
+        socket_state_release(targetState);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mutex_lock(&globalMutex);
+    sourceState->relay = relay;
+    targetState->relay = relay;
+    mutex_unlock(&globalMutex);
+    socket_state_release(sourceState);
+    socket_state_release(targetState);
+
+    socket_list_interrupt(owner);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Buffers of the copying path count as memory of no connection, false when
+// that would cross the library limit or malloc fails
+static bool relay_channel_buffer(RelayChannel *channel)
+{
+    if (!memory_allowed(NULL, RELAY_BUFFER_SIZE)) {
+        return false;
+    }
+
+    channel->buffer = malloc(RELAY_BUFFER_SIZE);
+    if (channel->buffer == NULL) {
+        return false;
+    }
+
+    memory_charge(NULL, RELAY_BUFFER_SIZE);
+    return true;
+}
+
+
+static bool relay_channel_init(RelayChannel *channel, SOCKET source, SOCKET target)
+{
+    channel->source = source;
+    channel->target = target;
+    channel->pipefds[0] = -1;
+    channel->pipefds[1] = -1;
+    channel->buffer = NULL;
+    channel->start = 0;
+    channel->end = 0;
+    channel->pending = 0;
+    channel->bytes = 0;
+    channel->eof = false;
+    channel->shutdown = false;
+
+    #ifdef __linux__
+    if (pipe2(channel->pipefds, O_NONBLOCK | O_CLOEXEC) == 0) {
+        return true;
+    }
+    channel->pipefds[0] = -1;
+    channel->pipefds[1] = -1;
+    #endif
+
+    return relay_channel_buffer(channel);
+}
+
+
+static void relay_channel_free(RelayChannel *channel)
+{
+    #ifdef __linux__
+    if (channel->pipefds[0] >= 0) {
+        close(channel->pipefds[0]);
+        close(channel->pipefds[1]);
+    }
+    #endif
+    if (channel->buffer != NULL) {
+        free(channel->buffer);
+        memory_charge(NULL, -RELAY_BUFFER_SIZE);
+    }
+}
+
+
+#ifdef __linux__
+// Switches the channel from splice to the buffered path, used when the
+// socket family does not support splicing
+static bool relay_channel_fallback(RelayChannel *channel)
+{
+    close(channel->pipefds[0]);
+    close(channel->pipefds[1]);
+    channel->pipefds[0] = -1;
+    channel->pipefds[1] = -1;
+    return relay_channel_buffer(channel);
+}
+#endif
+
+
+static int relay_channel_fill(RelayChannel *channel)
+{
+    if (channel->eof || channel->pending >= RELAY_BUFFER_SIZE) {
+        return RELAY_OK;
+    }
+
+    #ifdef __linux__
+    if (channel->pipefds[0] >= 0) {
+        ssize_t result = splice(channel->source, NULL, channel->pipefds[1], NULL,
+            RELAY_BUFFER_SIZE - channel->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+        if (result > 0) {
+            channel->pending += (size_t)result;
+            return RELAY_OK;
+        }
+
+        if (result == 0) {
+            channel->eof = true;
+            return RELAY_OK;
+        }
+
+        if (is_wouldblock_err(errno)) {
+            return RELAY_OK;
+        }
+
+        if (errno != EINVAL || channel->pending > 0 || !relay_channel_fallback(channel)) {
+            return RELAY_ERROR;
+        }
+    }
+    #endif
+
+    // the space a partial send freed at the front is only reachable by
+    // moving what is left, otherwise POLLIN stays armed with nowhere to read
+    if (channel->end == RELAY_BUFFER_SIZE && channel->start > 0) {
+        memmove(channel->buffer, (char *)channel->buffer + channel->start, channel->pending);
+        channel->start = 0;
+        channel->end = channel->pending;
+    }
+
+    int result = recv(channel->source, (char *)channel->buffer + channel->end, (int)(RELAY_BUFFER_SIZE - channel->end), 0);
+    if (result > 0) {
+        channel->end += (size_t)result;
+        channel->pending = channel->end - channel->start;
+        return RELAY_OK;
+    }
+
+    if (result == 0) {
+        channel->eof = true;
+        return RELAY_OK;
+    }
+
+    return is_wouldblock_err(GETSOCKETERRNO()) ? RELAY_OK : RELAY_ERROR;
+}
+
+
+static int relay_channel_flush(RelayChannel *channel)
+{
+    while (channel->pending > 0) {
+        int result;
+
+        #ifdef __linux__
+        if (channel->pipefds[0] >= 0) {
+            result = (int)splice(channel->pipefds[0], NULL, channel->target, NULL,
+                channel->pending, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } else
+        #endif
+        {
+            result = send(channel->target, (char *)channel->buffer + channel->start, (int)channel->pending, MSG_NOSIGNAL);
+            if (result > 0) {
+                channel->start += (size_t)result;
+                if (channel->start == channel->end) {
+                    channel->start = 0;
+                    channel->end = 0;
+                }
+            }
+        }
+
+        if (result > 0) {
+            channel->pending -= (size_t)result;
+            channel->bytes += result;
+            continue;
+        }
+
+        if (result < 0 && is_wouldblock_err(GETSOCKETERRNO())) {
+            return RELAY_OK;
+        }
+
+        return RELAY_ERROR;
+    }
+
+    // Half-close: the source finished sending and everything it sent is
+    // delivered, so the target sees EOF while the other direction stays open
+    if (channel->eof && !channel->shutdown) {
+        shutdown(channel->target, SHUT_WR);
+        channel->shutdown = true;
+    }
+
+    return RELAY_OK;
+}
+
+
+Relay relay_create(SOCKET source, SOCKET target)
+{
+    Relay relay = malloc(sizeof(struct Relay_st));
+    if (relay == NULL) {
+        return NULL;
+    }
+
+    // both channels start cleared so a failed one frees like a working one
+    bool forward = relay_channel_init(&relay->forward, source, target);
+    bool backward = relay_channel_init(&relay->backward, target, source);
+    relay->attached = false;
+
+    if (!forward || !backward) {
+        relay_free(relay);
+        return NULL;
+    }
+    return relay;
+}
+
+
+// Adds the relay sockets that are missing from the list, must be called
+// from the thread that runs the poll loop over the list
+bool relay_attach(SocketList socketList, Relay relay)
+{
+    if (relay->attached) {
+        return false;
+    }
+
+    if (socket_list_find(socketList, relay->forward.source) < 0) {
+        socket_list_add(socketList, relay->forward.source, TCP_CLIENT);
+    }
+
+    if (socket_list_find(socketList, relay->forward.target) < 0) {
+        socket_list_add(socketList, relay->forward.target, TCP_CLIENT);
+    }
+
+    relay->attached = true;
+    return true;
+}
+
+
+// Backpressure: a side is read only while its channel has room and is
+// polled for writing only while data for it is waiting
+int relay_poll_events(Relay relay, SOCKET socketId)
+{
+    RelayChannel *outgoing = socketId == relay->forward.source ? &relay->forward : &relay->backward;
+    RelayChannel *incoming = socketId == relay->forward.source ? &relay->backward : &relay->forward;
+    int events = 0;
+
+    if (!outgoing->eof && outgoing->pending < RELAY_BUFFER_SIZE) {
+        events |= POLLIN_FLAG;
+    }
+
+    if (incoming->pending > 0) {
+        events |= POLLOUT_FLAG;
+    }
+
+    return events;
+}
+
+
+// Returns false when both directions are finished or the relay failed
+bool relay_handle(Relay relay, SOCKET socketId, mint wl_revents)
+{
+    RelayChannel *outgoing = socketId == relay->forward.source ? &relay->forward : &relay->backward;
+    RelayChannel *incoming = socketId == relay->forward.source ? &relay->backward : &relay->forward;
+
+    if (wl_revents & (WL_POLLERR | WL_POLLNVAL)) {
+        return false;
+    }
+
+    if (wl_revents & (WL_POLLIN | WL_POLLHUP)) {
+        if (relay_channel_fill(outgoing) == RELAY_ERROR || relay_channel_flush(outgoing) == RELAY_ERROR) {
+            return false;
+        }
+    }
+
+    if (wl_revents & WL_POLLOUT) {
+        if (relay_channel_flush(incoming) == RELAY_ERROR) {
+            return false;
+        }
+    }
+
+    return !(relay->forward.shutdown && relay->backward.shutdown);
+}
+
+
+void relay_free(Relay relay)
+{
+    relay_channel_free(&relay->forward);
+    relay_channel_free(&relay->backward);
+    free(relay);
+}
\ No newline at end of file
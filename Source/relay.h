@@ -0,0 +1,52 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+
+#include "common.h"
+#include "list.h"
+#include "state.h"
+#include "memory.h"
+
+
+#define RELAY_BUFFER_SIZE 65536
+
+
+typedef struct RelayChannel_st
+{
+    SOCKET source;
+    SOCKET target;
+    int pipefds[2];
+    BYTE *buffer;
+    size_t start;
+    size_t end;
+    size_t pending;
+    mint bytes;
+    bool eof;
+    bool shutdown;
+} RelayChannel;
+
+
+typedef struct Relay_st
+{
+    RelayChannel forward;
+    RelayChannel backward;
+    bool attached;
+} *Relay;
+
+
+Relay relay_create(SOCKET source, SOCKET target);
+
+
+bool relay_attach(SocketList socketList, Relay relay);
+
+
+int relay_poll_events(Relay relay, SOCKET socketId);
+
+
+bool relay_handle(Relay relay, SOCKET socketId, mint wl_revents);
+
+
+void relay_free(Relay relay);
+
+
+#endif
\ No newline at end of file
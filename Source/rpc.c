@@ -0,0 +1,491 @@
+#include "rpc.h"
+
+
+static Rpc rpc_create(WolframLibraryData libData, bool server)
+{
+    Rpc rpc = calloc(1, sizeof(struct Rpc_st));
+    if (rpc != NULL) {
+        mutex_init(&rpc->mutex);
+        wakeup_init(&rpc->wakeup);
+        rpc->libData = libData;
+        rpc->server = server;
+    }
+    return rpc;
+}
+
+
+// Makes the socket an RPC channel. On a listener every accepted connection
+// becomes one, server connections raise Request and client connections
+// collect replies to their calls
+DLLEXPORT int socketRpcEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mbool server = MArgument_getBoolean(Args[1]);
+
+    if (!ISVALIDSOCKET(socketId)) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    SocketState state = socket_state_acquire(socketId);
+    if (state->rpc == NULL) {
+        mutex_lock(&globalMutex);
+        if (state->rpc == NULL) {
+            state->rpc = rpc_create(libData, server);
+        }
+        mutex_unlock(&globalMutex);
+
+        if (state->rpc == NULL) {
+            socket_state_release(state);
+            return LIBRARY_MEMORY_ERROR;
+        }
+    }
+    state->rpc->server = server;
+    socket_state_release(state);
+
+    return LIBRARY_NO_ERROR;
+}
+
+
+static int rpc_send(SocketState state, SOCKET socketId, mint id, const BYTE *data, size_t length)
+{
+    BYTE header[RPC_HEADER_SIZE];
+    for (int j = 0; j < 8; j++) {
+        header[j] = (BYTE)((uint64_t)id >> (8 * j));
+        header[8 + j] = (BYTE)((uint64_t)length >> (8 * j));
+    }
+
+    return coalesce_enabled(state) ?
+        coalesce_append_header(state, header, RPC_HEADER_SIZE, data, length) :
+        send_all_header(socketId, header, RPC_HEADER_SIZE, data, length);
+}
+
+
+// The caller holds the channel mutex, returns the link pointing at the call
+static RpcCall *rpc_find(Rpc rpc, mint id)
+{
+    RpcCall *link = &rpc->calls;
+    while (*link != NULL && (*link)->id != id) {
+        link = &(*link)->next;
+    }
+    return link;
+}
+
+
+static void rpc_call_free(Rpc rpc, RpcCall call)
+{
+    if (call->reply != NULL) {
+        rpc->libData->numericarrayLibraryFunctions->MNumericArray_free(call->reply);
+    }
+    free(call);
+}
+
+
+// Sends the bytes as a new call and returns its id. With wait the reply is
+// kept for socketRpcWait, otherwise the owning loop raises Reply for it.
+DLLEXPORT int socketRpcCall(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[1]);
+    mbool wait = MArgument_getBoolean(Args[2]);
+
+    BYTE *data = libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    mint length = libData->numericarrayLibraryFunctions->MNumericArray_getFlattenedLength(byteArray);
+
+    SocketState state = socket_state_get(socketId);
+    if (state == NULL || state->rpc == NULL || state->rpc->server) {
+        socket_state_release(state);
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    Rpc rpc = state->rpc;
+    RpcCall call = calloc(1, sizeof(struct RpcCall_st));
+    if (call == NULL) {
+        socket_state_release(state);
+        libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+        return LIBRARY_MEMORY_ERROR;
+    }
+    call->wait = wait;
+
+    // registered before sending, the reply can arrive before send returns
+    mutex_lock(&rpc->mutex);
+    call->id = ++rpc->nextId;
+    call->next = rpc->calls;
+    rpc->calls = call;
+    rpc->pending++;
+    mutex_unlock(&rpc->mutex);
+
+    mint id = call->id;
+    int sentLength = rpc_send(state, socketId, id, data, (size_t)length);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+
+    if (sentLength <= 0) {
+        mutex_lock(&rpc->mutex);
+        RpcCall *link = rpc_find(rpc, id);
+        if (*link != NULL) {
+            call = *link;
+            *link = call->next;
+            rpc->pending--;
+            rpc_call_free(rpc, call);
+        }
+        mutex_unlock(&rpc->mutex);
+        socket_state_release(state);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    socket_state_release(state);
+
+    MArgument_setInteger(Res, id);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Answers a Request with the same id
+DLLEXPORT int socketRpcReply(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint id = MArgument_getInteger(Args[1]);
+    MNumericArray byteArray = MArgument_getMNumericArray(Args[2]);
+
+    BYTE *data = libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
+    mint length = libData->numericarrayLibraryFunctions->MNumericArray_getFlattenedLength(byteArray);
+
+    SocketState state = socket_state_get(socketId);
+    int sentLength = rpc_send(state, socketId, id, data, (size_t)length);
+    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+
+    if (sentLength > 0) {
+        latency_response(state);
+    }
+    socket_state_release(state);
+
+    if (sentLength <= 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MArgument_setInteger(Res, sentLength);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Hands a complete client-side message to its call. Returns true when the
+// call was made without wait and the caller should raise Reply with the
+// array, otherwise the array is kept for a waiter or freed. keep holds the
+// reply even for calls made without wait, for connections no loop reads.
+bool rpc_deliver(SocketState state, mint id, MNumericArray array, bool keep)
+{
+    Rpc rpc = state->rpc;
+    bool raise = false;
+
+    mutex_lock(&rpc->mutex);
+    RpcCall *link = rpc_find(rpc, id);
+    RpcCall call = *link;
+    if (call == NULL || call->done) {
+        rpc->libData->numericarrayLibraryFunctions->MNumericArray_free(array);
+    } else if (call->wait || keep) {
+        call->reply = array;
+        call->done = true;
+        wakeup_notify(&rpc->wakeup);
+    } else {
+        *link = call->next;
+        rpc->pending--;
+        free(call);
+        raise = true;
+    }
+    mutex_unlock(&rpc->mutex);
+
+    return raise;
+}
+
+
+// Takes the reply of a finished call, the caller holds the channel mutex
+static MNumericArray rpc_take(Rpc rpc, RpcCall *link)
+{
+    RpcCall call = *link;
+    MNumericArray reply = call->reply;
+
+    *link = call->next;
+    rpc->pending--;
+    call->reply = NULL;
+    free(call);
+    return reply;
+}
+
+
+// Reads messages of a connection that no loop owns until the call is done
+// or the timeout passes
+static int rpc_wait_direct(WolframLibraryData libData, SocketState state, SOCKET socketId, mint id, mint timeout, MNumericArray *reply)
+{
+    Rpc rpc = state->rpc;
+    mint deadline = get_monotonic_time() + timeout * 1000;
+
+    while (true) {
+        mutex_lock(&rpc->mutex);
+        RpcCall *link = rpc_find(rpc, id);
+        if (*link == NULL) {
+            mutex_unlock(&rpc->mutex);
+            return LIBRARY_FUNCTION_ERROR;
+        }
+        if ((*link)->done) {
+            *reply = rpc_take(rpc, link);
+            mutex_unlock(&rpc->mutex);
+            return LIBRARY_NO_ERROR;
+        }
+        mutex_unlock(&rpc->mutex);
+
+        mint messageId;
+        MNumericArray array;
+        mint bytes;
+        FRAME_RESULT result;
+        while ((result = rpc_recv(libData, state, socketId, &messageId, &array, &bytes)) == FRAME_COMPLETE) {
+            rpc_deliver(state, messageId, array, true);
+        }
+
+        mutex_lock(&rpc->mutex);
+        link = rpc_find(rpc, id);
+        bool done = *link != NULL && (*link)->done;
+        mutex_unlock(&rpc->mutex);
+        if (done) {
+            continue;
+        }
+        if (result != FRAME_PARTIAL) {
+            return LIBRARY_FUNCTION_ERROR;
+        }
+
+        // rounded up, a wait under 1 ms must not turn into a busy loop
+        mint remaining = timeout < 0 ? -1 : (deadline - get_monotonic_time() + 999) / 1000;
+        if (timeout >= 0 && remaining <= 0) {
+            return LIBRARY_FUNCTION_ERROR;
+        }
+
+        POLL_FD pollFd;
+        pollFd.fd = socketId;
+        pollFd.events = POLLIN_FLAG;
+        pollFd.revents = 0;
+        sockets_poll(&pollFd, 1, remaining);
+    }
+}
+
+
+// Waits up to timeout microseconds, -1 waits forever, for the reply to a
+// call and returns it. Fails on timeout, the call stays pending, and when
+// the call is unknown or the connection goes away.
+DLLEXPORT int socketRpcWait(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint id = MArgument_getInteger(Args[1]);
+    mint timeout = MArgument_getInteger(Args[2]);
+
+    SocketState state = socket_state_get(socketId);
+    Rpc rpc = state != NULL ? state->rpc : NULL;
+    if (rpc == NULL) {
+        socket_state_release(state);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    mutex_lock(&globalMutex);
+    bool owned = state->owner != NULL;
+    mutex_unlock(&globalMutex);
+
+    // from now on the owning loop keeps the reply instead of raising it
+    mutex_lock(&rpc->mutex);
+    RpcCall call = *rpc_find(rpc, id);
+    if (call != NULL) {
+        call->wait = true;
+    }
+    mutex_unlock(&rpc->mutex);
+
+    if (call == NULL) {
+        socket_state_release(state);
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    MNumericArray reply = NULL;
+    if (!owned) {
+        int result = rpc_wait_direct(libData, state, socketId, id, timeout, &reply);
+        socket_state_release(state);
+        if (result != LIBRARY_NO_ERROR) {
+            return LIBRARY_FUNCTION_ERROR;
+        }
+        MArgument_setMNumericArray(Res, reply);
+        return LIBRARY_NO_ERROR;
+    }
+
+    // the reference keeps the channel alive, a closed connection is one the
+    // table no longer links. The loop wakes us for every reply it keeps and
+    // when the connection is dropped.
+    mint deadline = get_monotonic_time() + timeout * 1000;
+    while (reply == NULL) {
+        mint generation = wakeup_generation(&rpc->wakeup);
+
+        mutex_lock(&rpc->mutex);
+        RpcCall *link = rpc_find(rpc, id);
+        bool missing = *link == NULL;
+        if (!missing && (*link)->done) {
+            reply = rpc_take(rpc, link);
+        }
+        mutex_unlock(&rpc->mutex);
+
+        mutex_lock(&globalMutex);
+        bool closed = !state->linked;
+        mutex_unlock(&globalMutex);
+
+        if (missing || (reply == NULL && (closed || (timeout >= 0 && get_monotonic_time() >= deadline)))) {
+            socket_state_release(state);
+            return LIBRARY_FUNCTION_ERROR;
+        }
+        if (reply == NULL) {
+            wakeup_wait(&rpc->wakeup, generation, timeout < 0 ? -1 : (deadline - get_monotonic_time() + 999) / 1000);
+        }
+    }
+    socket_state_release(state);
+
+    MArgument_setMNumericArray(Res, reply);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Forgets a call, a reply arriving later is discarded
+DLLEXPORT int socketRpcCancel(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint id = MArgument_getInteger(Args[1]);
+    bool found = false;
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    if (state != NULL && state->rpc != NULL) {
+        Rpc rpc = state->rpc;
+        mutex_lock(&rpc->mutex);
+        RpcCall *link = rpc_find(rpc, id);
+        if (*link != NULL) {
+            RpcCall call = *link;
+            *link = call->next;
+            rpc->pending--;
+            rpc_call_free(rpc, call);
+            found = true;
+        }
+        mutex_unlock(&rpc->mutex);
+    }
+    mutex_unlock(&globalMutex);
+
+    MArgument_setBoolean(Res, found);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Number of calls sent on the connection whose replies were not collected
+DLLEXPORT int socketRpcPending(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint pending = 0;
+
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    if (state != NULL && state->rpc != NULL) {
+        mutex_lock(&state->rpc->mutex);
+        pending = state->rpc->pending;
+        mutex_unlock(&state->rpc->mutex);
+    }
+    mutex_unlock(&globalMutex);
+
+    MArgument_setInteger(Res, pending);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Parses a complete header and allocates the byte array the payload is read
+// into, charging it to the connection until the message is handed over
+static FRAME_RESULT rpc_start(WolframLibraryData libData, SocketState state, Rpc rpc)
+{
+    uint64_t id = 0;
+    uint64_t length = 0;
+    for (int j = 0; j < 8; j++) {
+        id |= (uint64_t)rpc->header[j] << (8 * j);
+        length |= (uint64_t)rpc->header[8 + j] << (8 * j);
+    }
+
+    if (length > RPC_MESSAGE_MAX || !memory_allowed(state, (mint)length)) {
+        return FRAME_INVALID;
+    }
+
+    mint dims = (mint)length;
+    if (libData->numericarrayLibraryFunctions->MNumericArray_new(MNumericArray_Type_UBit8, 1, &dims, &rpc->array) != LIBRARY_NO_ERROR) {
+        return FRAME_INVALID;
+    }
+
+    memory_charge(state, (mint)length);
+    rpc->id = (mint)id;
+    rpc->data = libData->numericarrayLibraryFunctions->MNumericArray_getData(rpc->array);
+    rpc->length = (size_t)length;
+    rpc->filled = 0;
+    return FRAME_PARTIAL;
+}
+
+
+// Reads the next part of a message, returns FRAME_COMPLETE with its id,
+// payload and size, FRAME_PARTIAL when the socket would block first, and
+// FRAME_CLOSED, FRAME_ERROR or FRAME_INVALID when the connection is done
+FRAME_RESULT rpc_recv(WolframLibraryData libData, SocketState state, SOCKET socketId, mint *id, MNumericArray *array, mint *bytes)
+{
+    Rpc rpc = state->rpc;
+    int result;
+
+    while (rpc->array == NULL) {
+        if (rpc->headerFilled == RPC_HEADER_SIZE) {
+            FRAME_RESULT started = rpc_start(libData, state, rpc);
+            if (started != FRAME_PARTIAL) {
+                return started;
+            }
+            break;
+        }
+
+        result = recv_nonblocking(socketId, rpc->header + rpc->headerFilled, RPC_HEADER_SIZE - rpc->headerFilled);
+        if (result <= 0) {
+            return result == 0 ? FRAME_CLOSED : is_wouldblock_err(GETSOCKETERRNO()) ? FRAME_PARTIAL : FRAME_ERROR;
+        }
+        rpc->headerFilled += (size_t)result;
+    }
+
+    while (rpc->filled < rpc->length) {
+        result = recv_nonblocking(socketId, rpc->data + rpc->filled, rpc->length - rpc->filled);
+        if (result <= 0) {
+            return result == 0 ? FRAME_CLOSED : is_wouldblock_err(GETSOCKETERRNO()) ? FRAME_PARTIAL : FRAME_ERROR;
+        }
+        rpc->filled += (size_t)result;
+    }
+
+    memory_charge(state, -(mint)rpc->length);
+    *id = rpc->id;
+    *array = rpc->array;
+    *bytes = (mint)rpc->length;
+
+    rpc->array = NULL;
+    rpc->headerFilled = 0;
+    return FRAME_COMPLETE;
+}
+
+
+// Accepted connections of an RPC listener serve requests
+void rpc_inherit(SocketState state, SocketState listenerState)
+{
+    if (listenerState != NULL && listenerState->rpc != NULL && state->rpc == NULL) {
+        state->rpc = rpc_create(listenerState->rpc->libData, true);
+    }
+}
+
+
+void rpc_free(Rpc rpc)
+{
+    RpcCall call = rpc->calls;
+    while (call != NULL) {
+        RpcCall next = call->next;
+        rpc_call_free(rpc, call);
+        call = next;
+    }
+    if (rpc->array != NULL) {
+        rpc->libData->numericarrayLibraryFunctions->MNumericArray_free(rpc->array);
+    }
+    mutex_destroy(&rpc->mutex);
+    wakeup_destroy(&rpc->wakeup);
+    free(rpc);
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef RPC_H
+#define RPC_H
+
+
+#include "common.h"
+#include "state.h"
+#include "coalesce.h"
+#include "frame.h"
+#include "memory.h"
+#include "pool.h"
+#include "latency.h"
+
+
+// Message header: correlation id and payload length, both 64-bit
+// little-endian, then the payload bytes
+#define RPC_HEADER_SIZE 16
+#define RPC_MESSAGE_MAX ((uint64_t)INT32_MAX)
+
+
+// A call sent on a client connection and not yet collected. Calls made with
+// wait keep their reply here for socketRpcWait, others raise Reply.
+typedef struct RpcCall_st
+{
+    mint id;
+    bool wait;
+    bool done;
+    MNumericArray reply;
+    struct RpcCall_st *next;
+} *RpcCall;
+
+
+// Per-connection channel, server connections raise Request for every
+// message and client connections match messages to their calls. Waiters
+// sleep on the wakeup until a reply arrives or the connection goes away.
+typedef struct Rpc_st
+{
+    WolframLibraryData libData;
+    Mutex mutex;
+    Wakeup wakeup;
+    bool server;
+    mint nextId;
+    mint pending;
+    RpcCall calls;
+    BYTE header[RPC_HEADER_SIZE];
+    size_t headerFilled;
+    mint id;
+    MNumericArray array;
+    BYTE *data;
+    size_t length;
+    size_t filled;
+} *Rpc;
+
+
+FRAME_RESULT rpc_recv(WolframLibraryData libData, SocketState state, SOCKET socketId, mint *id, MNumericArray *array, mint *bytes);
+
+
+bool rpc_deliver(SocketState state, mint id, MNumericArray array, bool keep);
+
+
+void rpc_inherit(SocketState state, SocketState listenerState);
+
+
+void rpc_free(Rpc rpc);
+
+
+#endif
\ No newline at end of file
@@ -24,6 +24,13 @@ DLLEXPORT int socketClose(WolframLibraryData libData, mint Argc, MArgument *Args
     mint result = true;
 
     if (socketId > 0) {
+        connpool_forget(socketId);
+
+        SocketState state = socket_state_get(socketId);
+        zerocopy_close(state, socketId, ZEROCOPY_CLOSE_TIMEOUT);
+        socket_state_release(state);
+
+        socket_state_remove(socketId);
         result = CLOSESOCKET(socketId);
     }
 
@@ -157,7 +164,13 @@ DLLEXPORT int socketRecv(WolframLibraryData libData, mint Argc, MArgument *Args,
     BYTE *buffer = (BYTE *)(uintptr_t)MArgument_getInteger(Args[1]);
     size_t bufferSize = (size_t)MArgument_getInteger(Args[2]);
 
-    int result = recv(socketId, buffer, bufferSize, 0);
+    SocketState state = socket_state_get(socketId);
+    int result = (int)socket_pushback_take(state, buffer, bufferSize);
+    socket_state_release(state);
+    if (result == 0) {
+        result = recv(socketId, buffer, bufferSize, 0);
+    }
+
     if (result >= 0) {
         mint len = (mint)result;
         MNumericArray byteArray;
@@ -216,14 +229,31 @@ DLLEXPORT int socketSend(WolframLibraryData libData, mint Argc, MArgument *Args,
     BYTE *data = (BYTE*)libData->numericarrayLibraryFunctions->MNumericArray_getData(byteArray);
     int length = MArgument_getInteger(Args[2]);
 
-    int sentLength = send(socketId, (char*)data, length, 0);
+    SocketState state = socket_state_get(socketId);
+    bool pinned = false;
+    int sentLength = coalesce_enabled(state) ?
+        coalesce_append(state, data, (size_t)length) :
+        zerocopy_enabled(state, (size_t)length) ?
+        zerocopy_send(libData, state, socketId, byteArray, data, (size_t)length, &pinned) :
+        send_all(socketId, data, (size_t)length);
+
+    // a zero-copy send keeps the array until its completion is reaped
     if (sentLength > 0) {
+        TRACE_SEND(socketId, sentLength);
+        recorder_send(state, data, (size_t)sentLength);
+        latency_response(state);
+    }
+    socket_state_release(state);
+
+    if (!pinned) {
         libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
+    }
+
+    if (sentLength > 0) {
         MArgument_setInteger(Res, sentLength);
         return LIBRARY_NO_ERROR;
     }
 
-    libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
     return LIBRARY_FUNCTION_ERROR;
 }
 
@@ -234,7 +264,18 @@ DLLEXPORT int socketSendString(WolframLibraryData libData, mint Argc, MArgument
     char *text = MArgument_getUTF8String(Args[1]);
     int length = MArgument_getInteger(Args[2]);
 
-    int sentLength = send(socketId, text, length, 0);
+    SocketState state = socket_state_get(socketId);
+    int sentLength = coalesce_enabled(state) ?
+        coalesce_append(state, (const BYTE*)text, (size_t)length) :
+        send_all(socketId, (const BYTE*)text, (size_t)length);
+
+    if (sentLength > 0) {
+        TRACE_SEND(socketId, sentLength);
+        recorder_send(state, (const BYTE*)text, (size_t)sentLength);
+        latency_response(state);
+    }
+    socket_state_release(state);
+
     if (sentLength > 0) {
         libData->UTF8String_disown(text);
         MArgument_setInteger(Res, sentLength);
@@ -267,7 +308,9 @@ DLLEXPORT int socketSendTo(WolframLibraryData libData, mint Argc, MArgument *Arg
         return LIBRARY_FUNCTION_ERROR;
     }
 
-    int sentLength = sendto(socketId, (const char *)data, (size_t)length, 0, (const struct sockaddr *)&address, addressLength);
+    SocketState state = socket_state_get(socketId);
+    int sentLength = impair_sendto(state, socketId, data, (size_t)length, (const struct sockaddr *)&address, addressLength);
+    socket_state_release(state);
 
     libData->UTF8String_disown(host);
     libData->numericarrayLibraryFunctions->MNumericArray_disown(byteArray);
@@ -276,6 +319,7 @@ DLLEXPORT int socketSendTo(WolframLibraryData libData, mint Argc, MArgument *Arg
     {
         return LIBRARY_FUNCTION_ERROR;
     }
+    TRACE_SEND(socketId, sentLength);
 
     MArgument_setInteger(Res, sentLength);
     return LIBRARY_NO_ERROR;
@@ -302,7 +346,10 @@ DLLEXPORT int socketSendStringTo(WolframLibraryData libData, mint Argc, MArgumen
         return LIBRARY_FUNCTION_ERROR;
     }
 
-    int sentLength = sendto(socketId, text, (size_t)length, 0, (const struct sockaddr *)&address, addressLength);
+    SocketState state = socket_state_get(socketId);
+    int sentLength = impair_sendto(state, socketId, (const BYTE *)text, (size_t)length,
+        (const struct sockaddr *)&address, addressLength);
+    socket_state_release(state);
 
     libData->UTF8String_disown(host);
     libData->UTF8String_disown(text);
@@ -311,6 +358,7 @@ DLLEXPORT int socketSendStringTo(WolframLibraryData libData, mint Argc, MArgumen
     {
         return LIBRARY_FUNCTION_ERROR;
     }
+    TRACE_SEND(socketId, sentLength);
 
     MArgument_setInteger(Res, sentLength);
     return LIBRARY_NO_ERROR;
@@ -355,45 +403,7 @@ DLLEXPORT int socketIsConnected(WolframLibraryData libData, mint Argc, MArgument
 {
     SOCKET sockedId = (SOCKET)MArgument_getInteger(Args[0]);
 
-    if (!ISVALIDSOCKET(sockedId)) {
-        MArgument_setBoolean(Res, False);
-        return LIBRARY_NO_ERROR;
-    }
-
-    bool wasNonBlocking = is_non_blocking_mode(sockedId);
-    if (!wasNonBlocking) {
-        set_non_blocking_mode(sockedId);
-    }
-
-    char dummy;
-    int ret = recv(sockedId, &dummy, 1, MSG_PEEK);
-    int err = GETSOCKETERRNO();
-
-    if (!wasNonBlocking) {
-        set_blocking_mode(sockedId);
-    }
-
-    if (ret > 0) {
-        MArgument_setBoolean(Res, True);
-        return LIBRARY_NO_ERROR;
-    }
-
-    if (ret == 0) {
-        MArgument_setBoolean(Res, False);
-        return LIBRARY_NO_ERROR;
-    }
-
-#ifdef _WIN32
-    if (err == WSAEWOULDBLOCK)
-#else
-    if (err == EAGAIN || err == EWOULDBLOCK)
-#endif
-    {
-        MArgument_setBoolean(Res, True);
-        return LIBRARY_NO_ERROR;
-    }
-
-    MArgument_setBoolean(Res, False);
+    MArgument_setBoolean(Res, is_connected_socket(sockedId));
     return LIBRARY_NO_ERROR;
 }
 
@@ -412,7 +422,7 @@ DLLEXPORT int socketsSelect(WolframLibraryData libData, mint Argc, MArgument *Ar
     MTensor readySockets;
     mint dims;
 
-    SOCKET *socketIds = malloc(sizeof(SOCKET) * length);
+    SOCKET *socketIds = pool_alloc(sizeof(SOCKET) * length);
     if (!socketIds) {
         return LIBRARY_FUNCTION_ERROR;
     }
@@ -435,6 +445,7 @@ DLLEXPORT int socketsSelect(WolframLibraryData libData, mint Argc, MArgument *Ar
         result = select((int)(maxfd + 1), NULL, &fds, NULL, &tv);
         break;
     default:
+        pool_free(socketIds);
         return LIBRARY_FUNCTION_ERROR;
     }
     if (result >= 0) {
@@ -442,12 +453,12 @@ DLLEXPORT int socketsSelect(WolframLibraryData libData, mint Argc, MArgument *Ar
         libData->MTensor_new(MType_Integer, 1, &dims, &readySockets);
 
         filter_fd_set_to_tensor(libData, &fds, socketIds, readySockets, result);
-        free(socketIds);
+        pool_free(socketIds);
 
         MArgument_setMTensor(Res, readySockets);
         return LIBRARY_NO_ERROR;
     } else {
-        free(socketIds);
+        pool_free(socketIds);
         return LIBRARY_FUNCTION_ERROR;
     }
 }
@@ -472,7 +483,7 @@ DLLEXPORT int socketsPoll(WolframLibraryData libData, mint Argc, MArgument *Args
 
     int nativeEvents = convert_wl_to_native_events(eventsMask);
 
-    POLL_FD *fds = (POLL_FD*)malloc(sizeof(POLL_FD) * length);
+    POLL_FD *fds = pool_alloc(sizeof(POLL_FD) * length);
     if (!fds) {
         return LIBRARY_FUNCTION_ERROR;
     }
@@ -485,12 +496,12 @@ DLLEXPORT int socketsPoll(WolframLibraryData libData, mint Argc, MArgument *Args
 
     int result = sockets_poll(fds, length, timeout_us);
     if (result < 0) {
-        free(fds);
+        pool_free(fds);
         return LIBRARY_FUNCTION_ERROR;
     }
 
     if (result == 0) {
-        free(fds);
+        pool_free(fds);
         mint dims[2] = {0, 2};
         MTensor emptyTensor;
         libData->MTensor_new(MType_Integer, 2, dims, &emptyTensor);
@@ -512,7 +523,7 @@ DLLEXPORT int socketsPoll(WolframLibraryData libData, mint Argc, MArgument *Args
         }
     }
 
-    free(fds);
+    pool_free(fds);
     MArgument_setMTensor(Res, resultTensor);
     return LIBRARY_NO_ERROR;
 }
\ No newline at end of file
@@ -3,6 +3,16 @@
 
 
 #include "common.h"
+#include "state.h"
+#include "coalesce.h"
+#include "read.h"
+#include "pool.h"
+#include "zerocopy.h"
+#include "recorder.h"
+#include "impair.h"
+#include "latency.h"
+#include "trace.h"
+#include "connpool.h"
 
 
 #endif
\ No newline at end of file
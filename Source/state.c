@@ -0,0 +1,183 @@
+#include "state.h"
+#include "handoff.h"
+#include "coalesce.h"
+#include "list.h"
+#include "memory.h"
+#include "pool.h"
+#include "frame.h"
+#include "zerocopy.h"
+#include "impair.h"
+#include "latency.h"
+#include "rpc.h"
+#include "address.h"
+
+
+// Per-socket native state shared by the poll loops and the synchronous API,
+// keyed by socket id and guarded by globalMutex
+static SocketState socketStates[SOCKET_STATE_BUCKETS];
+
+
+static size_t socket_state_bucket(SOCKET socketId)
+{
+    return (size_t)socketId % SOCKET_STATE_BUCKETS;
+}
+
+
+// The caller holds globalMutex
+SocketState socket_state_find(SOCKET socketId)
+{
+    SocketState state = socketStates[socket_state_bucket(socketId)];
+    while (state != NULL && state->socketId != socketId) {
+        state = state->next;
+    }
+    return state;
+}
+
+
+// Returns the state with a reference the caller gives back with
+// socket_state_release, or NULL
+SocketState socket_state_get(SOCKET socketId)
+{
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    if (state != NULL) {
+        state->refs++;
+    }
+    mutex_unlock(&globalMutex);
+    return state;
+}
+
+
+// Like socket_state_get, creating the state when the socket has none
+SocketState socket_state_acquire(SOCKET socketId)
+{
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    if (state == NULL) {
+        size_t bucket = socket_state_bucket(socketId);
+        state = pool_calloc(sizeof(struct SocketState_st));
+        state->socketId = socketId;
+        state->handoffChannel = INVALID_SOCKET;
+        state->listener = INVALID_SOCKET;
+        state->refs = 1;
+        state->linked = true;
+        state->next = socketStates[bucket];
+        socketStates[bucket] = state;
+    }
+    state->refs++;
+    mutex_unlock(&globalMutex);
+    return state;
+}
+
+
+// Frees the state once the table and every caller let go of it
+void socket_state_release(SocketState state)
+{
+    if (state == NULL) {
+        return;
+    }
+
+    mutex_lock(&globalMutex);
+    bool last = --state->refs == 0;
+    mutex_unlock(&globalMutex);
+    if (!last) {
+        return;
+    }
+
+    if (state->coalesce != NULL) {
+        coalesce_free(state->coalesce);
+    }
+    free(state->pushback);
+    if (state->frame != NULL) {
+        frame_free(state->frame);
+    }
+    if (state->zerocopy != NULL) {
+        zerocopy_free(state->zerocopy);
+    }
+    if (state->impair != NULL) {
+        impair_free(state->impair);
+    }
+    latency_detach(state);
+    if (state->rpc != NULL) {
+        rpc_free(state->rpc);
+    }
+    if (state->peerHost != 0) {
+        address_release(state->peerHost);
+    }
+    memory_charge(NULL, -state->memory);
+    pool_free(state);
+}
+
+
+// Takes the state out of the table, the caller holds globalMutex. Returns
+// false when it was not linked.
+static bool socket_state_unlink(SocketState state)
+{
+    if (!state->linked) {
+        return false;
+    }
+
+    SocketState *link = &socketStates[socket_state_bucket(state->socketId)];
+    while (*link != NULL && *link != state) {
+        link = &(*link)->next;
+    }
+    if (*link == NULL) {
+        return false;
+    }
+
+    *link = state->next;
+    state->linked = false;
+    if (state->owner != NULL) {
+        state->owner->outstandingEvents -= state->outstandingEvents;
+        state->owner->outstandingBytes -= state->outstandingBytes;
+        if (state->paused) {
+            state->owner->pausedCount--;
+        }
+        state->outstandingEvents = 0;
+        state->outstandingBytes = 0;
+        state->paused = false;
+    }
+    return true;
+}
+
+
+// Gives up the table's reference to an unlinked state, the release notice
+// goes out after globalMutex is dropped
+static void socket_state_drop(SocketState state)
+{
+    if (ISVALIDSOCKET(state->handoffChannel)) {
+        handoff_release(state->handoffChannel);
+    }
+    // RPC waiters see the connection is gone
+    if (state->rpc != NULL) {
+        wakeup_notify(&state->rpc->wakeup);
+    }
+    socket_state_release(state);
+}
+
+
+// Drops the table's reference to this exact state, a socket id reused by a
+// newer socket keeps that socket's state
+void socket_state_detach(SocketState state)
+{
+    mutex_lock(&globalMutex);
+    bool unlinked = socket_state_unlink(state);
+    mutex_unlock(&globalMutex);
+
+    if (unlinked) {
+        socket_state_drop(state);
+    }
+}
+
+
+void socket_state_remove(SOCKET socketId)
+{
+    mutex_lock(&globalMutex);
+    SocketState state = socket_state_find(socketId);
+    bool unlinked = state != NULL && socket_state_unlink(state);
+    mutex_unlock(&globalMutex);
+
+    if (unlinked) {
+        socket_state_drop(state);
+    }
+}
\ No newline at end of file
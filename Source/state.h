@@ -0,0 +1,68 @@
+#ifndef STATE_H
+#define STATE_H
+
+
+#include "common.h"
+
+
+#define SOCKET_STATE_BUCKETS 1024
+
+
+typedef struct SocketState_st
+{
+    SOCKET socketId;
+    mint refs;
+    bool linked;
+    struct SocketList_st *owner;
+    struct Relay_st *relay;
+    struct Dispatcher_st *dispatcher;
+    struct Plugin_st *plugin;
+    SOCKET handoffChannel;
+    SOCKET listener;
+    bool cached;
+    struct Coalesce_st *coalesce;
+    mint coalesceThreshold;
+    bool eof;
+    BYTE *pushback;
+    size_t pushbackLength;
+    size_t recvSize;
+    mint peerHost;
+    mint peerPort;
+    mint outstandingEvents;
+    mint outstandingBytes;
+    bool paused;
+    mint memory;
+    bool memoryLimited;
+    bool framed;
+    struct Frame_st *frame;
+    struct ZeroCopy_st *zerocopy;
+    mint zerocopyThreshold;
+    bool gro;
+    struct Impair_st *impair;
+    struct Latency_st *latency;
+    mint requestStart;
+    struct Rpc_st *rpc;
+
+    struct SocketState_st *next;
+} *SocketState;
+
+
+SocketState socket_state_find(SOCKET socketId);
+
+
+SocketState socket_state_get(SOCKET socketId);
+
+
+SocketState socket_state_acquire(SOCKET socketId);
+
+
+void socket_state_release(SocketState state);
+
+
+void socket_state_detach(SocketState state);
+
+
+void socket_state_remove(SOCKET socketId);
+
+
+#endif
\ No newline at end of file
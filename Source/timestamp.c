@@ -0,0 +1,77 @@
+#include "timestamp.h"
+
+
+// Wall clock in nanoseconds since the Unix epoch, the clock the kernel
+// stamps received packets with
+mint timestamp_now()
+{
+    #ifdef _WIN32
+    FILETIME fileTime;
+    GetSystemTimeAsFileTime(&fileTime);
+    ULARGE_INTEGER ticks;
+    ticks.LowPart = fileTime.dwLowDateTime;
+    ticks.HighPart = fileTime.dwHighDateTime;
+    return (mint)(ticks.QuadPart - 116444736000000000ULL) * 100;
+    #else
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (mint)ts.tv_sec * 1000000000 + (mint)ts.tv_nsec;
+    #endif
+}
+
+
+// Asks the kernel to stamp every packet the socket receives, accepted
+// connections inherit it from their listener
+void timestamp_enable(SOCKET socketId, bool enable)
+{
+    #ifdef TIMESTAMP_SUPPORTED
+    int value = enable ? 1 : 0;
+    setsockopt(socketId, SOL_SOCKET, SO_TIMESTAMPNS, &value, sizeof(value));
+    #endif
+}
+
+
+#ifndef _WIN32
+// Arrival time from the ancillary data of a recvmsg, 0 if it has none
+mint timestamp_read(struct msghdr *message)
+{
+    #ifdef TIMESTAMP_SUPPORTED
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(message); cmsg != NULL; cmsg = CMSG_NXTHDR(message, cmsg)) {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            return (mint)ts.tv_sec * 1000000000 + (mint)ts.tv_nsec;
+        }
+    }
+    #endif
+    return 0;
+}
+#endif
+
+
+// Reads like recv and gives when the kernel received the data, the read
+// time where the kernel does not say
+int timestamp_recv(SOCKET socketId, BYTE *buffer, size_t length, mint *arrival)
+{
+    #ifdef TIMESTAMP_SUPPORTED
+    char control[CMSG_SPACE(sizeof(struct timespec))];
+    struct iovec iov = {buffer, length};
+    struct msghdr message;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = sizeof(control);
+
+    int result = (int)recvmsg(socketId, &message, 0);
+    *arrival = result > 0 ? timestamp_read(&message) : 0;
+    #else
+    int result = recv(socketId, (char *)buffer, (int)length, 0);
+    *arrival = 0;
+    #endif
+
+    if (result > 0 && *arrival == 0) {
+        *arrival = timestamp_now();
+    }
+    return result;
+}
\ No newline at end of file
@@ -0,0 +1,27 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+
+#include "common.h"
+
+
+#if defined(__linux__) && defined(SO_TIMESTAMPNS) && defined(SCM_TIMESTAMPNS)
+    #define TIMESTAMP_SUPPORTED 1
+#endif
+
+
+mint timestamp_now();
+
+
+void timestamp_enable(SOCKET socketId, bool enable);
+
+
+#ifndef _WIN32
+mint timestamp_read(struct msghdr *message);
+#endif
+
+
+int timestamp_recv(SOCKET socketId, BYTE *buffer, size_t length, mint *arrival);
+
+
+#endif
\ No newline at end of file
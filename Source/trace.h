@@ -0,0 +1,47 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+
+// USDT probes under the provider csockets for perf and bpftrace, e.g.
+//
+//     bpftrace -e 'usdt:/path/to/CSockets.so:csockets:recv { @bytes[arg0] = sum(arg1); }'
+//
+// A probe compiles to a single nop plus an ELF note describing where its
+// arguments live, so nothing runs until a tracer attaches. Without
+// sys/sdt.h, or with CSOCKETS_NO_TRACE defined, the macros only use their
+// arguments.
+//
+//     poll_begin(sockets, timeout_us)   poll_end(ready)
+//     accept(listener, fd)              prune(before, after)
+//     recv(fd, bytes)                   send(fd, bytes)
+//     raise(task, event)
+
+
+#if !defined(CSOCKETS_NO_TRACE) && defined(__has_include)
+    #if __has_include(<sys/sdt.h>)
+        #include <sys/sdt.h>
+        #define TRACE_ENABLED 1
+    #endif
+#endif
+
+
+#ifdef TRACE_ENABLED
+    #define TRACE_POLL_BEGIN(sockets, timeout) DTRACE_PROBE2(csockets, poll_begin, sockets, timeout)
+    #define TRACE_POLL_END(ready) DTRACE_PROBE1(csockets, poll_end, ready)
+    #define TRACE_ACCEPT(listener, socketId) DTRACE_PROBE2(csockets, accept, listener, socketId)
+    #define TRACE_RECV(socketId, bytes) DTRACE_PROBE2(csockets, recv, socketId, bytes)
+    #define TRACE_SEND(socketId, bytes) DTRACE_PROBE2(csockets, send, socketId, bytes)
+    #define TRACE_RAISE(taskId, event) DTRACE_PROBE2(csockets, raise, taskId, event)
+    #define TRACE_PRUNE(before, after) DTRACE_PROBE2(csockets, prune, before, after)
+#else
+    #define TRACE_POLL_BEGIN(sockets, timeout) ((void)(sockets), (void)(timeout))
+    #define TRACE_POLL_END(ready) ((void)(ready))
+    #define TRACE_ACCEPT(listener, socketId) ((void)(listener), (void)(socketId))
+    #define TRACE_RECV(socketId, bytes) ((void)(socketId), (void)(bytes))
+    #define TRACE_SEND(socketId, bytes) ((void)(socketId), (void)(bytes))
+    #define TRACE_RAISE(taskId, event) ((void)(taskId), (void)(event))
+    #define TRACE_PRUNE(before, after) ((void)(before), (void)(after))
+#endif
+
+
+#endif
\ No newline at end of file
@@ -0,0 +1,290 @@
+#include "zerocopy.h"
+
+
+DLLEXPORT int socketZeroCopyEnable(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+    mint threshold = MArgument_getInteger(Args[1]); // 0 - disable
+
+    if (!ISVALIDSOCKET(socketId) || threshold < 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+
+    #ifdef ZEROCOPY_SUPPORTED
+    int enable = threshold > 0;
+    if (setsockopt(socketId, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) != 0 && threshold > 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    #else
+    if (threshold > 0) {
+        return LIBRARY_FUNCTION_ERROR;
+    }
+    #endif
+
+    SocketState state = socket_state_acquire(socketId);
+    state->zerocopyThreshold = threshold;
+    socket_state_release(state);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Reaps the completions that have arrived and returns {pendingSends, pendingBytes},
+// for sockets whose completions no poll loop picks up
+DLLEXPORT int socketZeroCopyPending(WolframLibraryData libData, mint Argc, MArgument *Args, MArgument Res)
+{
+    SOCKET socketId = (SOCKET)MArgument_getInteger(Args[0]);
+
+    MTensor pending;
+    mint length = 2;
+    libData->MTensor_new(MType_Integer, 1, &length, &pending);
+    mint *pendingData = libData->MTensor_getIntegerData(pending);
+    pendingData[0] = 0;
+    pendingData[1] = 0;
+
+    SocketState state = socket_state_get(socketId);
+    if (state != NULL && state->zerocopy != NULL) {
+        mint bytes;
+        bool copied;
+        zerocopy_reap(state, socketId, &bytes, &copied);
+
+        mutex_lock(&state->zerocopy->mutex);
+        pendingData[0] = state->zerocopy->pendingSends;
+        pendingData[1] = state->zerocopy->pendingBytes;
+        mutex_unlock(&state->zerocopy->mutex);
+    }
+    socket_state_release(state);
+
+    MArgument_setMTensor(Res, pending);
+    return LIBRARY_NO_ERROR;
+}
+
+
+// Coalesced writes are copied into the queue anyway
+bool zerocopy_enabled(SocketState state, size_t length)
+{
+    #ifdef ZEROCOPY_SUPPORTED
+    return state != NULL && state->zerocopyThreshold > 0 && length >= (size_t)state->zerocopyThreshold;
+    #else
+    return false;
+    #endif
+}
+
+
+static ZeroCopy zerocopy_create(WolframLibraryData libData)
+{
+    ZeroCopy zerocopy = calloc(1, sizeof(struct ZeroCopy_st));
+    if (zerocopy != NULL) {
+        mutex_init(&zerocopy->mutex);
+        zerocopy->libData = libData;
+    }
+    return zerocopy;
+}
+
+
+// Sends with MSG_ZEROCOPY and falls back to copying once the kernel runs out
+// of option memory, sets pinned when the array must stay alive until the
+// completion, in which case it is disowned by zerocopy_reap
+int zerocopy_send(WolframLibraryData libData, SocketState state, SOCKET socketId, MNumericArray array,
+    const BYTE *data, size_t length, bool *pinned)
+{
+    *pinned = false;
+
+    #ifdef ZEROCOPY_SUPPORTED
+    if (state->zerocopy == NULL) {
+        mutex_lock(&globalMutex);
+        if (state->zerocopy == NULL) {
+            state->zerocopy = zerocopy_create(libData);
+        }
+        mutex_unlock(&globalMutex);
+
+        if (state->zerocopy == NULL) {
+            return send_all(socketId, data, length);
+        }
+    }
+
+    ZeroCopy zerocopy = state->zerocopy;
+    size_t sent = 0;
+    mint calls = 0;
+    int flags = MSG_NOSIGNAL | MSG_ZEROCOPY;
+
+    mutex_lock(&zerocopy->mutex);
+    while (sent < length) {
+        ssize_t result = send(socketId, data + sent, length - sent, flags);
+        if (result > 0) {
+            if (flags & MSG_ZEROCOPY) {
+                zerocopy->next++;
+                calls++;
+            }
+            sent += (size_t)result;
+            continue;
+        }
+
+        int err = GETSOCKETERRNO();
+        if (result < 0 && err == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+            flags = MSG_NOSIGNAL;
+            continue;
+        }
+        if (result < 0 && is_wouldblock_err(err)) {
+            POLL_FD pollfd;
+            pollfd.fd = socketId;
+            pollfd.events = POLLOUT_FLAG;
+            pollfd.revents = 0;
+            sockets_poll(&pollfd, 1, -1);
+            continue;
+        }
+        break;
+    }
+
+    if (calls > 0) {
+        ZeroCopySend zerocopySend = malloc(sizeof(struct ZeroCopySend_st));
+        zerocopySend->next = NULL;
+        zerocopySend->array = array;
+        zerocopySend->last = zerocopy->next - 1;
+        zerocopySend->length = length;
+
+        if (zerocopy->tail != NULL) {
+            zerocopy->tail->next = zerocopySend;
+        } else {
+            zerocopy->head = zerocopySend;
+        }
+        zerocopy->tail = zerocopySend;
+        zerocopy->pendingSends++;
+        zerocopy->pendingBytes += (mint)length;
+        *pinned = true;
+        memory_charge(state, (mint)length);
+    }
+    mutex_unlock(&zerocopy->mutex);
+
+    return sent == length ? (int)sent : SOCKET_ERROR;
+    #else
+    return send_all(socketId, data, length);
+    #endif
+}
+
+
+// Reads the completion notifications from the socket error queue, disowns
+// the arrays of finished sends and returns how many finished, with their
+// bytes and whether the kernel fell back to copying any of them
+mint zerocopy_reap(SocketState state, SOCKET socketId, mint *bytes, bool *copied)
+{
+    *bytes = 0;
+    *copied = false;
+
+    #ifdef ZEROCOPY_SUPPORTED
+    ZeroCopy zerocopy = state->zerocopy;
+    mint count = 0;
+
+    if (zerocopy == NULL) {
+        return 0;
+    }
+
+    // drained to the end, a notification left behind keeps poll reporting POLLERR
+    mutex_lock(&zerocopy->mutex);
+    for (;;) {
+        char control[128];
+        struct msghdr message;
+        memset(&message, 0, sizeof(message));
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        if (recvmsg(socketId, &message, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&message); cmsg != NULL; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) ||
+                (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+
+            struct sock_extended_err *extendedError = (struct sock_extended_err *)CMSG_DATA(cmsg);
+            if (extendedError->ee_errno != 0 || extendedError->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                continue;
+            }
+            if (extendedError->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                *copied = true;
+            }
+
+            // ee_data is the last completed call, the counter wraps at 32 bits
+            uint32_t completed = extendedError->ee_data;
+            while (zerocopy->head != NULL && (int32_t)(zerocopy->head->last - completed) <= 0) {
+                ZeroCopySend zerocopySend = zerocopy->head;
+                zerocopy->head = zerocopySend->next;
+                if (zerocopy->head == NULL) {
+                    zerocopy->tail = NULL;
+                }
+
+                zerocopy->libData->numericarrayLibraryFunctions->MNumericArray_disown(zerocopySend->array);
+                zerocopy->pendingSends--;
+                zerocopy->pendingBytes -= (mint)zerocopySend->length;
+                *bytes += (mint)zerocopySend->length;
+                count++;
+                free(zerocopySend);
+            }
+        }
+    }
+    mutex_unlock(&zerocopy->mutex);
+
+    if (*bytes > 0) {
+        memory_charge(state, -*bytes);
+    }
+
+    return count;
+    #else
+    return 0;
+    #endif
+}
+
+
+// Reaps completions until no send is pending or the timeout in microseconds
+// runs out, must be called before the socket is closed since the error queue
+// goes away with it
+void zerocopy_close(SocketState state, SOCKET socketId, mint timeout)
+{
+    #ifdef ZEROCOPY_SUPPORTED
+    if (state == NULL || state->zerocopy == NULL) {
+        return;
+    }
+
+    mint deadline = get_monotonic_time() + timeout * 1000;
+    mint bytes;
+    bool copied;
+    zerocopy_reap(state, socketId, &bytes, &copied);
+
+    for (;;) {
+        mutex_lock(&state->zerocopy->mutex);
+        mint pending = state->zerocopy->pendingSends;
+        mutex_unlock(&state->zerocopy->mutex);
+
+        mint remaining = (deadline - get_monotonic_time()) / 1000;
+        if (pending == 0 || remaining <= 0) {
+            return;
+        }
+
+        // the error queue wakes poll with POLLERR, a wakeup with nothing to
+        // reap is a broken connection whose sends will never complete
+        POLL_FD pollfd;
+        pollfd.fd = socketId;
+        pollfd.events = 0;
+        pollfd.revents = 0;
+        if (sockets_poll(&pollfd, 1, remaining) <= 0 || zerocopy_reap(state, socketId, &bytes, &copied) == 0) {
+            return;
+        }
+    }
+    #endif
+}
+
+
+// Sends whose completions never arrived keep their arrays shared, the kernel
+// may still be reading them and nothing will say when it stops
+void zerocopy_free(ZeroCopy zerocopy)
+{
+    while (zerocopy->head != NULL) {
+        ZeroCopySend zerocopySend = zerocopy->head;
+        zerocopy->head = zerocopySend->next;
+        free(zerocopySend);
+    }
+
+    mutex_destroy(&zerocopy->mutex);
+    free(zerocopy);
+}
\ No newline at end of file
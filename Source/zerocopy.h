@@ -0,0 +1,59 @@
+#ifndef ZEROCOPY_H
+#define ZEROCOPY_H
+
+
+#include "common.h"
+#include "state.h"
+#include "memory.h"
+
+
+#if defined(__linux__) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    #include <linux/errqueue.h>
+    #define ZEROCOPY_SUPPORTED 1
+#endif
+
+
+// How long closing a socket waits for the completions of its zero-copy sends, us
+#define ZEROCOPY_CLOSE_TIMEOUT 1000000
+
+
+// A send whose pages the kernel may still read, the array stays shared
+// with the kernel until the completion for its last call arrives
+typedef struct ZeroCopySend_st
+{
+    struct ZeroCopySend_st *next;
+    MNumericArray array;
+    uint32_t last;
+    size_t length;
+} *ZeroCopySend;
+
+
+typedef struct ZeroCopy_st
+{
+    Mutex mutex;
+    WolframLibraryData libData;
+    uint32_t next;
+    ZeroCopySend head;
+    ZeroCopySend tail;
+    mint pendingSends;
+    mint pendingBytes;
+} *ZeroCopy;
+
+
+bool zerocopy_enabled(SocketState state, size_t length);
+
+
+int zerocopy_send(WolframLibraryData libData, SocketState state, SOCKET socketId, MNumericArray array,
+    const BYTE *data, size_t length, bool *pinned);
+
+
+mint zerocopy_reap(SocketState state, SOCKET socketId, mint *bytes, bool *copied);
+
+
+void zerocopy_close(SocketState state, SOCKET socketId, mint timeout);
+
+
+void zerocopy_free(ZeroCopy zerocopy);
+
+
+#endif
\ No newline at end of file